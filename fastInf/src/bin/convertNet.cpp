@@ -0,0 +1,75 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbDefinitions.h>
+#include <lbDriver.h>
+#include <lbMeasureDispatcher.h>
+#include <lbOptions.h>
+
+/*!
+  Converts a .net file to a binary model, which every program reads
+  (by readUniverse) without parsing, or a binary model back to a .net
+  file.
+ */
+using namespace std;
+using namespace lbLib;
+
+/*!
+  Default values of parameters
+ */
+string _inputFile = "none.net";
+string _outputFile = "none.bin";
+//Write a .net file instead of a binary model
+bool _writeText = false;
+//The .net values are log values (when reading or writing one)
+bool _logValues = false;
+
+int main(int argc, char* argv[]) {
+  lbOptions opt;
+  opt.addStringOption("i", &_inputFile, "input .net file or binary model");
+  opt.addStringOption("o", &_outputFile, "output binary model (or .net file with -t)");
+  opt.addBoolOption("t", &_writeText, "write a .net file instead of a binary model");
+  opt.addBoolOption("L", &_logValues, "the values of the .net file are log values");
+  opt.setOptions(argc, argv);
+  if (!opt.isOptionSetByUser("i") || !opt.isOptionSetByUser("o")) {
+    opt.usageError("Must give an input and an output file");
+  }
+  opt.ensureArgsHandled(argc, argv);
+
+  lbMeasureDispatcher disp(MT_TABLE);
+  lbDriver driver(disp);
+  if (!driver.readUniverse(_inputFile, _logValues)) {
+    cerr << "Error reading network: " << _inputFile << endl;
+    return 1;
+  }
+  lbModel& model = driver.getModel();
+
+  if (_writeText) {
+    lbDriver::writeUniverse(model, _outputFile, _logValues);
+  }
+  else if (!lbDriver::writeBinaryUniverse(model, _outputFile)) {
+    cerr << "Error writing binary model: " << _outputFile << endl;
+    return 1;
+  }
+  cerr << "Converted " << model.getGraph().getNumOfVars() << " variables, "
+       << model.getGraph().getNumOfCliques() << " cliques and "
+       << model.getNumOfMeasures() << " measures to " << _outputFile << endl;
+  return 0;
+}
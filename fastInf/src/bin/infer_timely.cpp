@@ -27,6 +27,8 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <sys/stat.h>
 #include <lbJunctionTree.h>
+#include <lbEngineSelector.h>
+#include <lbGibbsInference.h>
 #include <inferUtils.h>
 #include <timer.h>
 
@@ -81,6 +83,16 @@ double _considerSparse = 1.0;
 //Run exact inference on triangulated model (to compare and validate results on small models)
 bool _exactInf = false ;
 
+//Choose the engine automatically, for the required accuracy (exact or approx)
+string _autoAccuracy = "approx";
+
+//Junction tree model the automatic choice runs on (if it chose exact inference)
+lbModel * _autoExactModel = NULL;
+
+//Answer the evidence with Gibbs sampling for this many seconds instead of BP (0 for BP)
+double _gibbsSeconds = 0;
+int _gibbsChains = 4;
+
 /*!
  * This helper function reads full evidence (optionaly many instances, each in one line) from a file 
  * n is the number of variables in the model
@@ -127,6 +139,9 @@ void setOptions(lbOptions & opt, int argc, char *argv[]) {
   opt.addStringOption("trwopt",&_countingNumsFile, "Run TRW algorithm and find optimal tree weights");
   opt.addStringOption("valopt",&_countingNumsFile, "Try to minimize the energy under variable-valid and convexity constraints");
   opt.addBoolOption("exact", &_exactInf, "run exact inference using junction tree");
+  opt.addStringOption("auto", &_autoAccuracy, "choose between exact and loopy BP by estimated cost, for the required accuracy (exact/approx)");
+  opt.addDoubleOption("gibbs", &_gibbsSeconds, "answer each evidence by Gibbs sampling for this many seconds (marginals and standard errors)");
+  opt.addIntOption("gchains", &_gibbsChains, "number of Gibbs chains");
 
   for (int i = 0; i < V_MAX; i++) {
     opt.addVerboseOption(i, lbDefinitions::verbose_descriptions[i]);
@@ -143,6 +158,19 @@ void setOptions(lbOptions & opt, int argc, char *argv[]) {
   {
     opt.usageError("\"k\", \"trwopt\", and \"valopt\" are exclusive.") ;
   }
+  if (_gibbsSeconds < 0 || _gibbsChains < 2) {
+    opt.usageError("\"gibbs\" must not be negative and \"gchains\" must be at least 2");
+  }
+  if (opt.isOptionSetByUser("auto")) {
+    lbEngineAccuracy accuracy;
+    if (!lbEngineSelector::readAccuracy(_autoAccuracy, accuracy)) {
+      opt.usageError("\"auto\" accuracy must be \"exact\" or \"approx\"");
+    }
+    if (opt.isOptionSetByUser("c") || opt.isOptionSetByUser("k") ||
+        opt.isOptionSetByUser("trwopt") || opt.isOptionSetByUser("valopt")) {
+      opt.usageError("\"auto\" can not be used with \"c\", \"k\", \"trwopt\" or \"valopt\"");
+    }
+  }
 }
 
 
@@ -194,6 +222,7 @@ lbBeliefPropagation * getInferenceObject(int argc, char * argv[]) {
   lbMeasure::setLogSmooth(_useLogSmoothing);
 
   lbBeliefPropagation *inf = NULL;
+  string engineReport;
 
   //Uncomment to print numbers with high precision
   //cerr << setprecision(15);
@@ -203,7 +232,26 @@ lbBeliefPropagation * getInferenceObject(int argc, char * argv[]) {
   // 2) Run GBP with Kikuchi's Cluster Variation Method
   // 3) Run Generlized BP with predefined counting numbers
   // 4) Run Generlized BP when the program determines counting numbers (e.g., TRW optimal (Wainright et al) or ValOpt (Meshi et al) 
-  if (_clusterFile == "none.net") {
+  // Or let the engine selector choose between (1) and exact inference on the junction tree
+  if (opt.isOptionSetByUser("auto")) {
+    lbEngineAccuracy accuracy;
+    lbEngineSelector::readAccuracy(_autoAccuracy, accuracy);
+    lbEngineSelector selector(*model, accuracy);
+    lbEngineType engine = selector.select();
+
+    ostringstream report;
+    selector.print(report);
+    engineReport = report.str();
+
+    if (engine == ET_EXACT) {
+      _autoExactModel = lbJunctionTree::CalcJunctionTreeGraphicalModel(model, lbJunctionTree::eMinFill);
+      inf = new lbBeliefPropagation(*_autoExactModel, *_disp);
+    }
+    else {
+      inf = new lbBeliefPropagation(*model, *_disp);
+    }
+  }
+  else if (_clusterFile == "none.net") {
     if (opt.isOptionSetByUser("k")  ||  opt.isOptionSetByUser("trwopt")  ||  opt.isOptionSetByUser("valopt")) {
       //Options (3) and (4)
       //Get vivv (var indices) and fivv (factor indices) from model
@@ -234,6 +282,10 @@ lbBeliefPropagation * getInferenceObject(int argc, char * argv[]) {
   inf->createInferenceMonitor();
   inf->getInferenceMonitor()->setExact(model->getExactBeliefs());
   inf->getInferenceMonitor()->setOptions(opt, argc, argv);
+  inf->getInferenceMonitor()->setEngineReport(engineReport);
+  if (_autoExactModel != NULL) {
+    inf->getInferenceMonitor()->setBeliefGraph(&model->getGraph());
+  }
   
   //Set queue type
   //0 is the unweighted queue (standard asynq queue)
@@ -268,10 +320,15 @@ lbBeliefPropagation * getInferenceObject(int argc, char * argv[]) {
   //if user asked for printing all cliques: get number of cliques (for each clique we will print a marginal belief)
   if (_printBeliefs == 0) {
     _printBeliefs = inf->getModel().getGraph().getNumOfCliques();
+    // the beliefs of exact inference chosen by -auto are over the cliques of the model
+    if (_autoExactModel != NULL) {
+      _printBeliefs = model->getGraph().getNumOfCliques();
+    }
   }
     
   //print options that are being used
   opt.printOptions();
+  inf->getInferenceMonitor()->printInfo(cerr);
 
   //In case we want to compare with exact beliefs
   if (opt.isOptionSetByUser("exact")) {
@@ -334,6 +391,24 @@ lbBeliefPropagation * getInferenceObject(int argc, char * argv[]) {
 }
 
 
+/*!
+  Answer one evidence with the Gibbs engine: print the marginals as BP
+  does, followed by their standard errors
+ */
+void sampleEvidence(lbGibbsInference & gibbs, lbAssignment const& assign, int numOfVars) {
+  gibbs.changeEvidence(assign);
+  int samples = gibbs.run(_gibbsSeconds);
+  cerr << "Evidence: ";
+  assign.print(cerr, numOfVars);
+  cerr << "Gibbs samples: " << samples << " in each of " << _gibbsChains << " chains" << endl << endl;
+  if (_printMarginals > 0) {
+    cerr << "The first " << _printMarginals << " marginals after evidence is set: " << endl;
+    gibbs.printMarginals(cerr, _printMarginals);
+    cerr << endl;
+    gibbs.printStdErrors(cerr, _printMarginals);
+  }
+}
+
 int main(int argc, char* argv[]) 
 {
   clock_t startClock = 0 ;
@@ -367,6 +442,13 @@ int main(int argc, char* argv[])
   //print initial partition as approximated by the Free Energy approximation
   cerr << "Initial Partition: " << inf->initialPartitionFunction() << endl;
 
+  //The sampling engine works on the original model (the evidence refers to its variables)
+  lbGibbsInference * gibbs = NULL;
+  int numOfVars = inf->getModel().getGraph().getNumOfVars();
+  if (_gibbsSeconds > 0) {
+    gibbs = new lbGibbsInference(_driver->getModel(), _gibbsChains, _seed);
+  }
+
   //In case we have evidence, for each instance:
   // - assign the evidence to the model
   // - print log likelihood and marginals after assigning the evidence
@@ -374,6 +456,11 @@ int main(int argc, char* argv[])
   t.restart();
   for (int i = 0; i < (int) _evidence.size(); i++) {
     t2.restart();
+    if (gibbs != NULL) {
+      sampleEvidence(*gibbs, *(_evidence[i]), numOfVars);
+      t2.check("After a piece of evidence");
+      continue;
+    }
     inf->changeEvidence(*(_evidence[i]));
     cerr << "Evidence: ";
     _evidence[i]->print(cerr, inf->getModel().getGraph().getNumOfVars());    
@@ -400,6 +487,10 @@ int main(int argc, char* argv[])
     cout << "Evidence: " << input_line << endl;
     int numvars = inf->getModel().getGraph().getNumOfVars();
     if (assign->readAssignmentFromString(input_line, numvars)) {
+      if (gibbs != NULL) {
+        sampleEvidence(*gibbs, *assign, numvars);
+        continue;
+      }
       inf->changeEvidence(*assign);
       cerr << "Evidence: ";
       assign->print(cerr, inf->getModel().getGraph().getNumOfVars());    
@@ -440,6 +531,10 @@ int main(int argc, char* argv[])
 
   cerr << "DONE!" << endl ;
   delete inf;
+  if (gibbs != NULL)
+    delete gibbs;
+  if (_autoExactModel != NULL)
+    delete _autoExactModel;
   delete _driver;
   delete _disp;
   return 0;
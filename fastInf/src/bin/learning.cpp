@@ -31,6 +31,8 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <lbBeliefPropagation.h>
 #include <GSLOptimizer.h>
 #include <lbGSLLearningObject.h>
+#include <lbStochasticLearningObject.h>
+#include <lbLearningSweep.h>
 #include <lbFeatureTableMeasure.h>
 #include <ObjectiveFunction.h>
 
@@ -77,6 +79,36 @@ double _learnStep = 0.05 ; //0.01;
 //max gradient ascent iterations
 int _learnIter = 100;
 
+//steps remembered by L-BFGS
+int _lbfgsHistory = 10;
+
+//learning objective (0 - likelihood, 1 - pseudo likelihood, 2 - piecewise)
+int _objectiveInt = 0;
+//continue with the likelihood after a local objective
+bool _localWarmStart = false;
+
+//stochastic learning over mini-batches (0 - off, 1 - SGD, 2 - Adagrad, 3 - Adam)
+int _stochasticInt = 0;
+int _batchSize = 100;
+double _stochasticRate = 0.05;
+double _stochasticDecay = 0;
+int _epochs = 10;
+
+//sweep over a grid of settings, learned concurrently (empty - no sweep)
+vector<double> _sweepMethods;
+vector<double> _sweepSmooths;
+vector<double> _sweepL1;
+vector<double> _sweepL2;
+
+//checkpoints of learning (none - no checkpoints), written every
+//_checkpointInterval L-BFGS iterations and after every EM iteration
+string _checkpointFile = "none";
+int _checkpointInterval = 10;
+//stop after this many checkpoints (0 - never)
+int _maxCheckpoints = 0;
+//continue from the checkpoint file
+bool _resume = false;
+
 //input files:
 string _inputFile = "none.net";
 string _evidenceFile = "none.assign";
@@ -91,11 +123,48 @@ bool _printBeliefs = 0;
 
 bool _changeToFeatureTable = false;
 
+//threads for going over the evidence (0 - OpenMP default)
+int _numThreads = 0;
+
+//start inference from the messages of the previous parameters
+bool _warmStart = true;
+
 
 RegularizationType _regType = REG_NONE ;
 double _regParam ;
 
 
+//comma separated list of values
+vector<double> parseList(char const* str) {
+  vector<double> values;
+  stringstream in(str);
+  string value;
+  while (getline(in, value, ','))
+    values.push_back(atof(value.c_str()));
+  assert(!values.empty());
+  return values;
+}
+
+//optimization method of the -m option
+tGSLOptimizer::tProcType methodFromInt(int method) {
+  if (method==0)
+    return tGSLOptimizer::FR;
+  else if (method==1)
+    return tGSLOptimizer::PR;
+  else if (method==2)
+    return tGSLOptimizer::BFGS;
+  else if (method==3)
+    return tGSLOptimizer::STEEP;
+  else if (method==4)
+    return tGSLOptimizer::NEWTON;
+  else if (method==5)
+    return tGSLOptimizer::GRADIENT;
+  else if (method==6)
+    return tGSLOptimizer::LBFGS;
+  assert(false);
+  return tGSLOptimizer::FR;
+}
+
 //print tunning options
 void printUsage(bool running = false) {
 
@@ -129,11 +198,29 @@ void printUsage(bool running = false) {
   cerr << "-pS [inference smoothing (" <<_infSmooth<<")]"<<endl;
   cerr << "-pC [inference compare 0-MAX, 1-KL 2-AVG (" <<_compTypeInt<<")]"<<endl;
   cerr << "-pQ [inference queue  0-Unweighted, 1-Weighted (" <<_queueTypeInt<<")]"<<endl;
-  cerr << "-m [optimization method 0-FR, 1-PR, 2-BFGS, 3-STEEP, 4-NEWTON, 5-GRADIENT ("<<_gradAscendtMethodInt<<")]"<<endl;
+  cerr << "-m [optimization method 0-FR, 1-PR, 2-BFGS, 3-STEEP, 4-NEWTON, 5-GRADIENT, 6-LBFGS ("<<_gradAscendtMethodInt<<")]"<<endl;
   cerr << "-E [EM iterations (" << _emMaxIter << ")]" << endl;
   cerr << "-Le [Learning epsilon ("<<_learnEps<<")]"<<endl;
   cerr << "-Ls [Learning step ("<<_learnStep<<")]"<<endl;
   cerr << "-Li [Learning max iterations ("<<_learnIter<<")]"<<endl;
+  cerr << "-Lh [L-BFGS history size ("<<_lbfgsHistory<<")]"<<endl;
+  cerr << "-O [objective 0-LIKELIHOOD, 1-PSEUDO likelihood, 2-PIECEWISE likelihood ("<<_objectiveInt<<")]"<<endl;
+  cerr << "-Ow [+|-] continue with the likelihood after the local objective (" << _localWarmStart << ")" << endl;
+  cerr << "-S [stochastic learning over mini-batches 0-off, 1-SGD, 2-ADAGRAD, 3-ADAM ("<<_stochasticInt<<")]"<<endl;
+  cerr << "-Sb [Stochastic batch size ("<<_batchSize<<")]"<<endl;
+  cerr << "-Sr [Stochastic learning rate ("<<_stochasticRate<<")]"<<endl;
+  cerr << "-Sd [Stochastic rate decay of SGD ("<<_stochasticDecay<<")]"<<endl;
+  cerr << "-Se [Stochastic epochs ("<<_epochs<<")]"<<endl;
+  cerr << "-Gm [sweep: comma separated optimization methods]" << endl;
+  cerr << "-GpS [sweep: comma separated inference smoothings]" << endl;
+  cerr << "-Gr1 [sweep: comma separated L1 parameters]" << endl;
+  cerr << "-Gr2 [sweep: comma separated L2 parameters]" << endl;
+  cerr << "-C [checkpoint file (" << str << _checkpointFile << ")]" << endl;
+  cerr << "-Ci [checkpoint every this many L-BFGS iterations (" << _checkpointInterval << ")]" << endl;
+  cerr << "-Cn [stop after this many checkpoints, 0 - never (" << _maxCheckpoints << ")]" << endl;
+  cerr << "--resume [continue from the checkpoint file (" << _resume << ")]" << endl;
+  cerr << "-w [+|-] warm start inference after parameter updates (" << _warmStart << ")" << endl;
+  cerr << "-T [threads for the evidence (settings of a sweep), 0 - OpenMP default (" << _numThreads << ")]" << endl;
   cerr << "-v [verbosity type]" << endl << endl;
   cerr << "Verbosities: " << endl;
   printVerbosities();
@@ -204,6 +291,100 @@ void setOptions(int argc, char* argv[]) {
       else
 	_runDTesting = true;
       break;
+    case 'O':
+      if (argv[i][2]=='\0') {
+	_objectiveInt = atoi(argv[i+1]);
+	assert(_objectiveInt >= 0 && _objectiveInt <= 2);
+      }
+      else if (argv[i][2]=='w') {
+	if ( argv[i+1][0] == '+' )
+	  _localWarmStart = true;
+	else if ( argv[i+1][0] == '-' )
+	  _localWarmStart = false;
+	else
+	  assert(false);
+      }
+      else {
+	cerr << endl << "Invalid option: " << argv[i][2] << endl << endl;
+	printUsage();
+      }
+      i++;
+      break;
+    case 'w':
+      if ( argv[i+1][0] == '+' )
+	_warmStart = true;
+      else if ( argv[i+1][0] == '-' )
+	_warmStart = false;
+      else
+	assert(false);
+      i++;
+      break;
+    case 'S':
+      if (argv[i][2]=='\0') {
+	_stochasticInt = atoi(argv[i+1]);
+	assert(_stochasticInt >= 0 && _stochasticInt <= 3);
+      }
+      else if (argv[i][2]=='b') {
+	_batchSize = atoi(argv[i+1]);
+	assert(_batchSize > 0);
+      }
+      else if (argv[i][2]=='r')
+	_stochasticRate = atof(argv[i+1]);
+      else if (argv[i][2]=='d')
+	_stochasticDecay = atof(argv[i+1]);
+      else if (argv[i][2]=='e')
+	_epochs = atoi(argv[i+1]);
+      else {
+	cerr << endl << "Invalid option: " << argv[i][2] << endl << endl;
+	printUsage();
+      }
+      i++;
+      break;
+    case '-':
+      if (string(argv[i]) == "--resume")
+	_resume = true;
+      else {
+	cerr << endl << "Invalid option: " << argv[i] << endl << endl;
+	printUsage();
+      }
+      break;
+    case 'C':
+      if (argv[i][2]=='\0')
+	_checkpointFile = argv[i+1];
+      else if (argv[i][2]=='i') {
+	_checkpointInterval = atoi(argv[i+1]);
+	assert(_checkpointInterval > 0);
+      }
+      else if (argv[i][2]=='n') {
+	_maxCheckpoints = atoi(argv[i+1]);
+	assert(_maxCheckpoints >= 0);
+      }
+      else {
+	cerr << endl << "Invalid option: " << argv[i] << endl << endl;
+	printUsage();
+      }
+      i++;
+      break;
+    case 'G':
+      if (argv[i][2]=='m')
+	_sweepMethods = parseList(argv[i+1]);
+      else if (argv[i][2]=='p' && argv[i][3]=='S')
+	_sweepSmooths = parseList(argv[i+1]);
+      else if (argv[i][2]=='r' && argv[i][3]=='1')
+	_sweepL1 = parseList(argv[i+1]);
+      else if (argv[i][2]=='r' && argv[i][3]=='2')
+	_sweepL2 = parseList(argv[i+1]);
+      else {
+	cerr << endl << "Invalid option: " << argv[i] << endl << endl;
+	printUsage();
+      }
+      i++;
+      break;
+    case 'T':
+      _numThreads = atoi(argv[i+1]);
+      assert(_numThreads >= 0);
+      i++;
+      break;
     case 'v':
       addVerbose((verbosity_type) atoi(argv[i+1]));
       i++;
@@ -256,20 +437,7 @@ void setOptions(int argc, char* argv[]) {
       break;
     case 'm':
       _gradAscendtMethodInt = atoi(argv[i+1]);
-      if (_gradAscendtMethodInt==0)
-	_gradAscendtMethod = tGSLOptimizer::FR;
-      else if (_gradAscendtMethodInt==1)
-	_gradAscendtMethod = tGSLOptimizer::PR;
-      else if (_gradAscendtMethodInt==2)
-	_gradAscendtMethod = tGSLOptimizer::BFGS;
-      else if (_gradAscendtMethodInt==3)
-	_gradAscendtMethod = tGSLOptimizer::STEEP;
-      else if (_gradAscendtMethodInt==4)
-	_gradAscendtMethod = tGSLOptimizer::NEWTON;
-      else if (_gradAscendtMethodInt==5)
-	_gradAscendtMethod = tGSLOptimizer::GRADIENT;
-      else
-	assert(false);
+      _gradAscendtMethod = methodFromInt(_gradAscendtMethodInt);
       i++;
       break;
     case 'L':
@@ -285,6 +453,11 @@ void setOptions(int argc, char* argv[]) {
 	_learnIter=atoi(argv[i+1]);
 	i++;
       }
+      else if (argv[i][2]=='h') {
+	_lbfgsHistory=atoi(argv[i+1]);
+	assert(_lbfgsHistory > 0);
+	i++;
+      }
       else {
 	cerr << endl << "Invalid option: " << argv[i][2] << endl << endl;
 	printUsage();
@@ -300,6 +473,11 @@ void setOptions(int argc, char* argv[]) {
     cerr << endl << "Infile not found." << endl << endl;
     printUsage();
   }
+
+  if (_resume && _checkpointFile == "none") {
+    cerr << endl << "--resume needs a checkpoint file (-C)." << endl << endl;
+    printUsage();
+  }
 }
 
 /*
@@ -356,33 +534,118 @@ int main(int argc, char* argv[]) {
     }
   }
 
-  lbGSLLearningObject* learner;
-    
-  cerr << "Creating learning object" << endl;
-  learner = new lbGSLLearningObject(_evidenceFile,model,*disp,
-                                    _infObjectThreshold,_compType,_infSmooth,_queueType);
-  // Regularization:
-  if (_regType == REG_L1) {
-    learner->setRegularizeParamL1 (_regParam) ;
-  }
-  else if (_regType == REG_L2) {
-    learner->setRegularizeParamL2 (_regParam) ;
+  //learning stopped at a checkpoint, to be resumed
+  bool stopped = false;
+  bool sweep = !(_sweepMethods.empty() && _sweepSmooths.empty() &&
+		 _sweepL1.empty() && _sweepL2.empty());
+  if (sweep) {
+    lbLearningSweep sweeper(model,*disp,_evidenceFile);
+    sweeper.setInference(_infObjectThreshold,_compType,_queueType);
+    sweeper.setWarmStart(_warmStart);
+    sweeper.setLBFGSHistory(_lbfgsHistory);
+    sweeper.setNumThreads(_numThreads);
+    // a list that is not given is the single value of its option
+    vector<tGSLOptimizer::tProcType> methods(1,_gradAscendtMethod);
+    if (!_sweepMethods.empty()) {
+      methods.clear();
+      for (uint m = 0; m < _sweepMethods.size(); m++)
+	methods.push_back(methodFromInt((int) _sweepMethods[m]));
+    }
+    sweeper.setMethods(methods);
+    sweeper.setSmoothings(_sweepSmooths.empty() ? vector<double>(1,_infSmooth) : _sweepSmooths);
+    for (uint r = 0; r < _sweepL1.size(); r++)
+      sweeper.addRegularization(REG_L1,_sweepL1[r]);
+    for (uint r = 0; r < _sweepL2.size(); r++)
+      sweeper.addRegularization(REG_L2,_sweepL2[r]);
+    if (_sweepL1.empty() && _sweepL2.empty() && _regType != REG_NONE)
+      sweeper.addRegularization(_regType,_regParam);
+
+    // the output net names the files of the settings and the summary
+    string prefix = (_outputFile != "none.net" ? _outputFile : string(""));
+    if (prefix.size() > 4 && prefix.substr(prefix.size() - 4) == ".net")
+      prefix = prefix.substr(0, prefix.size() - 4);
+    sweeper.run(_learnEps,_learnStep,_learnIter,_emMaxIter,prefix);
+    sweeper.printSummary(cout);
+    if (!prefix.empty()) {
+      string summaryFile = prefix + ".summary";
+      ofstream out(summaryFile.c_str());
+      sweeper.printSummary(out);
+      cerr<<"printing summary to : "<<summaryFile<<endl;
+    }
   }
-
-  if (_runDTesting) {
-    cerr << "Testing LL and derivs" << endl;
-    learner->testLikeAndDeriv(1e-5);
-  } else if ( _runHTesting ) {
-    cerr << "Testing LL and derivs" << endl;
-    learner->testDerivAndHess(1e-5);
-  } else {
+  else if (_stochasticInt > 0) {
+    cerr << "Creating stochastic learning object" << endl;
+    lbStochasticLearningObject learner(_evidenceFile,model,*disp,
+				       _infObjectThreshold,_compType,_infSmooth,_queueType);
+    learner.setUpdate((lbStochasticLearningObject::lbStochasticUpdate) (_stochasticInt-1));
+    learner.setBatchSize(_batchSize);
+    learner.setLearningRate(_stochasticRate);
+    learner.setDecay(_stochasticDecay);
+    learner.setNumThreads(_numThreads);
+    learner.setWarmStart(_warmStart);
+    if (_regType == REG_L1) {
+      learner.setRegularizeParamL1 (_regParam) ;
+    }
+    else if (_regType == REG_L2) {
+      learner.setRegularizeParamL2 (_regParam) ;
+    }
     cerr << "Learning...\n";
-    learner->learnEM(_gradAscendtMethod,_learnEps,_learnStep,_learnIter,_emMaxIter);
+    learner.learn(_epochs);
   }
+  else {
+    lbGSLLearningObject* learner;
+    
+    cerr << "Creating learning object" << endl;
+    learner = new lbGSLLearningObject(_evidenceFile,model,*disp,
+                                      _infObjectThreshold,_compType,_infSmooth,_queueType);
+    learner->setNumThreads(_numThreads);
+    learner->setWarmStart(_warmStart);
+    learner->setLBFGSHistory(_lbfgsHistory);
+    if (_checkpointFile != "none") {
+      learner->setCheckpoint(_checkpointFile,_checkpointInterval,_maxCheckpoints);
+    }
+    // a missing checkpoint starts from scratch, so a job can be
+    // submitted again with the same command line
+    bool resumed = false;
+    if (_resume) {
+      resumed = learner->resumeFromCheckpoint(_checkpointFile);
+      if (!resumed) {
+	cerr << "No checkpoint in " << _checkpointFile << ", learning from the start" << endl;
+      }
+    }
+    // Regularization:
+    if (_regType == REG_L1) {
+      learner->setRegularizeParamL1 (_regParam) ;
+    }
+    else if (_regType == REG_L2) {
+      learner->setRegularizeParamL2 (_regParam) ;
+    }
+
+    if (_runDTesting) {
+      cerr << "Testing LL and derivs" << endl;
+      learner->testLikeAndDeriv(1e-5);
+    } else if ( _runHTesting ) {
+      cerr << "Testing LL and derivs" << endl;
+      learner->testDerivAndHess(1e-5);
+    } else {
+      cerr << "Learning...\n";
+      // the checkpoint already has the result of the local objective
+      if (_objectiveInt != OBJ_LIKELIHOOD && !resumed) {
+	learner->learnLocal((lbObjectiveType) _objectiveInt,_gradAscendtMethod,_learnEps,_learnStep,_learnIter);
+      }
+      if (_objectiveInt == OBJ_LIKELIHOOD || _localWarmStart) {
+	learner->learnEM(_gradAscendtMethod,_learnEps,_learnStep,_learnIter,_emMaxIter);
+      }
+    }
+    stopped = learner->stoppedAtCheckpoint();
   
-  delete learner;
+    delete learner;
+  }
   
-  if (_outputFile != "none.net") {
+  if (stopped) {
+    cerr<<"Stopped at a checkpoint, continue with --resume -C "<<_checkpointFile<<endl;
+  }
+  else if (_outputFile != "none.net" && !sweep) {
     cerr<<"printing net to : "<<_outputFile.c_str()<<endl;
     driver->getModel().printAllNetToFile(_outputFile.c_str());
   }
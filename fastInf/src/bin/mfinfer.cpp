@@ -40,6 +40,8 @@ string _evidenceFile = "none.assign";
 fullAssignmentPtrVec _evidence;
 int _iterMethod = 0;
 bool _testOrders = false;
+double _damping = 0.5;
+int _numThreads = 0;
 
 void readEvidenceFromFile(string evidenceFileName, int n) {
 
@@ -67,7 +69,9 @@ void setOptions(lbOptions & opt, int argc, char *argv[]) {
   opt.addIntOption("b", &_printBeliefs, "print the first N clique beliefs (0 for all)");
   opt.addIntOption("m", &_printMarginals, "print the first N singleton beliefs (0 for all)");
   opt.addIntOption("s",&_seed,"initialize the random seed (0 for time)");
-  opt.addIntOption("M", &_iterMethod,"mean field iteration method (0-normal,1-residuals,2-MBresiduals,3-largest effect)");
+  opt.addIntOption("M", &_iterMethod,"mean field iteration method (0-normal,1-residuals,2-MBresiduals,3-largest effect,4-parallel colored,5-parallel damped Jacobi)");
+  opt.addDoubleOption("d", &_damping, "damping of the Jacobi updates (weight of the previous marginal, in [0,1))");
+  opt.addIntOption("T", &_numThreads, "number of threads for the parallel methods (0 for all)");
   opt.addBoolOption("t", &_testOrders, "test random round-robin orders");
 
 
@@ -76,6 +80,9 @@ void setOptions(lbOptions & opt, int argc, char *argv[]) {
   if (!opt.isOptionSetByUser("i")) {
     opt.usageError("Must give a .net file");
   }
+  if (_damping < 0 || _damping >= 1) {
+    opt.usageError("Damping must be in [0,1)");
+  }
 }
 
 lbMeanField* getInferenceObject(int argc, char * argv[]) {
@@ -102,6 +109,8 @@ lbMeanField* getInferenceObject(int argc, char * argv[]) {
 
   lbMeanField* inf = new lbMeanField(*model,*_disp);
   inf->SetIterationMethod((lbMeanField::lbMFIterMethod)_iterMethod);
+  inf->SetDamping(_damping);
+  inf->SetNumThreads(_numThreads);
 
   if ( _testOrders ) {
     inf->testRandomOrderings();
@@ -43,7 +43,8 @@ class tGSLOptimizer : public Optimizer {
     STEEP,
     SIMPLEX,
     NEWTON, // this is not really part of GSL but its convenient to put it here
-    GRADIENT
+    GRADIENT,
+    LBFGS // built in limited memory BFGS (lbLBFGSOptimizer)
   };
   
   /**
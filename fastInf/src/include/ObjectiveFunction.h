@@ -47,6 +47,7 @@ class ObjectiveFunction {
  public:
   ObjectiveFunction() {
     _regularizer = NULL ;
+    _regScale = 1.0 ;
   }
 
   virtual ~ObjectiveFunction() {
@@ -76,6 +77,18 @@ class ObjectiveFunction {
   virtual void ddf (long double const* p, long double** res) {
     cerr << "Hessian not implemented yet.\n"; assert(false);
   }
+
+  /**
+   * Returns the sizes of the blocks along the diagonal of the hessian, in
+   * the order of the parameters (entries out of the blocks are taken as
+   * zero). By default the hessian is a single dense block. */
+  virtual vector<int> hessianBlocks() const { return vector<int>(1, paramNum()); }
+
+  /**
+   * Calculates the blocks of the hessian given by hessianBlocks(), one
+   * after the other in res, each as a dense row major matrix. By default
+   * the single block is copied from ddf. */
+  virtual void ddfBlocks (long double const* p, long double* res);
   
   /**
    * Returns the number of parameters for this objective function. */
@@ -113,15 +126,24 @@ class ObjectiveFunction {
     _regularizer->setRegParam(sigmaSq) ;
   };
 
+  /**
+   * Scales the penalty and its derivative, e.g. to the part of the
+   * evidence in a mini-batch when the objective is that of the batch. */
+  void setRegularizeScale(double scale) { _regScale = scale; };
+
   virtual double regPenalty(long double const* p, int size) const {
     if (regularize())
-      return _regularizer->regPenalty (p,size) ;
+      return _regScale * _regularizer->regPenalty (p,size) ;
     NOT_REACHED ; // should not reach here
     return 0.0 ;
   }
   virtual void dRegPenalty(long double const* p, int size, long double* res) const {
-    if (regularize())
+    if (regularize()) {
       _regularizer->dRegPenalty (p,size,res) ;
+      if (_regScale != 1.0)
+        for ( int i=0 ; i<size ; i++ )
+          res[i] *= _regScale ;
+    }
     else
       NOT_REACHED ; // should not reach here
   }
@@ -137,6 +159,7 @@ class ObjectiveFunction {
   static bool   POS_LOG_PARAMS;
 
   Regularizer * _regularizer ;
+  double _regScale ;
 
 
   // Regularization:
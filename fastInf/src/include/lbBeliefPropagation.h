@@ -54,6 +54,9 @@ namespace lbLib {
 
     virtual void changeEvidence(lbAssignment const& assign,bool forceUpdate = false);
 
+    // A fresh engine with the settings of this one (no messages or evidence)
+    virtual lbInferenceObject* duplicate() const;
+
     // Main method for running inference needs to be public so that
     // users can control when the bulk of the processing happens if
     // they would like.  Also called automatically from functions such
@@ -107,6 +110,12 @@ namespace lbLib {
 
     int getMessageCount() const { return _messageCount; }
 
+    // propagations run and messages sent over all of them since the
+    // last resetRunStatistics()
+    int getNumOfRuns() const { return _numOfRuns; }
+    long getTotalMessageCount() const { return _totalMessageCount; }
+    void resetRunStatistics() { _numOfRuns = 0; _totalMessageCount = 0; }
+
     // Compute a message
     virtual lbAssignedMeasure_ptr computeMessage(messageIndex messIndex) const;
 
@@ -196,6 +205,8 @@ namespace lbLib {
     clock_t _lastUpdateT;
 
     int _messageCount;
+    int _numOfRuns;
+    long _totalMessageCount;
     int _maxMessages;
     int _maxSeconds;
     int _updateSize;
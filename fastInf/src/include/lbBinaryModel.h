@@ -0,0 +1,146 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Binary__Model
+#define _Binary__Model
+
+#include <lbDefinitions.h>
+#include <stdint.h>
+#include <fstream>
+
+namespace lbLib {
+
+  /*!
+     Header of a binary model file.
+
+     A binary model holds what a .net file holds, laid out so that it
+     is loaded without parsing. After the header come the variables
+     (name and cardinality), the cliques (variables and neighbors), the
+     measures (name, cardinalities, shared and idle entries), the
+     clique to measure map, the list of directed measures and the exact
+     beliefs of the cliques, if the model has them. The log
+     values of all the measures follow in one flat table of probType
+     (so a model is loaded with the exact values it was written with),
+     aligned to its size, in the order of the measures.
+
+     Integers are 32 bit and strings are a length and the characters,
+     padded to 4 bytes. Everything is in the byte order and the probType
+     of the machine that wrote the file, other files are rejected.
+
+     Part of the fastInf library
+  */
+  struct lbBinaryModelHeader {
+    char magic[8];
+    int32_t version;
+    int32_t byteOrder;
+    int32_t valueSize;
+    int32_t reserved;
+    // position of the table in the file and its number of values
+    int64_t tableOffset;
+    int64_t tableSize;
+  };
+
+  /*!
+     Writes a binary model file (see lbBinaryModelHeader). The log
+     values are kept until close(), which appends them as the table and
+     writes the header.
+
+     Part of the fastInf library
+  */
+  class lbBinaryModelWriter {
+  public:
+    lbBinaryModelWriter();
+    ~lbBinaryModelWriter();
+
+    bool open(string const& fileName);
+    // returns false if some write failed
+    bool close();
+
+    void writeInt(int val);
+    // the size of vec and its entries
+    void writeInts(intVec const& vec);
+    void writeString(string const& str);
+    // the next entry of the table
+    void writeLogValue(probType val);
+
+  private:
+    void pad(int alignment);
+
+    ofstream _out;
+    vector<probType> _table;
+  };
+
+  /*!
+     Reads a binary model file (see lbBinaryModelHeader). The file is
+     mapped into memory and the reads return pointers into the mapping,
+     so nothing is parsed or buffered on the way (the measures copy
+     their values from the table into their own). The pointers are
+     valid until the reader is destroyed.
+
+     Reading past the end of a section means the file is corrupted, and
+     exits with an error.
+
+     Part of the fastInf library
+  */
+  class lbBinaryModelReader {
+  public:
+    lbBinaryModelReader();
+    ~lbBinaryModelReader();
+
+    // whether the file starts with the magic of a binary model
+    static bool isBinaryModel(string const& fileName);
+
+    // map the file and check its header
+    bool open(string const& fileName);
+    void close();
+
+    int readInt();
+    // count integers
+    int const* readInts(int count);
+    // the size and the entries of a vector written by writeInts()
+    intVec readIntVec();
+    string readString();
+    // the next count entries of the table
+    probType const* readLogValues(int count);
+
+    static const char MAGIC[8];
+    static const int32_t VERSION;
+    static const int32_t BYTE_ORDER_MARK;
+
+  private:
+    lbBinaryModelReader(lbBinaryModelReader const&);
+    void operator=(lbBinaryModelReader const&);
+
+    char const* take(size_t bytes);
+    void corrupted() const;
+
+    char const* _data;
+    size_t _size;
+    string _fileName;
+    // the next byte of the sections and the next entry of the table
+    size_t _pos;
+    size_t _end;
+    probType const* _table;
+    size_t _tableSize;
+    size_t _tablePos;
+  };
+};
+
+#endif
@@ -751,6 +751,10 @@ inline bool vecEqual(strNameVec const& v1, strNameVec const& v2) {\
     cerr << endl;
   }
 
+  // wall clock seconds, finer than the whole seconds of time() (work
+  // running on several threads would use up cpu time too early)
+  double wallTime();
+
   inline void clearVerbose() {
     assert (checkVerbosity());
     lbDefinitions::_verbosity = 0;
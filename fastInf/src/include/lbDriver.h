@@ -49,6 +49,8 @@ namespace lbLib {
     
     ~lbDriver();
     
+    // reads a .net file or a binary model (see lbBinaryModelHeader),
+    // which is recognized by its first bytes
     bool readUniverse(string inputFileName, bool readLogValues = false);
 
     static void writeUniverse(lbModel const& model, string outputFileName,
@@ -56,6 +58,10 @@ namespace lbLib {
     
     static void writeUniverse(lbModel const& model, ostream& os,
 			      bool writeLogValues = false);
+
+    // writes the model as a binary model, which readUniverse() loads
+    // without parsing
+    static bool writeBinaryUniverse(lbModel const& model, string outputFileName);
     
     //method that exits the universe
     void exitDriver(string msg);
@@ -84,6 +90,8 @@ namespace lbLib {
 
     bool readExact(ifstream_ptr in, lbModel *model);
 
+    bool readBinaryUniverse(string inputFileName);
+
 
     //Constants for the driver :
     
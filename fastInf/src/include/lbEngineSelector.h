@@ -0,0 +1,95 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Loopy__Engine__Selector
+#define _Loopy__Engine__Selector
+
+#include <lbDefinitions.h>
+#include <lbModel.h>
+#include <lbJunctionTree.h>
+
+namespace lbLib {
+
+  typedef enum { ET_EXACT, ET_LOOPY_BP } lbEngineType;
+
+  typedef enum { EA_EXACT, EA_APPROX } lbEngineAccuracy;
+
+  /*!
+     Chooses an inference engine for a model before running it.
+
+     The cost of exact inference is estimated by a quick (min-fill)
+     triangulation of the model: calibrating the junction tree touches
+     every clique table a small, fixed number of times. The cost of loopy BP is predicted
+     from the size of the clique graph and its degrees: each sweep
+     sends one message along every edge, and the number of sweeps is
+     guessed from the average variable degree (two sweeps are enough
+     when the clique graph is already a junction tree).
+
+     The selector returns the cheapest engine that meets the required
+     accuracy. If exact answers are required but the junction tree is
+     too large, loopy BP is returned and the report says so.
+
+     Costs are in log_10 of table entries touched; they are meant for
+     comparing engines, not as run time predictions.
+
+     Part of the fastInf library
+  */
+  class lbEngineSelector {
+  public:
+    lbEngineSelector(lbModel const& model, lbEngineAccuracy accuracy = EA_APPROX);
+
+    lbEngineType select();
+
+    realVal getExactLog10Cost() const { return _exactCost; }
+    realVal getBPLog10Cost() const { return _bpCost; }
+    int getTreewidth() const { return _treewidth; }
+    bool isExactFeasible() const { return _exactFeasible; }
+    bool isJunctionTree() const { return _isJunctionTree; }
+
+    //print the estimates and the choice made by the last call to select()
+    void print(ostream& out) const;
+
+    static string getEngineName(lbEngineType engine);
+    //parses "exact" / "approx", returns false for anything else
+    static bool readAccuracy(string const& str, lbEngineAccuracy& accuracy);
+
+  private:
+    void estimateExactCost();
+    void estimateBPCost();
+    bool graphIsJunctionTree() const;
+
+    lbModel const& _model;
+    lbEngineAccuracy _accuracy;
+
+    realVal _exactCost;
+    realVal _jtWeight;
+    int _treewidth;
+    bool _exactFeasible;
+
+    realVal _bpCost;
+    realVal _bpSweeps;
+    bool _isJunctionTree;
+
+    lbEngineType _choice;
+    string _reason;
+  };
+};
+
+#endif
@@ -0,0 +1,135 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Evidence__Matrix
+#define _Evidence__Matrix
+
+#include <lbDefinitions.h>
+#include <lbAssignment.h>
+#include <stdint.h>
+
+namespace lbLib {
+
+  /*!
+     The rows of an evidence file, parsed into one packed matrix.
+
+     Every row of the file is "( v1 v2 ... vn )", with ? for a variable
+     that is not observed, optionally followed by the weight of the
+     row. The values of row r are entries r*n to r*n+n-1 of the matrix,
+     one byte each when every variable has at most 128 values and two
+     bytes otherwise, with -1 for the unobserved ones. So a file of
+     many rows takes a few bytes a value and no allocation a row, and
+     an lbFullAssignment is made only for the rows that need one. The
+     same packing keeps the distinct fully observed rows of the evidence
+     for as long as learning needs them (see lbSuffStat).
+
+     Files are read in large blocks and parsed in place, without going
+     through a stream a token at a time. A large block is split at line
+     boundaries between threads and the parts are appended in order, so
+     the matrix does not depend on the number of threads.
+
+     Part of the fastInf library
+  */
+  class lbEvidenceMatrix {
+  public:
+    // values are checked against the cardinalities of the variables
+    lbEvidenceMatrix(cardVec const& cards);
+
+    // read all the rows of a file, with threads (0 - OpenMP default)
+    // for large files. Returns false if the file can not be opened.
+    bool readFile(string const& fileName, int threads = 0);
+    // read up to maxRows rows (all if maxRows <= 0) of a stream,
+    // leaving it at the next line. Returns the number of rows read.
+    int readStream(istream& in, int maxRows = 0);
+    void clear();
+
+    int getNumOfVars() const { return _numOfVars; }
+    int getNumOfRows() const { return _weights.size(); }
+    // the value of var in row (-1 if it is not observed)
+    inline int getValue(int row, rVarIndex var) const;
+    probType getWeight(int row) const { return _weights[row]; }
+    // the values of row (-1 for unobserved variables)
+    void getRow(int row, int* values) const;
+    // the values of rows [begin,end), a row after the other
+    void getRows(int begin, int end, int* values) const;
+    bool isFullyObserved(int row) const;
+    // a new assignment holding row, owned by the caller
+    lbFullAssignment_ptr makeAssignment(int row) const;
+
+    // add row of other (over the same variables) at the end with weight
+    void appendRow(lbEvidenceMatrix const& other, int row, probType weight);
+    void addWeight(int row, probType weight) { _weights[row] += weight; }
+
+    // the first row of every distinct row (regardless of weights) in
+    // order in distinct, and the index in distinct of every row in rowOf.
+    // Rows are hashed and compared where they lie, without copying them.
+    void findDistinctRows(intVec& distinct, intVec& rowOf) const;
+
+    // bytes a value takes in the matrix
+    int getValueSize() const { return _wide ? sizeof(int16_t) : sizeof(int8_t); }
+    // the lines (from 1) that are not rows of the file
+    intVec const& getBadLines() const { return _badLines; }
+
+  private:
+    // parse the lines in [begin,end), splitting them between threads
+    // when there are enough of them
+    void parseBlock(char const* begin, char const* end, int threads);
+    void parseLines(char const* begin, char const* end);
+    // 1 if the line is a row, 0 if it is blank and -1 if it is malformed
+    int parseLine(char const* begin, char const* end);
+    // add the rows and lines of other after ours
+    void append(lbEvidenceMatrix const& other);
+    inline void setValue(long index, int value);
+    // the packed values of row, getNumOfVars()*getValueSize() bytes
+    inline char const* rowData(int row) const;
+    void resizeValues(long size);
+
+    int _numOfVars;
+    cardVec _cards;
+    bool _wide;
+    vector<int8_t> _values8;
+    vector<int16_t> _values16;
+    probVector _weights;
+    // lines parsed so far (including blank and malformed ones)
+    int _numOfLines;
+    intVec _badLines;
+  };
+
+  inline int lbEvidenceMatrix::getValue(int row, rVarIndex var) const {
+    long index = (long) row * _numOfVars + var;
+    return _wide ? _values16[index] : _values8[index];
+  }
+
+  inline char const* lbEvidenceMatrix::rowData(int row) const {
+    long index = (long) row * _numOfVars;
+    return _wide ? (char const*) &_values16[index] : (char const*) &_values8[index];
+  }
+
+  inline void lbEvidenceMatrix::setValue(long index, int value) {
+    if (_wide) {
+      _values16[index] = value;
+    }
+    else {
+      _values8[index] = value;
+    }
+  }
+};
+
+#endif
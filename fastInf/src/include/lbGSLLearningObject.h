@@ -25,6 +25,9 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <lbInferenceObject.h>
 #include <lbSuffStat.h>
 #include <ObjectiveFunction.h>
+#include <lbLocalLikelihood.h>
+#include <lbLBFGSOptimizer.h>
+#include <lbLearningCheckpoint.h>
 
 namespace lbLib {
 
@@ -49,6 +52,10 @@ namespace lbLib {
     virtual long double fdf(long double const* p, long double* res) ;
     virtual void endIteration(int iter, probType * sum = NULL, probType * cnt = NULL, string dumpprefix = string(""));
     virtual void ddf(long double const* p, long double** res) ;
+    // one block for the parameters of every measure (the covariance of
+    // its features, ignoring the covariance between different cliques)
+    virtual vector<int> hessianBlocks() const;
+    virtual void ddfBlocks(long double const* p, long double* res);
     inline virtual int paramNum() const;
 
   protected:
@@ -62,12 +69,18 @@ namespace lbLib {
     lbSuffStat& _suff;
 
   private:
+    // the undirected measures of the set and the offset of every one in
+    // the gradient (in the blocks of ddfBlocks() if blocks is true).
+    // Returns the total length.
+    int derivLayout(measIndicesVec& measures, intVec& offsets, bool blocks) const;
+    int numThreads() const;
+
     int _vecSize;
     set<measIndex> _measSet;
     lbModel* _tmpModel;
   };  
   
-  class lbGSLLearningObject {
+  class lbGSLLearningObject : public lbOptimizerCheckpointer {
 
   public:
 
@@ -102,8 +115,48 @@ namespace lbLib {
     void testLikeAndDerivByMeasure(probType LOC_EPS = 0.00001);
     void testDerivAndHess(probType LOC_EPS = 0.00001);
 
-    void setRegularizeParamL1(double beta) { _objFunc->setRegularizeParamL1(beta); }
-    void setRegularizeParamL2(double sigmaSq) { _objFunc->setRegularizeParamL2(sigmaSq); }
+    // learn the undirected measures with the pseudo likelihood or the
+    // piecewise likelihood, which need no inference (see
+    // lbLocalLikelihood), e.g. before learnEM() to start it close. It
+    // writes no checkpoints, so a run resumed from one of learnEM()
+    // skips it
+    probType learnLocal(lbObjectiveType type, tGSLOptimizer::tProcType method = tGSLOptimizer::LBFGS,
+			probType LEARN_EPS = 1e-3, probType step = 0.01, int maxIter = 100);
+
+    void setRegularizeParamL1(double beta) { _objFunc->setRegularizeParamL1(beta); _regType = REG_L1; _regParam = beta; }
+    void setRegularizeParamL2(double sigmaSq) { _objFunc->setRegularizeParamL2(sigmaSq); _regType = REG_L2; _regParam = sigmaSq; }
+
+    // threads for the sufficient statistics (0 - OpenMP default)
+    void setNumThreads(int threads) { _suffStat->setNumThreads(threads); }
+
+    // start inference after a parameter update from the messages of the
+    // previous run (on by default when the learner makes the suff stats,
+    // suff stats given to the constructor keep their own setting)
+    void setWarmStart(bool warm) { _suffStat->setWarmStart(warm); }
+
+    // steps remembered by the LBFGS method
+    void setLBFGSHistory(int size) { assert(size > 0); _lbfgsHistory = size; }
+
+    // propagations and messages of the inference object during learnEM()
+    void printInferenceStatistics(ostream& out) const;
+
+    /*!
+      write the state of learnEM() to fileName (see lbLearningCheckpoint)
+      after every EM iteration and every interval iterations of the
+      LBFGS method, and stop after maxCheckpoints checkpoints if it is
+      positive (e.g. to split a long job into shorter runs). Inference
+      starts from scratch after a checkpoint, as it does when resuming
+      from it, so a resumed run gives the results of an uninterrupted one.
+     */
+    void setCheckpoint(string const& fileName, int interval = 10, int maxCheckpoints = 0);
+    // continue the next learnEM() from a checkpoint file, returns false
+    // if it can not be read
+    bool resumeFromCheckpoint(string const& fileName);
+    // the last learnEM() stopped after maxCheckpoints checkpoints
+    bool stoppedAtCheckpoint() const { return _stopped; }
+
+    // a checkpoint inside the M step (called by the LBFGS method)
+    virtual bool checkpoint(lbLBFGSOptimizer const& opt);
 
   protected: //functions
     probType learnDirected() ;
@@ -135,6 +188,32 @@ namespace lbLib {
     bool _ownSuffStat;  // does learning object own the suff stats?
     bool _ownObjFunc;
 
+    int _lbfgsHistory;
+
+    // the regularization, for the local objectives
+    RegularizationType _regType;
+    double _regParam;
+
+    // checkpoints of learnEM(), written in the EM iteration _emIter of
+    // the method _emMethod, whose EM iterations so far reached _emLike
+    string _checkpointFile;
+    int _checkpointInterval;
+    int _maxCheckpoints;
+    int _numOfCheckpoints;
+    bool _stopped;
+    int _emIter;
+    probType _emLike;
+    tGSLOptimizer::tProcType _emMethod;
+    // the checkpoint to continue from, and whether its optimizer state
+    // is still to be used by learnUndirected()
+    bool _resume;
+    bool _resumeOptimizer;
+    lbLearningCheckpoint _resumeState;
+
+  private:
+    // write a checkpoint (inside the M step if opt is not NULL) and
+    // restart inference. Returns false when learning should stop.
+    bool writeCheckpoint(lbLBFGSOptimizer const* opt);
   };
 
   inline void GSLFuncWrapper::setMeasureSet(set<measIndex> const& measSet) {
@@ -0,0 +1,153 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Gibbs__Converge__Statistic
+#define _Gibbs__Converge__Statistic
+
+#include <lbDefinitions.h>
+#include <lbModel.h>
+#include <lbAssignment.h>
+
+namespace lbLib {
+
+  /*!
+     Gelman-Rubin convergence test over several Gibbs chains.
+
+     The statistics are the sufficient statistics of the model: one per
+     entry of every measure, counting the cliques of the measure that
+     are at that entry (entries are numbered measure after measure, the
+     last variable of a measure changing fastest). Each call to
+     updateStats() adds the current assignments of the chains as one
+     sample, and didConverge() compares the variance within the chains
+     to the variance between them.
+
+     Only the running sums of every chain are kept. An update looks up
+     one entry per clique and touches only the statistics that are not
+     zero in the sample, so it costs O(cliques) per chain and does not
+     allocate. The test can be limited to some of the statistics, which
+     keeps didConverge() cheap on large models.
+
+     Part of the fastInf library
+  */
+  class lbGibbsConvergeStatistic {
+
+  public:
+    lbGibbsConvergeStatistic (safeVec<lbAssignment_ptr> const& assignsVec,
+			      lbModel const& model,
+			      double convergeThresh = 1.05) ;
+
+    // the chains given by their values, indexed by variable
+    lbGibbsConvergeStatistic (vector<intVec> const& valuesVec,
+			      lbModel const& model,
+			      double convergeThresh = 1.05) ;
+
+    // add the current assignment of every chain as a sample
+    void updateStats (safeVec<lbAssignment_ptr> const& assignsVec) ;
+    void updateStats (vector<intVec> const& valuesVec) ;
+
+    bool didConverge() const ;
+
+    // check only these statistics (empty - all of them)
+    void setStatistics (intVec const& stats) { _checked = stats ; }
+    // check only the statistics of these measures
+    void setMeasures (measIndicesVec const& measures) ;
+
+    int getNumOfSamples() const { return _numOfSamples_ ; }
+    int getNumOfStatistics() const { return _numOfStatistics_ ; }
+
+    void printStats (ostream & out) const ;
+
+  private:
+    void initialize (int numOfChains) ;
+
+    template <class T>
+    void addChain (int chain, T const& values) ;
+
+    inline static int valueOf (lbAssignment_ptr const& assign, rVarIndex var) {
+      return assign->getValueForVar(var) ;
+    }
+    inline static int valueOf (intVec const& values, rVarIndex var) {
+      return values[var] ;
+    }
+
+    // sum and sum of squares of a statistic in a chain
+    inline double & sum (int stat, int chain) { return _sum[stat*_numOfChains_+chain] ; }
+    inline double sum (int stat, int chain) const { return _sum[stat*_numOfChains_+chain] ; }
+    inline double & sum2 (int stat, int chain) { return _sum2[stat*_numOfChains_+chain] ; }
+    inline double sum2 (int stat, int chain) const { return _sum2[stat*_numOfChains_+chain] ; }
+
+    bool statConverged (int stat) const ;
+
+    const lbModel & _model_ ;
+
+    int _numOfChains_ ;
+    int _numOfSamples_ ;
+
+    int _numOfStatistics_ ;
+
+    double _convergenceThreshold_ ;
+
+    // first statistic of every measure
+    intVec _measOffset ;
+    // for every clique: its first statistic, and its variables with their strides
+    intVec _cliqOffset ;
+    intVec _cliqBegin ;
+    intVec _cliqVars ;
+    intVec _cliqStrides ;
+
+    // statistics (chain is the fastest index):
+    vector<double> _sum ;
+    vector<double> _sum2 ;
+    vector<double> _totalSum ;
+
+    // counts of the current sample, and the statistics they touched
+    intVec _counts ;
+    intVec _touched ;
+
+    intVec _checked ;
+  } ;
+
+  template <class T>
+  void lbGibbsConvergeStatistic::addChain (int chain, T const& values) {
+    int numOfCliques = _cliqOffset.size() ;
+    for (int cliq=0 ; cliq<numOfCliques ; ++cliq) {
+      int stat = _cliqOffset[cliq] ;
+      for (int k=_cliqBegin[cliq] ; k<_cliqBegin[cliq+1] ; ++k) {
+	stat += valueOf(values,_cliqVars[k]) * _cliqStrides[k] ;
+      }
+      if (_counts[stat]++ == 0) {
+	_touched.push_back(stat) ;
+      }
+    }
+
+    // statistics that are zero in this sample do not change the sums
+    for (uint i=0 ; i<_touched.size() ; ++i) {
+      int stat = _touched[i] ;
+      double statCount = _counts[stat] ;
+      sum(stat,chain)  += statCount ;
+      sum2(stat,chain) += statCount*statCount ;
+      _totalSum[stat]  += statCount ;
+      _counts[stat] = 0 ;
+    }
+    _touched.clear() ;
+  }
+};
+
+#endif
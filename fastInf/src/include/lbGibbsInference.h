@@ -0,0 +1,104 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Gibbs__Inference
+#define _Gibbs__Inference
+
+#include <lbDefinitions.h>
+#include <lbModel.h>
+#include <lbAssignment.h>
+#include <lbGibbsSampler.h>
+
+namespace lbLib {
+
+  /*!
+     Anytime estimate of the single variable marginals by Gibbs sampling.
+
+     The engine keeps several chains (chromatic sweeps by default) and,
+     for every evidence, runs them for a fixed time: the first part of
+     it is burn in and after that every sweep adds a sample. A sample
+     adds the full conditional of every variable given the rest of its
+     chain rather than its value (Rao-Blackwellization), which gives the
+     same mean with a lower variance. The chains stay where they were
+     between two evidences, so the next burn in starts close.
+
+     The marginal is the average of the chains, and its standard error
+     is computed from the spread of the chain averages, which does not
+     assume the samples of a chain are independent. The answer is ready
+     when the time is up however the model behaves, which makes it a
+     fallback for evidence on which loopy BP does not converge.
+
+     Part of the fastInf library
+  */
+  class lbGibbsInference {
+  public:
+    lbGibbsInference(lbModel const& model, int numOfChains = 4, unsigned long seed = 0);
+
+    // the assigned variables of assign are observed, the rest are not
+    void changeEvidence(lbAssignment const& assign);
+    void resetEvidence();
+
+    // sample for the given number of seconds, the first getBurnIn() of
+    // them without keeping samples. Returns the number of samples.
+    int run(double seconds);
+    // the same with a given number of sweeps (for repeatable runs)
+    int runSweeps(int burnIn, int sweeps);
+
+    // part of the time of run() that is burn in
+    void setBurnIn(double fraction) { assert(fraction >= 0 && fraction < 1); _burnIn = fraction; }
+    double getBurnIn() const { return _burnIn; }
+    // add conditionals (true) or values (false) as samples
+    void setRaoBlackwell(bool rb) { _raoBlackwell = rb; }
+
+    // estimated marginal of var and its standard error
+    probVector getMarginal(rVarIndex var) const;
+    probVector getStdError(rVarIndex var) const;
+    int getNumOfSamples() const { return _numOfSamples; }
+
+    // the first k marginals, in the layout of lbInferenceMonitor, and
+    // their standard errors
+    void printMarginals(ostream& out, int k) const;
+    void printStdErrors(ostream& out, int k) const;
+
+    lbGibbsSampler& getSampler() { return _sampler; }
+
+  private:
+    // forget the samples of the last evidence
+    void clearSamples();
+    // add the current state of every chain as a sample
+    void addSamples();
+
+    lbModel const& _model;
+    lbGibbsSampler _sampler;
+    int _numOfVars;
+    int _numOfChains;
+
+    // first entry of every variable in the sums
+    intVec _offsets;
+    // sums of the samples of every chain
+    vector<probVector> _sums;
+    int _numOfSamples;
+
+    double _burnIn;
+    bool _raoBlackwell;
+  };
+};
+
+#endif
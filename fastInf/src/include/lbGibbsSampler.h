@@ -0,0 +1,290 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Gibbs__Sampler
+#define _Gibbs__Sampler
+
+#include <lbDefinitions.h>
+#include <lbModel.h>
+#include <lbAssignment.h>
+#include <lbRandomProb.h>
+#include <lbGibbsConvergeStatistic.h>
+
+namespace lbLib {
+
+  /*!
+     Single site Gibbs sampler running several chains of the same model.
+
+     Every chain owns its assignment and its own stream of a counter
+     based generator, split from the seed of the sampler by the index of
+     the chain, so the chains are independent and a run is reproducible
+     regardless of the number of threads. The chains are advanced concurrently (one chain
+     per thread) between synchronization points, where they are compared
+     by the Gelman-Rubin statistic.
+
+     With the chromatic scan a chain is advanced by sweeps over a
+     coloring of the variables: variables of the same color do not share
+     a clique, so they are conditionally independent given the rest and
+     are resampled concurrently. The random numbers of a color class are
+     drawn in order before it is updated, so the result does not depend
+     on the number of threads either.
+
+     Variables given as evidence keep their values in every chain and
+     are never resampled.
+
+     Each chain can be given a temperature (its conditionals are raised
+     to the power 1/temp) and the sampler can use metropolized Gibbs
+     steps, which always propose a value different from the current one.
+
+     The blocked scan partitions the variables into blocks whose
+     interactions form a tree: a block is grown from a root by adding
+     variables that have exactly one neighbor already in the block.
+     Given the rest of the chain every block is then a tree model, and
+     it is resampled jointly and exactly by passing messages to the root
+     and sampling back down (forward filtering, backward sampling).
+     Blocks that do not touch each other are resampled concurrently.
+     Metropolis steps do not apply to blocks.
+
+     For replica exchange (parallel tempering) the chains form a ladder
+     of temperatures, chain 0 being the coldest. The chains run
+     concurrently and, every getSwapInterval() steps, neighboring rungs
+     try to exchange their states (even pairs and odd pairs in turns).
+     The log likelihood of every chain is updated with every change of
+     a value, so a swap test does not look at the model.
+
+     The clique tables are compiled into flat arrays when the sampler is
+     built. The chains keep their values in plain arrays, and the full
+     conditional of a variable is a strided gather over the tables of its
+     cliques into a buffer on the stack, so a step does no allocation and
+     no map lookups. Call compile() after the model parameters change.
+
+     Part of the fastInf library
+  */
+  class lbGibbsSampler {
+  public:
+    // GS_RANDOM updates a random variable at every step, GS_CHROMATIC
+    // updates all variables of one color at a time, GS_BLOCKED updates
+    // tree shaped blocks of variables jointly
+    typedef enum { GS_RANDOM, GS_CHROMATIC, GS_BLOCKED } lbGibbsScan;
+
+    // conditionals of variables with up to this many values are
+    // computed on the stack
+    static const int MAX_STACK_CARD = 64;
+
+    lbGibbsSampler(lbModel const& model, int numOfChains = 1, unsigned long seed = 0);
+    ~lbGibbsSampler();
+
+    // draw a uniformly random assignment for every chain
+    void initChains();
+
+    // do steps single site updates in every chain, chains run in parallel.
+    // In chromatic and blocked scans this is rounded up to whole sweeps.
+    void run(int steps);
+    // run every chain for the given number of seconds
+    void runForTime(double seconds);
+    // run a single chain
+    void runChain(int chain, int steps);
+    void runChainForTime(int chain, double seconds);
+
+    // run until the Gelman-Rubin test passes or maxSteps steps were done
+    // in every chain. The chains are synchronized and sampled for the
+    // test every getSyncInterval() steps and the test is checked every
+    // checkInterval samples. If seconds is positive, stop after that
+    // long instead of after maxSteps. Returns the number of steps done
+    // in every chain.
+    int runUntilConverged(int maxSteps, int checkInterval = 50, double seconds = 0);
+    bool didConverge() const { return _converged; }
+
+    // replica exchange: chain i runs at temps[i] (increasing, temps[0]
+    // is usually 1). A geometric ladder goes from 1 to maxTemp.
+    void setTemperatureLadder(vector<double> const& temps);
+    void setGeometricLadder(double maxTemp);
+    // run steps steps in every chain with swap attempts every
+    // getSwapInterval() steps (or run for the given number of seconds if
+    // it is positive). Returns the number of steps done in every chain.
+    int runTempering(int steps, double seconds = 0);
+    // one round of swap attempts between neighboring rungs
+    void swapReplicas();
+    void setSwapInterval(int steps) { assert(steps > 0); _swapInterval = steps; }
+    int getSwapInterval() const { return _swapInterval; }
+    int getSwapAttempts() const { return _swapAttempts; }
+    int getSwapAccepts() const { return _swapAccepts; }
+
+    // log likelihood (unnormalized, at temperature 1) of the current
+    // state of a chain, maintained when running a temperature ladder
+    probType getLogLikelihood(int chain) const { return _logLik[chain]; }
+    // the same computed from scratch
+    probType computeLogLikelihood(int chain) const;
+
+    // one single site update of a random variable of chain
+    void step(int chain);
+    // update every variable of chain once, one color class at a time
+    void sweep(int chain);
+    // update every block of chain once, blocks of one color at a time
+    void blockSweep(int chain);
+
+    // rebuild the flat tables from the model
+    void compile();
+
+    int getNumOfChains() const { return _chains.size(); }
+    // the current assignment of a chain (a copy of its state)
+    lbAssignment const& getChain(int chain);
+    safeVec<lbAssignment_ptr> const& getChains();
+    inline int getValue(int chain, rVarIndex var) const;
+    // start a chain from the given assignment
+    void setChain(int chain, lbAssignment const& assign);
+    // fix the assigned variables of assign in every chain (the other
+    // variables are sampled), and release them
+    void setEvidence(lbAssignment const& assign);
+    void resetEvidence();
+    bool isObserved(rVarIndex var) const { return _observed[var]; }
+    // normalized full conditional of var in chain (card entries)
+    void getConditional(int chain, rVarIndex var, probType* dist) const;
+    void swapChains(int chain1, int chain2);
+    lbCounterGenerator& getGenerator(int chain) { return _generators[chain]; }
+
+    void setTemperature(double temp);
+    void setTemperature(int chain, double temp) { _temps[chain] = temp; }
+    double getTemperature(int chain) const { return _temps[chain]; }
+
+    void setMetropolis(bool metropolis) { _metropolis = metropolis; }
+
+    void setScan(lbGibbsScan scan);
+    lbGibbsScan getScan() const { return _scan; }
+    int getNumOfColors() const { return _colors.size(); }
+    // largest block of the blocked scan (0 - no limit)
+    void setMaxBlockSize(int size);
+    int getNumOfBlocks() const { return _blocks.size(); }
+    intVec const& getBlock(int block) const { return _blocks[block]; }
+
+    // number of steps between two samples of the convergence test
+    void setSyncInterval(int steps) { assert(steps > 0); _syncInterval = steps; }
+    int getSyncInterval() const { return _syncInterval; }
+
+    void setConvergenceThreshold(double thresh) { _convergeThresh = thresh; }
+    // run the convergence test only on the statistics of these measures
+    void setConvergenceMeasures(measIndicesVec const& measures) { _checkedMeasures = measures; }
+
+    // threads for running the chains and the color classes (0 - OpenMP default)
+    void setNumThreads(int threads) { _numThreads = threads; }
+
+  private:
+    // one clique in the conditional of a variable: the value for val is
+    // table[offset + val * stride], where the offset is the sum of
+    // value * stride over the other variables of the clique, which are
+    // [begin,end) in _otherVars and _otherStrides
+    struct lbConditionalTerm {
+      probType const* table;
+      int stride;
+      int begin;
+      int end;
+    };
+
+    // a clique of a block, assigned to its block variable that is
+    // farthest from the root. The only other variable of the block it
+    // may have is the parent of that variable (parentStride is zero
+    // otherwise).
+    struct lbBlockTerm {
+      int cliq;
+      int stride;
+      int parentStride;
+    };
+
+    // resample var in chain, u and v are uniform random numbers for
+    // drawing the value and for the metropolis acceptance. Returns the
+    // change in the log likelihood of the chain when it is tracked.
+    probType update(int chain, rVarIndex var, probType u, probType v);
+    // resample a block jointly given the rest of chain, u holds a uniform
+    // random number per variable. Returns the change in the log likelihood.
+    probType updateBlock(int chain, int block, probType const* u);
+    // log likelihood of the cliques of a block
+    probType blockLogLikelihood(int chain, int block) const;
+    // grow the blocks and their terms, and color them
+    void buildBlocks();
+    // unnormalized full conditional of var in chain given the rest of its assignment
+    void conditional(rVarIndex var, intVec const& values, double temp, probType* dist) const;
+    // draw from the first card entries of dist, skipping the value skip
+    int sample(probType const* dist, int card, probType u, int skip = -1) const;
+    void syncChain(int chain);
+    void resetLogLikelihoods();
+    void addLogLikelihood(int chain, probType delta);
+    int numThreads() const;
+
+    lbModel const& _model;
+    int _numOfVars;
+    intVec _cards;
+
+    // flat table of every clique, and the terms of every variable
+    vector<probVector> _tables;
+    vector< vector<lbConditionalTerm> > _terms;
+    intVec _otherVars;
+    intVec _otherStrides;
+    // variables and strides of every clique, [_cliqBegin[c],_cliqBegin[c+1])
+    intVec _cliqBegin;
+    intVec _cliqVars;
+    intVec _cliqStrides;
+
+    // variables fixed by evidence, and the others
+    boolVec _observed;
+    intVec _freeVars;
+
+    // the state of the chains and a copy of it as assignments
+    vector<intVec> _values;
+    safeVec<lbAssignment_ptr> _chains;
+    vector<lbCounterGenerator> _generators;
+    vector<double> _temps;
+    vector<probType> _logLik;
+
+    bool _tempering;
+    int _swapInterval;
+    int _swapRound;
+    int _swapAttempts;
+    int _swapAccepts;
+    lbCounterGenerator _swapGenerator;
+
+    bool _metropolis;
+    lbGibbsScan _scan;
+    intVecVec _colors;
+
+    // the variables of every block in BFS order from its root, the block
+    // of every variable and the position of its parent in the block (-1
+    // for the root). The terms of a block are grouped by the position of
+    // their variable, [_blockTermBegin[b][i],_blockTermBegin[b][i+1])
+    int _maxBlockSize;
+    intVecVec _blocks;
+    intVec _blockOf;
+    intVec _parentPos;
+    vector< vector<lbBlockTerm> > _blockTerms;
+    intVecVec _blockTermBegin;
+    intVecVec _blockColors;
+
+    int _syncInterval;
+    double _convergeThresh;
+    measIndicesVec _checkedMeasures;
+    bool _converged;
+    int _numThreads;
+  };
+
+  inline int lbGibbsSampler::getValue(int chain, rVarIndex var) const {
+    return _values[chain][var];
+  }
+};
+
+#endif
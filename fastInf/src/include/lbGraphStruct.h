@@ -114,6 +114,18 @@ Mutators
     */
     bool setCliqueNeighbors (cliqIndex clique, cliquesVec& cliqueNeighbors);
 
+    /*!
+    Sets the neighbor list of a clique as it is, with the given separators
+    (neighbors are added in this direction only, used when the lists of all
+    the cliques are read, as from a binary model)
+    \param clique is the index of the clique
+    \param cliqueNeighbors is the list of indices of its neighbors
+    \param separators are the separators of the neighbors
+    \return true if succesful
+    */
+    bool setCliqueNeighborsList(cliqIndex clique, cliquesVec const& cliqueNeighbors,
+				separatorsVec const& separators);
+
     /*!
     Add one neighbor to a clique. Here, the seprator set is aloways set to be the intersection 
     of the variable lists of both cliques
@@ -242,6 +254,25 @@ Accessors
     */
     inline cliquesVec const & getAllCliquesForVar(rVarIndex var) const;
 
+    /*!
+    Get the variables that share a clique with each variable
+    \return a vector with the sorted list of neighbors of every variable
+    */
+    intVecVec getVarsNeighbors() const;
+
+    /*!
+    Greedy coloring of the variables (most neighbors first), no two
+    variables of the same color share a clique
+    \return a vector with the list of variables of every color
+    */
+    intVecVec colorVars() const;
+
+    /*!
+    Greedy coloring of any graph given by the neighbors of every node
+    \return a vector with the list of nodes of every color
+    */
+    static intVecVec colorGraph(intVecVec const& neighbors);
+
     /*!
     Get the variable list for this graph
     */
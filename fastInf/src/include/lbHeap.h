@@ -173,6 +173,27 @@ namespace lbLib {
       return true;
     }
   
+    /*Sets the value of Item itm to Value val, whether it moves it up or down
+      the Heap, and fixes the Heap accordingly. Takes O(log n) time.
+      Returns false if itm is not in the Heap.
+    */
+    bool changeValue(Item itm, Value val) {
+      typename map<Item,int>::const_iterator iter = _indexMap->find(itm);
+      if (iter == _indexMap->end()) {
+	return false;
+      }
+      int i = iter->second;
+      bool up = _valueCompare((*_heap)[i].second,val);
+      (*_heap)[i].second = val;
+      if (up) {
+	fixUpHeap(i);
+      }
+      else {
+	heapify(i);
+      }
+      return true;
+    }
+
     /*Inserts (item,val) into this Heap, maintaining the Heap property.
       The worst-case running time is O(log n), if the element is inserted or
       not (because it is a duplicate).    
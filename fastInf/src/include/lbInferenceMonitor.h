@@ -24,6 +24,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <lbDefinitions.h>
 #include <lbAssignedMeasure.h>
 #include <lbOptions.h>
+#include <lbGraphStruct.h>
 
 namespace lbLib {
   class lbBeliefPropagation;
@@ -77,14 +78,26 @@ namespace lbLib {
     void printExact(cliqIndex index);
     void setExact(lbAssignedMeasurePtrVec const & exact);
 
+    // Report of how the inference engine was chosen (printed by printInfo)
+    void setEngineReport(string const & report) { _engineReport = report; }
+
+    // Print the beliefs over the cliques of graph rather than over those
+    // of the inference model (when inference runs on a junction tree of
+    // the model, so the beliefs have the scopes of the model)
+    void setBeliefGraph(lbGraphStruct const * graph) { _beliefGraph = graph; }
+
   private:
     lbAssignedMeasurePtrVec _exactVec;
+    string _engineReport;
 
     probType averageKL();
     lbAssignedMeasure_ptr getBeliefMarginal(rVarIndex var);
+    // belief over vars, from a clique of the inference model holding them
+    lbAssignedMeasure_ptr getBeliefOf(varsVec const & vars);
     lbAssignedMeasure_ptr getExact(varsVec const & vars);
 
     lbBeliefPropagation const * _bp;
+    lbGraphStruct const * _beliefGraph;
 
     vector<double> _convergenceM;
     vector<double> _convergenceT;
@@ -72,6 +72,10 @@ namespace lbLib {
     }
     virtual probType evidenceLogProb()=0;
 
+    // a new engine with the same settings over the same model (to run
+    // on another thread), or NULL if this engine can not be duplicated
+    virtual lbInferenceObject* duplicate() const { return NULL; }
+
     // getting probabilty for a partial assignment
     virtual lbAssignedMeasure_ptr prob(varsVec const& vars) = 0;
 
@@ -53,6 +53,15 @@ namespace lbLib {
 
     static lbModel* CalcJunctionTreeGraphicalModel(const lbModel* model, JTmethod JTmeth = eBest);
 
+    /*Quick triangulation of the model (without building the JT model), returns log_10
+      of the total clique state space. If given, treewidth is set to (largest clique size - 1)
+      and numCliques to the number of maximal cliques.*/
+    static realVal EstimateJunctionTreeWeight(const lbModel* model, JTmethod JTmeth = eMinFill,
+					      int* treewidth = NULL, int* numCliques = NULL);
+
+    //log_10 of the largest total clique state space for which a JT model is built:
+    static realVal MaxLog10CliquesWeight();
+
   protected:
     static lbBasicGraph* CreatelbBasicGraphFromModel(const lbModel* model);
     static pair<realVal, lbBasicGraph::CliqueList*> CalcJunctionTreeCliques(const lbBasicGraph* g, JTmethod JTmeth);
@@ -0,0 +1,154 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ *  lbLBFGSOptimizer.h
+ */
+#ifndef __lbLBFGSOptimizer_h__
+#define __lbLBFGSOptimizer_h__
+
+#include <Optimizer.h>
+#include <vector>
+#include <assert.h>
+
+class ObjectiveFunction;
+
+namespace lbLib {
+
+  class lbLBFGSOptimizer;
+
+  /*!
+    Told about the state of an lbLBFGSOptimizer every few iterations,
+    e.g. to save it in a checkpoint.
+  */
+  class lbOptimizerCheckpointer {
+  public:
+    virtual ~lbOptimizerCheckpointer() {}
+    // returns false to stop the optimization
+    virtual bool checkpoint(lbLBFGSOptimizer const& opt) = 0;
+  };
+
+  /*!
+    Limited memory BFGS minimization of the objective.
+
+    The inverse hessian is approximated from the last getHistorySize()
+    steps and gradient changes (the two loop recursion), and every step
+    is taken by a line search satisfying the strong Wolfe conditions.
+    The point and gradient of the accepted trial of the line search are
+    those of the next iteration, so an iteration costs one call to
+    ObjectiveFunction::fdf when the first trial is accepted.
+
+    The optimizer works on the long double buffers of the objective and
+    allocates its O(history * parameters) memory once per Optimize(),
+    so it does not copy the parameters to GSL vectors and does not
+    allocate during the iterations. The initial step is the length of
+    the first step, later iterations start from the BFGS step.
+  */
+  class lbLBFGSOptimizer : public Optimizer {
+  public:
+    lbLBFGSOptimizer (ObjectiveFunction& obj, int historySize = 10);
+    virtual ~lbLBFGSOptimizer () {};
+
+    // stops when the norm of the gradient is below eps
+    virtual long double Optimize (long double const *p, long double *res,
+				  long double eps = 0.0001,
+				  long double step = 0.01,
+				  int MaxIter = 100);
+    virtual int iterationsTaken() {
+      return _iterationsTaken;
+    }
+
+    // number of (step, gradient change) pairs kept
+    void setHistorySize(int size) { assert(size > 0); _historySize = size; }
+    int getHistorySize() const { return _historySize; }
+
+    // calls to fdf in the last Optimize()
+    int evaluationsTaken() const { return _evaluations; }
+
+    // call cp->checkpoint() every interval iterations (NULL - never)
+    void setCheckpointer(lbOptimizerCheckpointer* cp, int interval) {
+      assert(interval > 0);
+      _checkpointer = cp;
+      _checkpointInterval = interval;
+    }
+    // true if the last Optimize() was stopped by the checkpointer
+    bool stopped() const { return _stopped; }
+
+    // the point, gradient and history of the current iteration, and
+    // continuing from them: the next Optimize() ignores its p and goes on
+    // with the same iterations as the optimizer that saved the state
+    void getState(std::vector<int>& counters, std::vector<long double>& state) const;
+    void setState(std::vector<int> const& counters, std::vector<long double> const& state);
+
+  private:
+    // direction = - H * grad by the two loop recursion over the history
+    void searchDirection();
+    // line search along _dir from _x (value f, slope along _dir dphi).
+    // On success the accepted point and its gradient are in _xTrial and
+    // _gTrial, and its value in fTrial.
+    bool lineSearch(long double f, long double dphi, long double alpha,
+		    long double& fTrial);
+    // shrink the interval [aLo,aHi] (aLo being the better end) until a
+    // point satisfies the strong Wolfe conditions, using at most evals
+    // evaluations
+    bool zoom(long double aLo, long double fLo, long double dLo,
+	      long double aHi, long double fHi, long double dHi,
+	      long double f, long double dphi, int evals, long double& fTrial);
+    // evaluate the objective at _x + alpha * _dir into _xTrial and
+    // _gTrial, returns the value and puts the slope in dphi
+    long double evaluate(long double alpha, long double& dphi);
+    // minimizer of the cubic through two points and slopes, safeguarded
+    // to the inside of the interval
+    static long double interpolate(long double a1, long double f1, long double d1,
+				   long double a2, long double f2, long double d2);
+
+    // set up the buffers for _N parameters
+    void allocate();
+
+    int _historySize;
+    int _iterationsTaken;
+    int _evaluations;
+    int _N;
+    long double _f;
+
+    lbOptimizerCheckpointer* _checkpointer;
+    int _checkpointInterval;
+    bool _stopped;
+    // setState() was called, the next Optimize() continues
+    bool _resume;
+
+    std::vector<long double> _x;
+    std::vector<long double> _g;
+    std::vector<long double> _dir;
+    std::vector<long double> _xTrial;
+    std::vector<long double> _gTrial;
+
+    // ring of the last steps s and gradient changes y (_historySize rows
+    // of _N), 1 / (y * s), and the coefficients of the first loop
+    std::vector<long double> _s;
+    std::vector<long double> _y;
+    std::vector<long double> _rho;
+    std::vector<long double> _alpha;
+    int _historyBegin;
+    int _historyUsed;
+  };
+
+};
+#endif
@@ -0,0 +1,69 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Learning__Checkpoint_
+#define _Learning__Checkpoint_
+
+#include <lbDefinitions.h>
+
+namespace lbLib {
+
+  /*!
+    The state of lbGSLLearningObject::learnEM() kept in a checkpoint
+    file, from which a stopped run continues with the same results.
+
+    It holds the log parameters of all the measures, the EM iteration
+    and its log likelihood, and (for a checkpoint inside the M step) the
+    state of the optimizer and the empirical counts of the E step. The
+    file is binary and is written to a temporary file which then
+    replaces the old checkpoint, so a run killed while writing leaves
+    the previous checkpoint. The numbers are kept as they are in
+    memory, so a checkpoint is read on the machine (and with the build)
+    that wrote it.
+
+    Part of the fastInf library
+  */
+  class lbLearningCheckpoint {
+  public:
+    lbLearningCheckpoint();
+
+    // returns false if the file could not be written or read
+    bool write(string const& fileName) const;
+    bool read(string const& fileName);
+
+    // the optimization method (tGSLOptimizer::tProcType)
+    int method;
+    // EM iterations done, and the log likelihood after the last one
+    int emIter;
+    probType like;
+    // log parameters of all the measures (lbModel::getLogParamVector)
+    probVector params;
+
+    // a checkpoint inside the M step of the next EM iteration has the
+    // state of the optimizer and the empirical counts of its E step
+    bool inOptimizer;
+    intVec optCounters;
+    probVector optState;
+    probVector counts;
+  };
+
+};
+
+#endif
@@ -0,0 +1,107 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Learning__Sweep_
+#define _Learning__Sweep_
+
+#include <lbGSLLearningObject.h>
+#include <lbMeasureDispatcher.h>
+
+namespace lbLib {
+
+  /*!
+    Learning of one model and evidence with a grid of settings: the
+    optimization methods, the smoothings of inference and the
+    regularizations. The grid is their product (no regularization if
+    none is added).
+
+    The model is read and the evidence file parsed once. Every setting
+    learns a copy of the model with lbGSLLearningObject::learnEM() from
+    a copy of the evidence, and the settings run concurrently, one per
+    thread, each with its inference on a single thread.
+
+    Part of the fastInf library
+  */
+  class lbLearningSweep {
+  public:
+    lbLearningSweep(lbModel& model,
+		    lbMeasureDispatcher const& disp,
+		    string evidenceFileName,
+		    set<measIndex> const* measSet = NULL);
+
+    void setMethods(vector<tGSLOptimizer::tProcType> const& methods) { _methods = methods; }
+    void setSmoothings(vector<double> const& smoothings) { _smoothings = smoothings; }
+    void addRegularization(RegularizationType type, double param);
+    // the other settings of inference
+    void setInference(double thresh, lbMessageCompareType cType, lbMessageQueueType qType);
+    // passed to every lbGSLLearningObject
+    void setWarmStart(bool warm) { _warmStart = warm; }
+    void setLBFGSHistory(int size) { assert(size > 0); _lbfgsHistory = size; }
+    // settings learned at once (0 - OpenMP default)
+    void setNumThreads(int threads) { _numThreads = threads; }
+
+    int getNumOfSettings() const;
+
+    // learn every setting with the given arguments of learnEM(). If
+    // outputPrefix is not empty the net of a setting is printed to the
+    // prefix followed by its settings, e.g. grid_LBFGS_pS0.5_r10.1.net
+    void run(probType eps, probType step, int maxIter, int maxEMIter,
+	     string const& outputPrefix = string(""));
+
+    // a row for every setting with its final log likelihood
+    void printSummary(ostream& out) const;
+
+  private:
+    struct lbSweepSetting {
+      tGSLOptimizer::tProcType method;
+      double smooth;
+      RegularizationType regType;
+      double regParam;
+      string output;
+      probType like;
+      double seconds;
+    };
+
+    void buildSettings(string const& outputPrefix);
+    void runSetting(lbSuffStat const& evidence, lbSweepSetting& setting,
+		    probType eps, probType step, int maxIter, int maxEMIter) const;
+
+    lbModel& _model;
+    lbMeasureDispatcher const& _disp;
+    string _evidenceFileName;
+    set<measIndex> _measSet;
+
+    vector<tGSLOptimizer::tProcType> _methods;
+    vector<double> _smoothings;
+    vector<RegularizationType> _regTypes;
+    vector<double> _regParams;
+    double _thresh;
+    lbMessageCompareType _compareType;
+    lbMessageQueueType _queueType;
+    bool _warmStart;
+    int _lbfgsHistory;
+    int _numThreads;
+
+    vector<lbSweepSetting> _settings;
+  };
+
+};
+
+#endif
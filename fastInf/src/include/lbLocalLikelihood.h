@@ -0,0 +1,167 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Local__Likelihood_
+#define _Local__Likelihood_
+
+#include <ObjectiveFunction.h>
+#include <lbSuffStat.h>
+#include <lbModel.h>
+
+namespace lbLib {
+
+  // the objectives lbGSLLearningObject can learn with
+  enum lbObjectiveType { OBJ_LIKELIHOOD, OBJ_PSEUDO, OBJ_PIECEWISE };
+
+  /*!
+    Base of the learning objectives that replace the partition function
+    of the model by local normalizations, so evaluating them needs no
+    inference.
+
+    The objective is computed from the fully observed rows of the
+    sufficient statistics, which it takes packed as they are (partially
+    observed rows are ignored), so the evidence of the statistics should
+    not change while the objective is used. The log potentials of the cliques are
+    read into flat tables at every evaluation, the subclass turns them
+    into the local log likelihood and the counts it expects for every
+    clique, and the gradient of a measure is then formed by its
+    calcDeriv() from these counts and the observed ones, as in
+    GSLFuncWrapper. It has the parameters and the sign (minimized) of
+    GSLFuncWrapper, so the optimizers and regularizers work unchanged.
+
+    Part of the fastInf library
+  */
+  class lbLocalLikelihood : public ObjectiveFunction {
+  public:
+    lbLocalLikelihood(lbSuffStat const& suff,
+		      lbModel& model,
+		      set<measIndex> const& measSet);
+    virtual ~lbLocalLikelihood() {}
+
+    virtual double f(long double const* p);
+    virtual void df(long double const* p, long double* res);
+    virtual long double fdf(long double const* p, long double* res);
+    virtual int paramNum() const { return _paramNum; }
+
+    // threads for the variables or cliques (0 - OpenMP default)
+    void setNumThreads(int threads) { _numThreads = threads; }
+
+  protected:
+    // local log likelihood of the rows at the current tables, and the
+    // counts of every clique it expects (if counts is not NULL)
+    virtual probType localLikelihood(vector<probVector>* counts) = 0;
+
+    // the observed counts the gradient compares to are the counts of
+    // the rows times the number of variables of the clique (perVariable)
+    // or the counts themselves
+    void initEmpirical(bool perVariable);
+
+    int numThreads() const;
+
+    lbModel& _model;
+    set<measIndex> _measSet;
+    int _paramNum;
+    int _numOfVars;
+    int _numThreads;
+
+    // the fully observed rows and their weights
+    lbEvidenceMatrix const& _rows;
+    int _numOfRows;
+    probType _totalWeight;
+
+    // variables, strides (the last variable changes fastest), log
+    // potentials and observed counts of every clique
+    vector<varsVec> _cliqVars;
+    vector<intVec> _cliqStrides;
+    vector<probVector> _logTables;
+    vector<probVector> _counts;
+
+  private:
+    // set the model to p and read its log potentials
+    void setParams(long double const* p);
+    // the gradient from the expected counts, returns the number of parameters
+    int derivFromCounts(long double* res);
+    // add flat clique counts to the tables of their measures
+    void addToMeasures(vector<probVector> const& counts, measurePtrVec& tables) const;
+
+    vector<probVector> _expected;
+    measurePtrVec _measExpected;
+    measurePtrVec _measEmpirical;
+  };
+
+  /*!
+    Pseudo likelihood: the sum over the rows and the variables of the
+    log probability of the variable given the rest of its row (its
+    Markov blanket). The rows are taken in blocks; in a block the
+    conditionals are computed in parallel over the variables, and the
+    expected counts from them in parallel over the cliques, so the
+    result does not depend on the number of threads.
+  */
+  class lbPseudoLikelihood : public lbLocalLikelihood {
+  public:
+    lbPseudoLikelihood(lbSuffStat const& suff,
+		       lbModel& model,
+		       set<measIndex> const& measSet);
+
+  protected:
+    virtual probType localLikelihood(vector<probVector>* counts);
+
+  private:
+    // a clique of a variable and the position of the variable in it
+    struct lbVarTerm {
+      int cliq;
+      int pos;
+    };
+
+    // normalized conditional of var in row into cond, returns its log
+    // probability of the value in the row
+    probType conditional(int var, int const* row, probType* cond) const;
+
+    vector< vector<lbVarTerm> > _terms;
+    // first entry of every variable in a row of the conditionals
+    intVec _condOffset;
+    probVector _conds;
+    // the values of the rows of the block (_numOfVars each)
+    intVec _block;
+    probVector _varLikelihood;
+  };
+
+  /*!
+    Piecewise likelihood: every clique is normalized on its own, so the
+    log likelihood of a row is the sum over the cliques of its log
+    potential less the log of the sum of the table. The cliques are
+    computed in parallel.
+  */
+  class lbPiecewiseLikelihood : public lbLocalLikelihood {
+  public:
+    lbPiecewiseLikelihood(lbSuffStat const& suff,
+			  lbModel& model,
+			  set<measIndex> const& measSet);
+
+  protected:
+    virtual probType localLikelihood(vector<probVector>* counts);
+
+  private:
+    probVector _cliqLikelihood;
+  };
+
+};
+
+#endif
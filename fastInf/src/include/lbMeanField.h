@@ -35,7 +35,11 @@ namespace lbLib {
     
   public:
 
-    enum lbMFIterMethod { IM_NORMAL, IM_RESIDUAL, IM_MB_RESIDUAL, IM_LARGE_EFFECT };
+    // IM_COLORED is Gauss-Seidel where the variables of one color (no
+    // two of them share a clique) are updated concurrently. IM_JACOBI
+    // updates all variables concurrently from the previous sweep and
+    // damps the result.
+    enum lbMFIterMethod { IM_NORMAL, IM_RESIDUAL, IM_MB_RESIDUAL, IM_LARGE_EFFECT, IM_COLORED, IM_JACOBI };
 
     //contsructor :
     lbMeanField(lbModel & model,lbMeasureDispatcher const& disp); 
@@ -87,6 +91,12 @@ namespace lbLib {
     virtual void cliqueRemoved(cliqIndex clique) { assert(false); };    
 
     void SetIterationMethod(lbMFIterMethod IM) { _MFMethod = IM; };
+
+    // weight of the previous marginal in a Jacobi update (0 - no damping)
+    void SetDamping(double damping) { assert(damping >= 0 && damping < 1); _damping = damping; };
+
+    // threads for the colored and Jacobi updates (0 - OpenMP default)
+    void SetNumThreads(int threads) { _numThreads = threads; };
     
   protected:
 
@@ -100,6 +110,16 @@ namespace lbLib {
     int iterateMBResiduals();
     //
     int iterateLargestEffect();
+    //
+    int iterateColored();
+    //
+    int iterateJacobi();
+
+    // variables that share a clique with each variable
+    intVecVec computeAffected() const;
+    // max difference between a new marginal and the current one
+    double residual(int index, lbMeasure_Sptr meas) const;
+    int numThreads() const;
 
   private:
 
@@ -107,6 +127,8 @@ namespace lbLib {
     measurePtrVec _measures; // marginal factors of the q distribution
     assignedMesVec _factors; // assigned measure that wrap the measures
     lbMFIterMethod _MFMethod;
+    double _damping;
+    int _numThreads;
 
   };
   
@@ -86,6 +86,8 @@ namespace lbLib {
   typedef map<string,lbParam*>::iterator paramPtrMapIter;
   
   class lbMeasure; 
+  class lbBinaryModelReader;
+  class lbBinaryModelWriter;
   typedef shared_ptr<lbMeasure> lbMeasure_Sptr;
   typedef safeVec<lbMeasure_Sptr> measurePtrVec ;
   typedef measurePtrVec::iterator measurePtrVecIter;
@@ -503,6 +505,20 @@ namespace lbLib {
     virtual void printToFastInfFormat(ostream& out,bool normalizeValues = false,int prec = 5,
 				      bool printLogValues = false) const=0;
 
+    /*!
+      Reads a measure written by writeBinary() from a binary model
+      \sa lbBinaryModelReader
+      \param in is the reader of the mapped model file
+     */
+    virtual void readOneMeasureBinary(lbBinaryModelReader& in);
+
+    /*!
+      Writes a measure to a binary model, the log values go to the
+      table of the model
+      \sa lbBinaryModelWriter
+     */
+    virtual void writeBinary(lbBinaryModelWriter& out) const;
+
     /*!
       Check whether this and other measure are differnt
       \param other is the measure we are comparing to
@@ -549,6 +565,20 @@ namespace lbLib {
 			  lbMeasure const& Estimated,
 			  lbMeasure const& Empirical) const = 0;
 
+    /*!
+      Calculate the diagonal of the Hessian of the likelihood, which is
+      E[f] - E[f]^2/N for the estimated counts E[f] of N rows, mapped
+      to the parameters like calcDeriv
+      \param diag gets the diagonal, one entry for every parameter
+      \param counts gets the estimated counts mapped to the parameters
+      (unless it is NULL)
+      \param Estimated contains the estimated counts
+      \param numOfEvidence the number of rows N
+     */
+    virtual void calcHessianDiag(probType* diag,probType* counts,
+				 lbMeasure const& Estimated,
+				 probType numOfEvidence) const;
+
 
     /*!
       Add values of this measure to a vector
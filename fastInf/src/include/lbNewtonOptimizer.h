@@ -25,6 +25,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #define __lbNewtonOptimizer_h__
 
 #include <Optimizer.h>
+#include <vector>
 
 class ObjectiveFunction;
 
@@ -67,6 +68,42 @@ namespace lbLib {
     int _iterationsTaken;
   };
 
+
+  /*!
+    Newton steps with the block diagonal hessian of the objective
+    (ObjectiveFunction::ddfBlocks, one block per measure for learning).
+    Every block is solved on its own by a Cholesky decomposition, the
+    blocks in parallel, so memory and time grow with the sum of the
+    squared block sizes rather than with the square of the number of
+    parameters. A small ridge keeps singular blocks (the parameters of
+    a table are only defined up to a constant) solvable, and a block
+    that is still not positive definite takes a diagonal step.
+  */
+  class lbNewtonBlockOptimizer : public Optimizer {
+  public:
+    lbNewtonBlockOptimizer (ObjectiveFunction& obj);
+    virtual ~lbNewtonBlockOptimizer () {};
+
+    virtual long double Optimize (long double const *p, long double *res,
+				  long double eps = 0.0001,
+				  long double step = 0.01,
+				  int MaxIter = 100);
+    virtual int iterationsTaken() {
+      return _iterationsTaken;
+    }
+
+    // threads for solving the blocks (0 - OpenMP default)
+    void setNumThreads(int threads) { _numThreads = threads; }
+
+  protected:
+    // overwrite rhs with the solution of block * x = rhs (block is
+    // overwritten by its decomposition)
+    static void solveBlock(long double* block, int size, long double* rhs);
+
+    int _iterationsTaken;
+    int _numThreads;
+  };
+
 };
 
 #endif
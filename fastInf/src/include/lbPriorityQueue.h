@@ -54,8 +54,8 @@ namespace lbLib {
 	throw new string("Empty lbPriorityQueue from deleteMax()");
 
       Item max = (*HeapParent::_heap)[HeapParent::_ROOT].first;
-      exchange(HeapParent::_ROOT,--HeapParent::_size);
-      heapify(HeapParent::_ROOT);    
+      this->exchange(HeapParent::_ROOT,--HeapParent::_size);
+      this->heapify(HeapParent::_ROOT);    
       HeapParent::_indexMap->erase(max);   
       return max;
     }
@@ -43,6 +43,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <fstream>
 #include <assert.h>
 #include <cmath>
+#include <stdint.h>
 
 #ifdef USE_GSL_RAND
 #include <gsl/gsl_rng.h>
@@ -97,7 +98,13 @@ class lbRandomGenerator : public lbMarsagliaGenerator {
 public:
   lbRandomGenerator(unsigned long int seed = 0)
   { Initialize(seed); };
+
+  void Initialize (unsigned long int seed = 0)
+  { _seed_ = seed; lbMarsagliaGenerator::Initialize(seed); }
 #endif
+
+  /// the seed given to Initialize
+  unsigned long int getSeed() const { return _seed_; }
       
   long double RandomProb();
   ///
@@ -147,12 +154,102 @@ private:
   #ifdef USE_GSL_RAND
   gsl_rng * _rng_ ;
   #endif
+  unsigned long int _seed_ ;
 }///
 ;
 
+/*!
+  Counter based generator (Philox4x32-10, Salmon et al., SC 2011).
+
+  The n-th block of four 32 bit numbers of a stream is a bijective
+  scrambling of the counter (n, stream) keyed by the seed, so it does
+  not depend on the numbers drawn before it. Any number of independent
+  streams can be split from one seed by their id, which lets every
+  chain, engine or thread own a stream and makes runs with a given seed
+  reproducible whatever the number of threads. Generating the numbers
+  of a block costs ten rounds of two multiplications, and Fill() writes
+  whole blocks of uniforms at once.
+*/
+class lbCounterGenerator {
+public:
+  ///
+  lbCounterGenerator(unsigned long int seed = 0, unsigned long int stream = 0)
+  { Initialize(seed, stream); }
+
+  /// start stream of seed from its first number
+  void Initialize(unsigned long int seed, unsigned long int stream = 0);
+
+  /// another stream of the same seed
+  lbCounterGenerator split(unsigned long int stream) const
+  { return lbCounterGenerator(_seed, stream); }
+
+  /// jump to the given block of four numbers of the stream
+  void seek(uint64_t block);
+
+  /// uniform 32 bit number
+  inline uint32_t RandomLong();
+  /// uniform in [0,range), range is at most 2^32
+  unsigned long int RandomInt(unsigned long int range);
+  /// uniform in [0,range) with 53 random bits
+  inline long double RandomDouble(long double range);
+  long double RandomProb() { return RandomDouble(1.0); }
+
+  /// n uniforms in [0,1)
+  void Fill(double* out, int n);
+  void Fill(long double* out, int n);
+  void Fill(vector<double>& out) { if (!out.empty()) Fill(&out[0], out.size()); }
+  void Fill(vector<long double>& out) { if (!out.empty()) Fill(&out[0], out.size()); }
+
+  /// the block of four numbers for counter and key
+  static void philox(uint32_t const counter[4], uint32_t const key[2], uint32_t out[4]);
+
+private:
+  inline void nextBlock();
+  inline static double toDouble(uint32_t high, uint32_t low);
+
+  uint64_t _seed;
+  uint32_t _key[2];
+  uint32_t _counter[4];
+  uint32_t _block[4];
+  int _used;
+};
+
+inline void lbCounterGenerator::nextBlock() {
+  philox(_counter, _key, _block);
+  if (++_counter[0] == 0) {
+    ++_counter[1];
+  }
+  _used = 0;
+}
+
+inline uint32_t lbCounterGenerator::RandomLong() {
+  if (_used == 4) {
+    nextBlock();
+  }
+  return _block[_used++];
+}
+
+inline double lbCounterGenerator::toDouble(uint32_t high, uint32_t low) {
+  // 27 + 26 bits, as many as a double holds
+  return ((high >> 5) * 67108864.0 + (low >> 6)) * (1.0 / 9007199254740992.0);
+}
+
+inline long double lbCounterGenerator::RandomDouble(long double range) {
+  uint32_t high = RandomLong();
+  uint32_t low = RandomLong();
+  return toDouble(high, low) * range;
+}
+
 ///
 extern lbRandomGenerator _lbRandomProbGenerator;
 
+/// stream of the counter based generator for the seed of _lbRandomProbGenerator
+inline
+lbCounterGenerator lbRandomStream(unsigned long int stream)
+{
+  return lbCounterGenerator(_lbRandomProbGenerator.getSeed(), stream);
+}
+
 ///
 inline
 long double lbRandomProb(void)
@@ -39,6 +39,9 @@ namespace lbLib {
 
     virtual ~lbRegionBP();
 
+    // The region graph is not kept, so there is nothing to build a duplicate from
+    virtual lbInferenceObject* duplicate() const { return NULL; }
+
     virtual void calculatePartition(lbAssignedMeasure_ptr* exactBeliefs = NULL);
 
     virtual lbAssignedMeasure_ptr computeMessage(messageIndex forwardIndex) const;
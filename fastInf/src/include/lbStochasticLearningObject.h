@@ -0,0 +1,113 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _Stochastic__Learning__Object_
+#define _Stochastic__Learning__Object_
+
+#include <lbGSLLearningObject.h>
+#include <lbMeasureDispatcher.h>
+
+namespace lbLib {
+
+  class lbBeliefPropagation;
+
+  /*!
+    Stochastic gradient learning of the undirected measures over
+    mini-batches of evidence streamed from the evidence file.
+
+    Every step reads the next getBatchSize() rows of the file into the
+    sufficient statistics, so only one batch is held in memory, and
+    moves the parameters by the gradient of the objective of the batch
+    (the log likelihood of the batch less its share of the penalty of
+    the regularizer), divided by the weight of the batch. An epoch is a
+    pass over the file, which is read in order.
+
+    The step is that of plain SGD (with the rate decaying as
+    rate/(1+decay*step)), of Adagrad or of Adam. The regularizer is set
+    as for lbGSLLearningObject, with the penalty of the whole evidence
+    (its total weight is counted once when the object is built).
+
+    Part of the fastInf library
+  */
+  class lbStochasticLearningObject {
+  public:
+    typedef enum { SU_SGD, SU_ADAGRAD, SU_ADAM } lbStochasticUpdate;
+
+    lbStochasticLearningObject(string evidenceFileName,
+			       lbModel& model,
+			       lbMeasureDispatcher const& disp,
+			       double thresh = 1e-5,
+			       lbMessageCompareType cType = C_MAX,
+			       double smooth = 0.5,
+			       lbMessageQueueType qType = MQT_WEIGHTED,
+			       set<measIndex> const* measSet = NULL);
+
+    virtual ~lbStochasticLearningObject();
+
+    // make epochs passes over the evidence, returns the average log
+    // likelihood of a row in the last one
+    probType learn(int epochs = 10);
+
+    void setUpdate(lbStochasticUpdate update) { _update = update; }
+    lbStochasticUpdate getUpdate() const { return _update; }
+    // rows of evidence in a step
+    void setBatchSize(int size) { assert(size > 0); _batchSize = size; }
+    int getBatchSize() const { return _batchSize; }
+    void setLearningRate(double rate) { _rate = rate; }
+    // decay of the rate of SGD
+    void setDecay(double decay) { _decay = decay; }
+
+    void setRegularizeParamL1(double beta) { _objFunc->setRegularizeParamL1(beta); }
+    void setRegularizeParamL2(double sigmaSq) { _objFunc->setRegularizeParamL2(sigmaSq); }
+
+    // threads for the rows of a batch (0 - OpenMP default)
+    void setNumThreads(int threads) { _suffStat->setNumThreads(threads); }
+    // start the inference of a step from the messages of the previous one (on by default)
+    void setWarmStart(bool warm) { _suffStat->setWarmStart(warm); }
+
+    probType getTotalWeight() const { return _totalWeight; }
+
+  private:
+    // move p by the gradient of a batch of the given weight
+    void update(probType* p, int size, int step, probType batchWeight);
+
+    string _evidenceFileName;
+    lbModel& _model;
+    set<measIndex> _measSet;
+
+    lbBeliefPropagation* _infObj;
+    lbSuffStat* _suffStat;
+    GSLFuncWrapper* _objFunc;
+    probType _totalWeight;
+
+    lbStochasticUpdate _update;
+    int _batchSize;
+    double _rate;
+    double _decay;
+
+    // the gradient, and the first and second moments of the updates
+    vector<long double> _grad;
+    vector<long double> _first;
+    vector<long double> _second;
+  };
+
+};
+
+#endif
@@ -25,9 +25,26 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <lbAssignedMeasure.h>
 #include <lbModelListener.h>
 #include <lbTableMeasure.h>
+#include <lbEvidenceMatrix.h>
 
 namespace lbLib {
 
+  /*!
+    Sufficient statistics of a model over a set of evidence rows.
+
+    Identical rows of the evidence file are kept once with their
+    multiplicity as a weight, so inference runs once per distinct row
+    and the counts and likelihood of a row are scaled by its weight. A
+    row of the file can carry its own weight after the assignment, e.g.
+    "( 1 0 ? 2 ) 3.5", and weights of identical rows add up.
+
+    Rows that observe every variable are not given to inference at all.
+    They are packed into a matrix of values and their clique counts are
+    tallied from it once, in one pass per clique. Their likelihood is the
+    sum of their log potentials less the log partition function, so
+    only the partially observed rows (and the model expectations) need
+    inference.
+  */
   class lbSuffStat : public lbModelListener {
   public:
     
@@ -35,17 +52,28 @@ namespace lbLib {
 
     lbSuffStat(lbInferenceObject& infObj,set<measIndex> const& measSet);
 
+    // the evidence of other (which is read once) for a copy of its model
+    lbSuffStat(lbInferenceObject& infObj,lbSuffStat const& other,set<measIndex> const& measSet);
+
     virtual ~lbSuffStat();      
 
     inline const lbInferenceObject & getInfObj() const ; 
     
     void setEvidence (string evidenceFileName);
+    // replace the evidence by the next maxRows rows of in (all of them
+    // if maxRows is 0), for learning over a stream of mini-batches.
+    // Returns the number of rows read.
+    int setEvidence (istream& in,int maxRows = 0);
     
     inline virtual lbTableMeasure<lbValue> const& getEmpiricalExpectation(measIndex meas,bool recalc = true) const;
 
     inline virtual lbTableMeasure<lbValue> const& getEstimatedExpectation(measIndex meas,bool recalc = true) const;
     virtual lbMeasure_Sptr getEstimatedSquaredExpectation(measIndex meas) const;
     virtual lbMeasure_Sptr getEstimatedExpectationSquared(measIndex meas) const;
+    // compute the counts of all the measures (the estimated ones, and
+    // the empirical ones if asked) so that they can then be read
+    // concurrently with recalc false
+    inline void calcCounts(bool empirical = true) const;
 
     inline virtual bool factorsUpdated(measIndicesVec const& vec);
 
@@ -74,7 +102,13 @@ namespace lbLib {
 
     inline void activateEMMode();
 
-    inline virtual int getNumOfEvidence() const;
+    // total weight of the evidence (the number of rows of an unweighted file)
+    inline virtual probType getNumOfEvidence() const;
+    // number of distinct rows, and of those that are fully observed
+    inline int getNumOfDistinctEvidence() const;
+    inline int getNumOfFullEvidence() const;
+    // the distinct fully observed rows and their weights
+    lbEvidenceMatrix const& getFullRows() const { return _fullRows; }
     
     inline void setEMMode(bool set);
     inline bool getEMMode() const;
@@ -89,6 +123,40 @@ namespace lbLib {
 
     inline virtual void resetCounts(bool resetEmpirical = true);
 
+    /*!
+      threads for going over the evidence (0 - OpenMP default). Every
+      thread runs a duplicate of the inference object on a contiguous
+      share of the rows, and the counts of the threads are summed in
+      order, so a given number of threads always gives the same result.
+      If the inference object can not be duplicated it runs alone.
+     */
+    void setNumThreads(int threads) { _numThreads = threads; }
+    int getNumThreads() const { return _numThreads; }
+
+    /*!
+      when the model parameters change keep the messages of the
+      inference objects, so the next run starts from the last fixed
+      point instead of from scratch (off by default)
+     */
+    void setWarmStart(bool warm) { _warmStart = warm; }
+    bool getWarmStart() const { return _warmStart; }
+
+    // the empirical counts of all the measures in one vector, and setting
+    // them back as computed (for the checkpoints of learning)
+    void getEmpiricalCounts(probVector& counts) const;
+    void setEmpiricalCounts(probVector const& counts);
+
+    // reset the counts and drop the messages of the inference objects,
+    // so the next run starts from scratch even with warm starts
+    void restartInference(bool resetEmpirical = true);
+
+    // propagations and messages of the inference object and of its
+    // duplicates for the threads, since the last resetRunStatistics()
+    // (0 for inference objects that are not belief propagation)
+    int getNumOfRuns() const;
+    long getTotalMessageCount() const;
+    void resetRunStatistics();
+
   protected:
     virtual void calcEstimatedCounts() const;
 
@@ -102,14 +170,32 @@ namespace lbLib {
 
     virtual void resetEmpiricalSuffStat() const;
 
+    // add the clique beliefs given rows [begin,end) of the evidence to
+    // counts (if not NULL) and return the log probability of these rows
+    probType addEvidenceCounts(lbInferenceObject& infObj,int begin,int end,
+                               measurePtrVec* counts) const;
+
+    // number of threads to use now, duplicating the inference object as needed
+    int numWorkers() const;
+    lbInferenceObject& getWorker(int thread) const;
+
   protected:
 
     lbInferenceObject& _infObj;
+    // the partially observed rows, and the fully observed ones (packed
+    // like the evidence file) with their clique counts
     fullAssignmentPtrVec _evidence;
+    probVector _weights;
+    lbEvidenceMatrix _fullRows;
+    vector<probVector> _fullCounts;
+    probType _totalWeight;
+    probType _fullWeight;
 
     set<measIndex> _measSet;
     
     mutable probType _lLikelihood;
+    // log likelihood of the partially observed rows
+    mutable probType _inferredLikelihood;
     mutable probType _explLikelihood;
     mutable probType* _empirCountsVec;
     mutable measurePtrVec _empirCounts;
@@ -118,18 +204,39 @@ namespace lbLib {
     mutable bool _empiricalComputed;
     mutable bool _estimatedComputed;
     mutable bool _llComputed;
+    mutable bool _inferredComputed;
     mutable bool _expllComputed;
     mutable bool _countsInitialized;
 
     bool _EMMode;
+
+    int _numThreads;
+    bool _warmStart;
+    // duplicates of _infObj for the threads after the first
+    mutable safeVec<lbInferenceObject*> _workers;
     
   private:
 
     void Init();
 
     void readEvidenceFromFile(string evidenceFileName);
+    int readEvidence(istream& in,string const& name,int maxRows);
+    // keep the distinct rows of matrix as the evidence, returns the number of rows
+    int setEvidenceRows(lbEvidenceMatrix const& matrix,string const& name);
     
     void initCounts();
+    // gather the empirical counts into _empirCountsVec
+    void fillEmpiricalCountsVec() const;
+
+    measurePtrVec makeCounts() const;
+
+    // strides of the flat count table of a clique, returns its size
+    int cliqueStrides(cliqIndex cliq,intVec& strides) const;
+    // tally the clique counts of the fully observed rows
+    void countFullEvidence();
+    // add them to the empirical counts, and their log likelihood
+    void addFullCounts() const;
+    probType fullLogLikelihood() const;
 
   private:
 
@@ -148,6 +255,12 @@ namespace lbLib {
     return (lbTableMeasure<lbValue> const&) *(_estimatedCounts[getMeasVecIndex(meas)]);
   }
 
+  inline void lbSuffStat::calcCounts(bool empirical) const {
+    calcEstimatedCounts();
+    if ( empirical )
+      calcEmpiricalCounts();
+  }
+
   inline bool lbSuffStat::factorsUpdated(measIndicesVec const& vec) {
     resetCounts(!_EMMode);
     return true;
@@ -158,9 +271,13 @@ namespace lbLib {
       _empiricalComputed = false;
     }
     _llComputed = false;
+    _inferredComputed = false;
     _expllComputed = false;
     _estimatedComputed = false;
-    _infObj.reset();
+    _infObj.reset(!_warmStart);
+    for (uint i = 0; i < _workers.size(); i++) {
+      _workers[i]->reset(!_warmStart);
+    }
   }
 
   inline void lbSuffStat::setMeasureOfInterest(set<measIndex> const& measSet) {
@@ -175,8 +292,16 @@ namespace lbLib {
     return _infObj;
   }
 
-  inline int lbSuffStat::getNumOfEvidence() const{
-    return _evidence.size();
+  inline probType lbSuffStat::getNumOfEvidence() const{
+    return _totalWeight;
+  }
+
+  inline int lbSuffStat::getNumOfDistinctEvidence() const{
+    return _evidence.size() + _fullRows.getNumOfRows();
+  }
+
+  inline int lbSuffStat::getNumOfFullEvidence() const{
+    return _fullRows.getNumOfRows();
   }
   
   inline void lbSuffStat::setEMMode(bool set) {
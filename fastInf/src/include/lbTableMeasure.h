@@ -27,6 +27,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 //#include <typeinfo>
 
 #include <lbOptions.h>
+#include <lbBinaryModel.h>
 
 namespace lbLib {
 
@@ -137,6 +138,25 @@ namespace lbLib {
     inline virtual void takeExp() ;
 
     inline virtual bool addMeasure(lbMeasure const& otherMeasure);      
+
+    // add weight times the values of other (in one pass, without
+    // converting other to this VALUE type first)
+    template <class OTHER_VALUE>
+    inline void addWeightedMeasure(lbTableMeasure<OTHER_VALUE> const& other, probType weight) {
+      assert(other.getSize() == getSize());
+      typename lbTableMeasure<OTHER_VALUE>::valueVecVec const& otherValues = *other.getValues();
+      probType total = 0;
+      for (uint i = 0; i < _primarySize; i++) {
+	for (uint j = 0; j < _secondarySize; j++) {
+	  VALUE& value = getValue(i,j);
+	  value.setValue(value.getValue() + weight * otherValues[i][j].getValue());
+	  total += value.getValue();
+	}
+      }
+      _totalWeight.setValue(total);
+      _totalWeightIsUpdated = true;
+      dirtySparsity();
+    }
     
     inline virtual void subtractMeasure(lbMeasure const& other);
 
@@ -168,8 +188,15 @@ namespace lbLib {
 			  lbMeasure const& Estimated,
 			  lbMeasure const& Empirical) const;
 
+    virtual void calcHessianDiag(probType* diag,probType* counts,
+				 lbMeasure const& Estimated,
+				 probType numOfEvidence) const;
+
     inline int extractValuesAddToVector(probType* vec,int index,bool logValues) const;
 
+    // the inverse of extractValuesAddToVector (with logValues false)
+    inline int setValuesFromVector(probType const* vec,int index);
+
     inline int extractLogParamsAddToVector(probType* vec,int index) const;
 
     inline probVector measure2Vec() const;
@@ -238,6 +265,10 @@ namespace lbLib {
     
     inline void printToFastInfFormat(ostream& out,bool normalizeValues = false,int prec = 5,
 				     bool printLogValues = false) const;
+
+    inline void readOneMeasureBinary(lbBinaryModelReader& in);
+
+    inline void writeBinary(lbBinaryModelWriter& out) const;
     
     static void printStats();
 
@@ -897,12 +928,38 @@ inline lbTableMeasure<VALUE>::~lbTableMeasure() {
 					      lbMeasure const& Estimated,
 					      lbMeasure const& Empirical) const {
 
-    lbTableMeasure<lbValue> temp((lbTableMeasure<lbValue> const&)Estimated);
-    
-    if ( isDirected() ) {
-      temp.normalizeDirected();
-      temp.multiplyByConditionalSumOfMeasure((lbTableMeasure<lbValue> const&)Empirical);
+    if ( !isDirected() ) {
+      // the difference of the counts goes straight into the slice of res,
+      // row by row, where the entries are numbered like the indices of the
+      // shared and idle parameters
+      typedef lbTableMeasure<lbValue>::valueVecVec countVecVec;
+      countVecVec const& est = *((lbTableMeasure<lbValue> const&)Estimated).getValues();
+      countVecVec const& emp = *((lbTableMeasure<lbValue> const&)Empirical).getValues();
+      probType* out = res + index;
+      for (uint i = 0; i < est.size(); i++) {
+	uint rowSize = est[i].size();
+	lbValue const* estRow = &est[i][0];
+	lbValue const* empRow = &emp[i][0];
+	for (uint j = 0; j < rowSize; j++)
+	  out[j] = estRow[j].getValue() - empRow[j].getValue();
+	out += rowSize;
+      }
+      out = res + index;
+      for (uint s = 0; s < _sharedParams.size(); s++) {
+	probType sum = 0;
+	for (uint k = 0; k < _sharedParams[s].size(); k++)
+	  sum += out[_sharedParams[s][k]];
+	for (uint k = 0; k < _sharedParams[s].size(); k++)
+	  out[_sharedParams[s][k]] = sum;
+      }
+      for (uint k = 0; k < _idleParams.size(); k++)
+	out[_idleParams[k]] = 0.0;
+      return _totalSize;
     }
+
+    lbTableMeasure<lbValue> temp((lbTableMeasure<lbValue> const&)Estimated);
+    temp.normalizeDirected();
+    temp.multiplyByConditionalSumOfMeasure((lbTableMeasure<lbValue> const&)Empirical);
     
     temp.subtractMeasure((lbTableMeasure<lbValue> const&)Empirical);
     temp.setIdleParams(_idleParams);
@@ -917,6 +974,52 @@ inline lbTableMeasure<VALUE>::~lbTableMeasure() {
   }
 
 
+  template <class VALUE>
+  inline void lbTableMeasure<VALUE>::calcHessianDiag(probType* diag,probType* counts,
+						     lbMeasure const& Estimated,
+						     probType numOfEvidence) const {
+    if ( isDirected() ) {
+      lbMeasure::calcHessianDiag(diag,counts,Estimated,numOfEvidence);
+      return;
+    }
+
+    // straight from the estimated counts into diag (and counts), like
+    // the gradient in calcDeriv
+    typedef lbTableMeasure<lbValue>::valueVecVec countVecVec;
+    countVecVec const& est = *((lbTableMeasure<lbValue> const&)Estimated).getValues();
+    probType scale = 1.0/numOfEvidence;
+    int k = 0;
+    for (uint i = 0; i < est.size(); i++) {
+      uint rowSize = est[i].size();
+      lbValue const* estRow = &est[i][0];
+      for (uint j = 0; j < rowSize; j++, k++) {
+	probType e = estRow[j].getValue();
+	probType scaled = e*scale;
+	diag[k] = e - scaled*scaled*numOfEvidence;
+	if (counts != NULL)
+	  counts[k] = e;
+      }
+    }
+    for (uint s = 0; s < _sharedParams.size(); s++) {
+      probType diagSum = 0, countSum = 0;
+      for (uint m = 0; m < _sharedParams[s].size(); m++) {
+	diagSum += diag[_sharedParams[s][m]];
+	if (counts != NULL)
+	  countSum += counts[_sharedParams[s][m]];
+      }
+      for (uint m = 0; m < _sharedParams[s].size(); m++) {
+	diag[_sharedParams[s][m]] = diagSum;
+	if (counts != NULL)
+	  counts[_sharedParams[s][m]] = countSum;
+      }
+    }
+    for (uint m = 0; m < _idleParams.size(); m++) {
+      diag[_idleParams[m]] = 0.0;
+      if (counts != NULL)
+	counts[_idleParams[m]] = 0.0;
+    }
+  }
+
   template <class VALUE>
   inline typename lbTableMeasure<VALUE>::valueVec const& lbTableMeasure<VALUE>::getValueVec(lbBaseAssignment const& assign,
 										   varsVec const& vars) const {
@@ -1438,6 +1541,21 @@ uint j;
     return _totalSize;
   }
   
+  template <class VALUE>
+    inline int lbTableMeasure<VALUE>::setValuesFromVector(probType const* vec,int index) {
+    _totalWeight.setValue(0);
+    for (uint i = 0; i < _primarySize; i++) {
+      for(uint j = 0; j < _secondarySize; j++) {
+	getValue(i,j).setValue(vec[index]);
+	_totalWeight += getValue(i,j);
+	index++;
+      }
+    }
+    _totalWeightIsUpdated = true;
+    dirtySparsity();
+    return _totalSize;
+  }
+
   template <class VALUE>
     inline int lbTableMeasure<VALUE>::extractLogParamsAddToVector(probType* vec,int index) const {
 
@@ -1904,6 +2022,73 @@ uint j;
     out << endl;
   }
  
+  // cardinalities, shared and idle entries, and the log values in the
+  // table of the model
+  template <class VALUE>
+  inline void lbTableMeasure<VALUE>::readOneMeasureBinary(lbBinaryModelReader& in) {
+    int cardSize = in.readInt();
+    if (cardSize<=0) {
+      cerr<<"Error, while reading measure from file card size <= 0: "<<cardSize<<endl;
+      exit(1);
+    }
+    _cardSize = cardSize;
+    _card = cardVec(_cardSize);
+    int const* cards = in.readInts(_cardSize);
+    _totalSize = 1;
+    for (uint i = 0; i < _cardSize; i++) {
+      _card[i] = cards[i];
+      _totalSize *= _card[i];
+    }
+    _secondarySize = _card[_cardSize-1];
+    _primarySize = _totalSize/_secondarySize;
+    updateStrideVector();
+    // the values are set from the table below
+    if (_values) {
+      delete _values;
+    }
+    _values = new valueVecVec(_primarySize);
+    for (uint i = 0; i < _primarySize; i++) {
+      (*_values)[i] = valueVec(_secondarySize);
+    }
+
+    intVecVec sharedParams(in.readInt());
+    for (uint s = 0; s < sharedParams.size(); s++) {
+      sharedParams[s] = in.readIntVec();
+    }
+    setSharedParams(sharedParams);
+    setIdleParams(in.readIntVec());
+
+    probType const* logValues = in.readLogValues(_totalSize);
+    _totalWeight.setValue(0);
+    for (uint i = 0; i < _primarySize; i++) {
+      for (uint j = 0; j < _secondarySize; j++) {
+	getValue(i,j).setLogValue(*logValues++);
+	_totalWeight += getValue(i,j);
+      }
+    }
+    _vectorsAreInitialized = true;
+    _totalWeightIsUpdated = true;
+    dirtySparsity();
+  }
+
+  template <class VALUE>
+  inline void lbTableMeasure<VALUE>::writeBinary(lbBinaryModelWriter& out) const {
+    out.writeInt(_cardSize);
+    for (uint k = 0; k < _cardSize; k++) {
+      out.writeInt(_card[k]);
+    }
+    out.writeInt(_sharedParams.size());
+    for (uint s = 0; s < _sharedParams.size(); s++) {
+      out.writeInts(_sharedParams[s]);
+    }
+    out.writeInts(_idleParams);
+    for (uint i = 0; i < _primarySize; i++) {
+      for (uint j = 0; j < _secondarySize; j++) {
+	out.writeLogValue(getValue(i,j).getLogValue());
+      }
+    }
+  }
+
   template <class VALUE>
   inline void lbTableMeasure<VALUE>::printNZEs(int size) const { 
     if (!_sparsityUpdated) {
@@ -1998,32 +2183,41 @@ uint j;
     in->get(lineBuf);
     in->get(); //get '\n'
     string str = lineBuf.str();
-    istringstream iss(str);
+    // the entries are scanned in place, only the names of shared and
+    // idle parameters are copied out of the line
+    char const* pos = str.c_str();
    
     map<string , intVec> sharedIndices = map<string , intVec>();
    
     _totalWeight.setValue(0);
     for (uint i = 0; i < _values->size(); i++) {
       for (int j = 0; j < _card[_cardSize-1]; j++) {
-	string probS;
 	probType prob;
-	iss >> probS;
-	char c = probS[0];
+	while (isspace(*pos)) {
+	  pos++;
+	}
+	char const* token = pos;
+	while (*pos != '\0' && !isspace(*pos)) {
+	  pos++;
+	}
+	char c = *token;
        
 	if (c == 'i') {
+	  string probS(token, pos);
 	  lbParam* pp = idleMap[probS];
 	  prob = pp->getVal();
 	  int idleIndex = (_card[_cardSize-1]*i) + j;
 	  _idleParams.push_back(idleIndex);
 	}
 	else if(c == 's'){
+	  string probS(token, pos);
 	  lbParam * pp = sharedMap[probS];
 	  prob = pp->getVal();
 	  int sharedIndex = (_card[_cardSize-1]*i) + j;
 	  sharedIndices[pp->getName()].push_back(sharedIndex);
 	}
 	else {
-	  prob = atof(probS.c_str());
+	  prob = atof(token);
 	}
 
         /*
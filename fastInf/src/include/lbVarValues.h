@@ -318,7 +318,7 @@ namespace lbLib {
     inline bool isEmpty() const { return _valuesList.isEmpty(); };
 
     bool readAssignmentFromFile(ifstream& in,int size);
-    bool readAssignmentFromString(string assignStr,int size);
+    bool readAssignmentFromString(string const& assignStr,int size);
 
     inline bool areAssigned(varsVec const& vec) const {
       for (uint i = 0; i < vec.size(); i++)  {
@@ -466,33 +466,54 @@ namespace lbLib {
   }
 
   template<class T> bool lbVarValues<T>::readAssignmentFromFile(ifstream& in,int size){
-    char_ptr buffer(new char[lbDefinitions::MAX_BUF_SIZE]);
     assert(!in.eof());
-    in.getline(buffer.get(),lbDefinitions::MAX_BUF_SIZE);
-    string assignStr = string(buffer.get());
+    string assignStr;
+    getline(in,assignStr);
     return readAssignmentFromString(assignStr,size);
   }
 
-  template<class T> bool lbVarValues<T>::readAssignmentFromString(string assignStr, int size){
-    string notKnownStr="?";
-
+  template<class T> bool lbVarValues<T>::readAssignmentFromString(string const& assignStr, int size){
     if (isVerbose(V_ASSIGNMENTS)) {
       cerr << "Reading Assign: " << assignStr << endl;
     }
 
-    vector<string> tokens = lbUtils::tokenize(assignStr, " \n");
-
-    if (tokens.size() == 0 || tokens[0] != "(" || tokens.back() != ")") {
+    // the tokens are separated by spaces and newlines, "(" and ")"
+    // around a value (or ? if unknown) for every variable. They are
+    // scanned in place rather than copied out of the string.
+    char const* p = assignStr.c_str();
+    char const* end = p + assignStr.size();
+    while (end > p && (end[-1] == ' ' || end[-1] == '\n')) {
+      end--;
+    }
+    while (p < end && (*p == ' ' || *p == '\n')) {
+      p++;
+    }
+    if (end - p < 2 || p[0] != '(' || (p[1] != ' ' && p[1] != '\n') ||
+	end[-1] != ')' || (end[-2] != ' ' && end[-2] != '\n')) {
       return false;
     }
+    end--;
+    p++;
 
-    for (uint index = 1; index < tokens.size() - 1; index++) {
-      if (tokens[index] == notKnownStr) {
-  UnsetValueForVar(index-1);
+    int index = 0;
+    while (true) {
+      while (p < end && (*p == ' ' || *p == '\n')) {
+	p++;
+      }
+      if (p == end) {
+	break;
+      }
+      char const* token = p;
+      while (p < end && *p != ' ' && *p != '\n') {
+	p++;
+      }
+      if (p - token == 1 && *token == '?') {
+	UnsetValueForVar(index);
       }
       else {
-  setValueForVar(index-1 ,atoi(tokens[index].c_str()));
+	setValueForVar(index ,atoi(token));
       }
+      index++;
     }
     
     if (isVerbose(V_ASSIGNMENTS)) {
@@ -22,13 +22,19 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
  * lbVariableElimination.h
  * Author: Ian McGraw
  *
- * As braindead an approach to inference as you can get.  This has
- * very few practical applications, and is more for me to just get
- * used to the code.  Essentially I just use the list of measures in
- * the model to perform variable eliminination on all but the variables
- * whos marginals we're looking for.  I don't even do any clever 
- * caching of marginals for later runs. (At least I don't multiply
- * absolutely everything together before summing :-P).
+ * Exact inference by variable elimination over the list of measures
+ * in the model.  For every query we first throw away the factors that
+ * cannot influence the answer: barren directed factors (a child that
+ * is neither queried, observed nor used elsewhere sums out to one) and
+ * every factor that is separated from the query variables by the
+ * evidence.  The remaining variables are eliminated in the order given
+ * by one of the greedy triangulation heuristics of lbJunctionTree
+ * (min-fill by default).
+ *
+ * The pruning and the ordering only depend on which variables are
+ * queried and which are observed (not on the observed values), so we
+ * compile them once into a plan and reuse it for every later query
+ * with the same pattern.
  */
 
 #ifndef _Variable_Elimination_Inference_Object
@@ -38,6 +44,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <lbInferenceObject.h>
 #include <lbModelListener.h>
 #include <lbRegionModel.h>
+#include <lbJunctionTree.h>
 
 namespace lbLib {
   
@@ -59,17 +66,81 @@ namespace lbLib {
 			     lbMeasureDispatcher const& disp);
 
     // dtor
-    virtual ~lbVariableElimination() {}
+    virtual ~lbVariableElimination();
 
     
     // getting probabilty for a partial assignment (the belief on this vars)
     virtual lbAssignedMeasure_ptr prob(varsVec const& vars);
-       
+
+    // same as above, conditioned on the (partial) evidence
+    virtual lbAssignedMeasure_ptr prob(varsVec const& vars, lbAssignment const& evidence);
+
+    /*!
+      Set the heuristic used to order the eliminations. Supported
+      methods are eMinFill (default), eMinWeight, eMinSize and eSeq
+      (the order of the variables in the model). Changing the method
+      drops all cached plans.
+    */
+    void setEliminationMethod(lbJunctionTree::JTmethod method);
+
+    lbJunctionTree::JTmethod getEliminationMethod() const { return _method; }
+
+    /*!
+      Turn on/off the removal of barren and separated factors
+      (default on)
+    */
+    void setPruning(bool prune);
+
+    /*!
+      Drop all cached elimination plans
+    */
+    void clearPlans();
+
+    int getNumOfPlans() const { return _plans.size(); }
+
+    int getPlanHits() const { return _planHits; }
+
+    /*!
+      log10 of the total state space of the factors created when
+      eliminating for this query (the cost of the query)
+    */
+    realVal queryLogWeight(varsVec const& vars, lbAssignment const& evidence);
     
   protected:
 
+    /*!
+      A compiled query: which factors take part and in which order the
+      variables are summed out
+    */
+    struct lbEliminationPlan {
+      intVec _factors;
+      varsVec _order;
+      realVal _logWeight;
+    };
+
+    typedef pair<intVec, intVec> planKey;
+    typedef map<planKey, lbEliminationPlan*> planMap;
+
+    lbEliminationPlan const& getPlan(varsVec const& vars, boolVec const& observed);
+
+    lbEliminationPlan* compilePlan(varsVec const& vars, boolVec const& observed) const;
+
+    void pruneBarrenFactors(boolVec & active, boolVec const& query,
+			    boolVec const& observed) const;
+
+    void pruneSeparatedFactors(boolVec & active, varsVec const& vars,
+			       boolVec const& observed) const;
+
+    varsVec orderEliminations(intVec const& factors, boolVec const& eliminate,
+			      boolVec const& observed, realVal & logWeight) const;
+
+    // evidence variables that are sliced out of the factors (the
+    // queried variables are never sliced)
+    boolVec observedVars(varsVec const& vars, lbAssignment const& evidence) const;
 
   private:
+    void initVarFactors();
+
     void filterInvolvedMeasures(lbAssignedMeasurePtrVec & measures, 
 				lbAssignedMeasurePtrVec & involved,
 				rVarIndex var);
@@ -82,7 +153,16 @@ namespace lbLib {
 
     lbAssignedMeasurePtrVec _measures;
     varsVec _vars;
+    cardVec _cards;
     lbMeasureDispatcher const& _disp;
+
+    // for each variable, the measures it appears in
+    intVecVec _varFactors;
+
+    lbJunctionTree::JTmethod _method;
+    bool _prune;
+    planMap _plans;
+    int _planHits;
   };
 };
 
@@ -20,6 +20,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <ObjectiveFunction.h>
 #include <lbMathFunctions.h>
+#include <Matrix.h>
 
 
 bool ObjectiveFunction::POS_LOG_PARAMS = false;
@@ -27,6 +28,20 @@ bool ObjectiveFunction::GRADIENT_BASED = false;
 bool ObjectiveFunction::RESORT_TO_PREV = true;
 
 
+void ObjectiveFunction::ddfBlocks(long double const* p, long double* res)
+{
+  int N = paramNum();
+  long double** hessian = NewMatrix(N,N);
+  for ( int i=0 ; i<N ; i++ )
+    for ( int j=0 ; j<N ; j++ )
+      hessian[i][j] = 0.0;
+  ddf(p,hessian);
+  for ( int i=0 ; i<N ; i++ )
+    for ( int j=0 ; j<N ; j++ )
+      res[i*N+j] = hessian[i][j];
+  FreeMatrix(hessian,N);
+}
+
 double ObjectiveFunction::L1Regularizer::regPenalty(long double const* p, int size) const
 {
   // Penalty term for L1:  1/2beta * sum_i |Theta_i|
@@ -25,7 +25,11 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <sstream>
 #include <lbDefinitions.h>
 #include <lbNewtonOptimizer.h>
+#include <lbLBFGSOptimizer.h>
 #include <lbGradientAscent.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace lbLib ;
@@ -48,7 +52,19 @@ lbGSLLearningObject::lbGSLLearningObject(string evidenceFileName,
   : _model(model),
     _ownInfObj(true),
     _ownSuffStat(true),
-    _ownObjFunc(true)
+    _ownObjFunc(true),
+    _lbfgsHistory(10),
+    _regType(REG_NONE),
+    _regParam(0.0),
+    _checkpointInterval(10),
+    _maxCheckpoints(0),
+    _numOfCheckpoints(0),
+    _stopped(false),
+    _emIter(0),
+    _emLike(0),
+    _emMethod(tGSLOptimizer::FR),
+    _resume(false),
+    _resumeOptimizer(false)
 {  
   if ( measSet != NULL )
     _measSet = *measSet;
@@ -64,6 +80,7 @@ lbGSLLearningObject::lbGSLLearningObject(string evidenceFileName,
 			     evidenceFileName,
 			     _measSet);
 
+  _suffStat->setWarmStart(true);
   _objFunc = new GSLFuncWrapper(*_suffStat,_model,_model.getParamNum(),_measSet,REG_NONE,0.0);
 
   if (isVerbose(V_LEARNING)) {
@@ -84,7 +101,19 @@ lbGSLLearningObject::lbGSLLearningObject(lbModel& model,
     _objFunc(objFunc),
     _ownInfObj(false),
     _ownSuffStat(false),
-    _ownObjFunc(false)
+    _ownObjFunc(false),
+    _lbfgsHistory(10),
+    _regType(REG_NONE),
+    _regParam(0.0),
+    _checkpointInterval(10),
+    _maxCheckpoints(0),
+    _numOfCheckpoints(0),
+    _stopped(false),
+    _emIter(0),
+    _emLike(0),
+    _emMethod(tGSLOptimizer::FR),
+    _resume(false),
+    _resumeOptimizer(false)
 {
   if ( measSet != NULL )
     _measSet = *measSet;
@@ -100,7 +129,19 @@ lbGSLLearningObject::lbGSLLearningObject(lbModel& model,
     _model(model),
     _ownInfObj(false),
     _ownSuffStat(false),
-    _ownObjFunc(true)
+    _ownObjFunc(true),
+    _lbfgsHistory(10),
+    _regType(REG_NONE),
+    _regParam(0.0),
+    _checkpointInterval(10),
+    _maxCheckpoints(0),
+    _numOfCheckpoints(0),
+    _stopped(false),
+    _emIter(0),
+    _emLike(0),
+    _emMethod(tGSLOptimizer::FR),
+    _resume(false),
+    _resumeOptimizer(false)
 {
   if ( measSet != NULL )
     _measSet = *measSet;
@@ -166,6 +207,7 @@ probType lbGSLLearningObject::learnUndirected(tGSLOptimizer::tProcType method,
   case tGSLOptimizer::STEEP: mname = "STEEP"; break;
   case tGSLOptimizer::NEWTON: mname = "NEWTON"; break;
   case tGSLOptimizer::GRADIENT: mname = "GRADIENT"; break;
+  case tGSLOptimizer::LBFGS: mname = "LBFGS"; break;
     
   default: assert(false); break;
   }
@@ -178,7 +220,7 @@ probType lbGSLLearningObject::learnUndirected(tGSLOptimizer::tProcType method,
       // NOTE: shouldn't we call here
       // wrapper = new lbNRFuncWrapper...
       // ???
-      lbNewtonDiagonalOptimizer opt(*(getObjFunc()));
+      lbNewtonBlockOptimizer opt(*(getObjFunc()));
       fret = opt.Optimize(p,res,LEARN_EPS,step,MaxIter);
     }
     break;
@@ -188,6 +230,18 @@ probType lbGSLLearningObject::learnUndirected(tGSLOptimizer::tProcType method,
       fret = opt.Optimize(p,res,LEARN_EPS,step,MaxIter);
     }
     break;
+  case tGSLOptimizer::LBFGS:
+    {
+      lbLBFGSOptimizer opt(*(getObjFunc()),_lbfgsHistory);
+      if (!_checkpointFile.empty())
+	opt.setCheckpointer(this,_checkpointInterval);
+      if (_resumeOptimizer) {
+	opt.setState(_resumeState.optCounters,_resumeState.optState);
+	_resumeOptimizer = false;
+      }
+      fret = opt.Optimize(p,res,LEARN_EPS,step,MaxIter);
+    }
+    break;
   default:
     tGSLOptimizer opt(*(getObjFunc()),method);
     fret = opt.Optimize(p,res,LEARN_EPS,step,MaxIter);
@@ -220,16 +274,45 @@ probType lbGSLLearningObject::learnEM(tGSLOptimizer::tProcType method,probType L
   //  repeat untill convergrnce \ max loops
   const probType CONVERGENCE_THRESHOLD = (0.001);
   _suffStat->setEMMode(true);
+  _suffStat->resetRunStatistics();
+  _emMethod = method;
+  _numOfCheckpoints = 0;
+  _stopped = false;
   probType oldLike = -HUGE_VAL;
-  oldLike = -f() ; // "-" since we now maximize
-  probType newLike;
-  bool finished = false;
   int iter = 0;
+  if ( _resume ) {
+    _resume = false;
+    if ( _resumeState.inOptimizer && _resumeState.method != method ) {
+      cerr << "ERROR: the checkpoint was written by another optimization method (" << _resumeState.method << ")" << endl;
+      exit(1);
+    }
+    _model.updateLogParamsFromVector(&_resumeState.params[0],false);
+    _suffStat->restartInference(true);
+    if ( _resumeState.inOptimizer ) {
+      // the M step goes on with the counts of its E step
+      _suffStat->setEmpiricalCounts(_resumeState.counts);
+      _resumeOptimizer = (method == tGSLOptimizer::LBFGS);
+    }
+    iter = _resumeState.emIter;
+    oldLike = _resumeState.like;
+    cerr << "Resuming learning after " << iter << " EM iterations" << (_resumeState.inOptimizer ? " (inside the M step)" : "")
+	 << " with LL " << oldLike << endl;
+  }
+  else
+    oldLike = -f() ; // "-" since we now maximize
+  probType newLike = oldLike;
+  bool finished = false;
   do {
+    _emIter = iter;
+    _emLike = oldLike;
 
-    // learn parmeters according to direction
-    learnDirected();
+    // learn parmeters according to direction (unless a checkpoint inside
+    // the M step did)
+    if ( !_resumeOptimizer )
+      learnDirected();
     learnUndirected(method,LEARN_EPS,step,maxIter);
+    if ( _stopped )
+      break;
 
     // reset counts after complete data learning step
     _suffStat->resetCounts();
@@ -247,12 +330,136 @@ probType lbGSLLearningObject::learnEM(tGSLOptimizer::tProcType method,probType L
     oldLike=newLike;
 
     cerr<<"EM : Finished iter num : "<<iter<<" new like is : "<<newLike<<endl;
+
+    if ( !finished && !_checkpointFile.empty() ) {
+      _emIter = iter;
+      _emLike = oldLike;
+      if ( !writeCheckpoint(NULL) )
+	break;
+    }
   } while (!finished );
 
+  if ( _stopped ) {
+    cerr<<"Stopped learning after "<<_numOfCheckpoints<<" checkpoints, EM iter num : "<<_emIter<<endl;
+    printInferenceStatistics(cerr);
+    return _emLike;
+  }
+
   cerr<<"Finished EM Learning EM : total num of iter : "<<iter<<" like is : "<<newLike<<endl;
+  printInferenceStatistics(cerr);
   return newLike;
 }
 
+probType lbGSLLearningObject::learnLocal(lbObjectiveType type,tGSLOptimizer::tProcType method,
+					 probType LEARN_EPS,probType step,int maxIter) {
+  lbLocalLikelihood* local = NULL;
+  switch ( type ) {
+  case OBJ_PSEUDO: local = new lbPseudoLikelihood(*_suffStat,_model,_measSet); break;
+  case OBJ_PIECEWISE: local = new lbPiecewiseLikelihood(*_suffStat,_model,_measSet); break;
+  default: assert(false); break;
+  }
+  local->setNumThreads(_suffStat->getNumThreads());
+  if (_regType == REG_L1)
+    local->setRegularizeParamL1(_regParam);
+  else if (_regType == REG_L2)
+    local->setRegularizeParamL2(_regParam);
+
+  // the local objectives have no hessian
+  if ( method == tGSLOptimizer::NEWTON ) {
+    cerr<<"Newton steps need the hessian, learning the local objective with L-BFGS"<<endl;
+    method = tGSLOptimizer::LBFGS;
+  }
+
+  // checkpoints belong to learnEM(), which a resumed run starts in, so
+  // the local stage runs to the end without them
+  string checkpointFile = _checkpointFile;
+  _checkpointFile.clear();
+  _stopped = false;
+
+  learnDirected();
+  ObjectiveFunction* objFunc = _objFunc;
+  _objFunc = local;
+  learnUndirected(method,LEARN_EPS,step,maxIter);
+  probType like = -f();
+  _objFunc = objFunc;
+  _checkpointFile = checkpointFile;
+  delete local;
+  _suffStat->resetCounts();
+
+  cerr<<"Finished learning the "<<(type == OBJ_PSEUDO ? "pseudo" : "piecewise")
+      <<" likelihood : local like is : "<<like<<endl;
+  return like;
+}
+
+void lbGSLLearningObject::setCheckpoint(string const& fileName, int interval, int maxCheckpoints) {
+  assert(interval > 0 && maxCheckpoints >= 0);
+  _checkpointFile = fileName;
+  _checkpointInterval = interval;
+  _maxCheckpoints = maxCheckpoints;
+}
+
+bool lbGSLLearningObject::resumeFromCheckpoint(string const& fileName) {
+  if ( !_resumeState.read(fileName) )
+    return false;
+  int pSize;
+  probType* params = _model.getLogParamVector(pSize,false);
+  delete[] params;
+  if ( pSize != (int) _resumeState.params.size() ) {
+    cerr << "ERROR: the checkpoint " << fileName << " has " << _resumeState.params.size()
+	 << " parameters and the model " << pSize << endl;
+    return false;
+  }
+  _resume = true;
+  return true;
+}
+
+bool lbGSLLearningObject::checkpoint(lbLBFGSOptimizer const& opt) {
+  return writeCheckpoint(&opt);
+}
+
+bool lbGSLLearningObject::writeCheckpoint(lbLBFGSOptimizer const* opt) {
+  lbLearningCheckpoint state;
+  state.method = _emMethod;
+  state.emIter = _emIter;
+  state.like = _emLike;
+  int pSize;
+  probType* params = _model.getLogParamVector(pSize,false);
+  state.params.assign(params,params+pSize);
+  delete[] params;
+  if ( opt != NULL ) {
+    state.inOptimizer = true;
+    opt->getState(state.optCounters,state.optState);
+    _suffStat->getEmpiricalCounts(state.counts);
+  }
+
+  if ( state.write(_checkpointFile) )
+    cerr << "Checkpoint after " << _emIter << " EM iterations"
+	 << (opt != NULL ? " (inside the M step)" : "") << " written to " << _checkpointFile << endl;
+  else
+    cerr << "ERROR: could not write the checkpoint " << _checkpointFile << endl;
+
+  // a resumed run starts inference from scratch, so this one does too
+  _suffStat->restartInference(opt == NULL);
+
+  _numOfCheckpoints++;
+  if ( _maxCheckpoints > 0 && _numOfCheckpoints >= _maxCheckpoints ) {
+    _stopped = true;
+    return false;
+  }
+  return true;
+}
+
+void lbGSLLearningObject::printInferenceStatistics(ostream& out) const {
+  // the duplicates of the threads propagate too
+  int runs = _suffStat->getNumOfRuns();
+  long messages = _suffStat->getTotalMessageCount();
+  out<<"Inference ("<<(_suffStat->getWarmStart() ? "warm" : "cold")<<" start) : "
+     <<runs<<" propagations, "<<messages<<" messages";
+  if (runs > 0)
+    out<<" ("<<messages/runs<<" per propagation)";
+  out<<endl;
+}
+
 void lbGSLLearningObject::testLikeAndDeriv(probType LOC_EPS) {
   cout << "EMMode: " << _suffStat->getEMMode() << endl; // TODO: to remove
   //print graph
@@ -415,25 +622,55 @@ void GSLFuncWrapper::endIteration(int iter, probType * sum, probType * cnt, stri
   }
 }
   
+int GSLFuncWrapper::derivLayout(measIndicesVec& measures, intVec& offsets, bool blocks) const {
+  measures.clear();
+  offsets.clear();
+  int index = 0;
+  for (measIndex meas=0;meas<_model.getNumOfMeasures();meas++)
+    if ( _measSet.size() == 0 || _measSet.find(meas)!=_measSet.end() )
+      if (!(_model.getMeasure(meas).isDirected())) {
+	int length = _model.getMeasure(meas).getParamNum();
+	measures.push_back(meas);
+	offsets.push_back(index);
+	index += ( blocks ? length*length : length );
+      }
+  return index;
+}
+
+int GSLFuncWrapper::numThreads() const {
+#ifdef _OPENMP
+  return ( _suff.getNumThreads() > 0 ? _suff.getNumThreads() : omp_get_max_threads() );
+#else
+  return 1;
+#endif
+}
+
 void GSLFuncWrapper::df(long double const* p, long double* res) {
   _model.updateLogParamsFromVector(p,true,_measSet);
 
-  int index =0;
   /* the deriv is actually the difference between expected and observed (for log-likelihood).
      notice that this is the deriv , but the parameters actually go
      to the model so we can raise one clique param and cause the change
      in many beliefs.
+     Every measure writes its own slice of res, so they are computed
+     concurrently.
   */
-  for (measIndex meas=0;meas<_model.getNumOfMeasures();meas++)
-    if ( _measSet.size() == 0 || _measSet.find(meas)!=_measSet.end() )
-      if (!(_model.getMeasure(meas).isDirected()))
-	index = calcDerivForMeasure(meas,res,index);
+  measIndicesVec measures;
+  intVec offsets;
+  int index = derivLayout(measures,offsets,false);
+  _suff.calcCounts();
+  int numOfMeasures = measures.size();
+  int threads = numThreads();
+#pragma omp parallel for schedule(dynamic,16) num_threads(threads)
+  for (int m = 0; m < numOfMeasures; m++)
+    calcDerivForMeasure(measures[m],res,offsets[m]);
 
   if (regularize()) {
     long double* tmp = new long double[index];
     dRegPenalty(p,index,tmp);
     for ( int i=0 ; i<index ; i++ )
       res[i] += tmp[i]; // we minimize (therefore we add)!
+    delete[] tmp;
   }
 
   if (isVerbose(V_LEARNING)) {
@@ -455,7 +692,8 @@ int GSLFuncWrapper::calcDerivForMeasure(measIndex meas,
                                         long double* res,
                                         int index) const
 {
-  int size = _model.getMeasure(meas).calcDeriv(res,index, _suff.getEstimatedExpectation(meas), _suff.getEmpiricalExpectation(meas));
+  int size = _model.getMeasure(meas).calcDeriv(res,index, _suff.getEstimatedExpectation(meas,false),
+						_suff.getEmpiricalExpectation(meas,false));
 
   /*  cerr << "Derivative for measure " << meas << " is:";
   for ( int i=0 ; i<size ; i++ )
@@ -482,30 +720,84 @@ void GSLFuncWrapper::ddf(long double const* p, long double** res)
 
   _model.updateLogParamsFromVector(p,true,_measSet);
 
-  int index =0;
+  probType numOfEvidence = _suff.getNumOfEvidence();
+  measIndicesVec measures;
+  intVec offsets;
+  derivLayout(measures,offsets,false);
+  _suff.calcCounts(false);
+  int numOfMeasures = measures.size();
+  int maxLength = 0;
+  for (int m = 0; m < numOfMeasures; m++)
+    maxLength = max(maxLength,_model.getMeasure(measures[m]).getParamNum());
+  int threads = numThreads();
+#pragma omp parallel num_threads(threads)
+  {
+    // the diagonal of a measure, reused for all those of the thread
+    probVector diag(maxLength);
+#pragma omp for schedule(dynamic,16)
+    for (int m = 0; m < numOfMeasures; m++) {
+      measIndex meas = measures[m];
+      int index = offsets[m];
+      lbMeasure const& measure = _model.getMeasure(meas);
+      int length = measure.getParamNum();
+
+      // the Hessian part of measure 'meas' goes to res[index][index]
+      measure.calcHessianDiag(&diag[0],NULL,
+			      _suff.getEstimatedExpectation(meas,false),
+			      numOfEvidence);
+      for ( int i=0 ; i<length ; i++ )
+	res[index+i][index+i] = diag[i];
+    }
+  }
+}
+
+vector<int> GSLFuncWrapper::hessianBlocks() const
+{
+  vector<int> sizes;
   for (measIndex meas=0;meas<_model.getNumOfMeasures();meas++)
     if ( _measSet.size() == 0 || _measSet.find(meas)!=_measSet.end() )
-      if (!(_model.getMeasure(meas).isDirected())) { 
-	int length = _model.getMeasure(meas).getParamNum();
-	probType* tmpRes = new probType[length];
-	
-	// compute the Hessian part of measure 'meas' at res[index][index]
-	//
-	// we can use the calcDeriv of the measure since the Hessian has the
-	// same form as the gradient with the empirical expectation replaced
-	// by the empirical expectation of the features squared and the estimated
-	// expectation is simply squared
-	lbMeasure_Sptr ES = _suff.getEstimatedExpectationSquared(meas);
-	lbMeasure_Sptr SE = _suff.getEstimatedSquaredExpectation(meas);
-	int size = _model.getMeasure(meas).calcDeriv(tmpRes,0,
-						     *SE,
-						     *ES);
-	assert(size == length);
-	
-	// move to matrix
-	for ( int i=0 ; i<length ; i++ )
-	  res[index+i][index+i] = tmpRes[i];
-	index += length;
-	delete[] tmpRes;
-      }
+      if (!(_model.getMeasure(meas).isDirected()))
+	sizes.push_back(_model.getMeasure(meas).getParamNum());
+  return sizes;
+}
+
+void GSLFuncWrapper::ddfBlocks(long double const* p, long double* res)
+{
+  // the diagonal is that of ddf. Off the diagonal the covariance of the
+  // indicators of two entries of a clique is -E[f_i]E[f_j], and the
+  // estimated counts of the measure (mapped to its parameters like a
+  // gradient) give N*E[f]
+  _model.updateLogParamsFromVector(p,true,_measSet);
+
+  probType numOfEvidence = _suff.getNumOfEvidence();
+  measIndicesVec measures;
+  intVec offsets;
+  derivLayout(measures,offsets,true);
+  _suff.calcCounts(false);
+  int numOfMeasures = measures.size();
+  int maxLength = 0;
+  for (int m = 0; m < numOfMeasures; m++)
+    maxLength = max(maxLength,_model.getMeasure(measures[m]).getParamNum());
+  int threads = numThreads();
+#pragma omp parallel num_threads(threads)
+  {
+    // the diagonal and counts of a measure, reused for all those of the
+    // thread
+    probVector diag(maxLength);
+    probVector counts(maxLength);
+#pragma omp for schedule(dynamic,16)
+    for (int m = 0; m < numOfMeasures; m++) {
+      measIndex meas = measures[m];
+      lbMeasure const& measure = _model.getMeasure(meas);
+      int length = measure.getParamNum();
+      measure.calcHessianDiag(&diag[0],&counts[0],
+			      _suff.getEstimatedExpectation(meas,false),
+			      numOfEvidence);
+
+      long double* block = res + offsets[m];
+      for ( int i=0 ; i<length ; i++ )
+	for ( int j=0 ; j<length ; j++ )
+	  block[i*length+j] = ( i==j ? diag[i] : -counts[i]*counts[j]/numOfEvidence );
+    }
+  }
 }
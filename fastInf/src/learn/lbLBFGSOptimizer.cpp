@@ -0,0 +1,354 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbLBFGSOptimizer.h>
+#include <iostream>
+#include <ObjectiveFunction.h>
+#include <math.h>
+
+using namespace std;
+using namespace lbLib;
+
+// sufficient decrease and curvature constants of the strong Wolfe conditions
+static const long double WOLFE_C1 = 1e-4;
+static const long double WOLFE_C2 = 0.9;
+// evaluations of the objective in one line search
+static const int MAX_LINE_EVALS = 10;
+
+static inline long double dot(vector<long double> const& a,
+			      vector<long double> const& b, int n) {
+  long double sum = 0;
+  for (int i = 0; i < n; ++i)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+lbLBFGSOptimizer::lbLBFGSOptimizer(ObjectiveFunction& obj, int historySize)
+  : Optimizer(obj),
+    _historySize(historySize),
+    _iterationsTaken(0),
+    _evaluations(0),
+    _N(0),
+    _f(0),
+    _checkpointer(NULL),
+    _checkpointInterval(1),
+    _stopped(false),
+    _resume(false),
+    _historyBegin(0),
+    _historyUsed(0)
+{
+  assert(historySize > 0);
+}
+
+void lbLBFGSOptimizer::searchDirection()
+{
+  for (int i = 0; i < _N; ++i)
+    _dir[i] = _g[i];
+
+  // newest to oldest
+  for (int k = _historyUsed-1; k >= 0; --k) {
+    int slot = (_historyBegin + k) % _historySize;
+    long double const* s = &_s[slot*_N];
+    long double const* y = &_y[slot*_N];
+    long double a = 0;
+    for (int i = 0; i < _N; ++i)
+      a += s[i] * _dir[i];
+    a *= _rho[slot];
+    _alpha[slot] = a;
+    for (int i = 0; i < _N; ++i)
+      _dir[i] -= a * y[i];
+  }
+
+  // the initial inverse hessian is scaled by s*y / y*y of the newest pair
+  if (_historyUsed > 0) {
+    int slot = (_historyBegin + _historyUsed - 1) % _historySize;
+    long double const* y = &_y[slot*_N];
+    long double yy = 0;
+    for (int i = 0; i < _N; ++i)
+      yy += y[i] * y[i];
+    long double gamma = 1.0 / (_rho[slot] * yy);
+    for (int i = 0; i < _N; ++i)
+      _dir[i] *= gamma;
+  }
+
+  // oldest to newest
+  for (int k = 0; k < _historyUsed; ++k) {
+    int slot = (_historyBegin + k) % _historySize;
+    long double const* s = &_s[slot*_N];
+    long double const* y = &_y[slot*_N];
+    long double b = 0;
+    for (int i = 0; i < _N; ++i)
+      b += y[i] * _dir[i];
+    b *= _rho[slot];
+    for (int i = 0; i < _N; ++i)
+      _dir[i] += (_alpha[slot] - b) * s[i];
+  }
+
+  for (int i = 0; i < _N; ++i)
+    _dir[i] = -_dir[i];
+}
+
+long double lbLBFGSOptimizer::evaluate(long double alpha, long double& dphi)
+{
+  for (int i = 0; i < _N; ++i)
+    _xTrial[i] = _x[i] + alpha * _dir[i];
+  long double f = _Func.fdf(&_xTrial[0], &_gTrial[0]);
+  ++_evaluations;
+  dphi = dot(_gTrial, _dir, _N);
+  return f;
+}
+
+long double lbLBFGSOptimizer::interpolate(long double a1, long double f1, long double d1,
+					  long double a2, long double f2, long double d2)
+{
+  long double lo = (a1 < a2 ? a1 : a2);
+  long double width = fabs(a2 - a1);
+  long double a = lo + 0.5 * width;
+  long double t1 = d1 + d2 - 3 * (f1 - f2) / (a1 - a2);
+  long double disc = t1 * t1 - d1 * d2;
+  if (disc >= 0) {
+    long double t2 = sqrt(disc);
+    if (a2 < a1)
+      t2 = -t2;
+    long double denom = d2 - d1 + 2 * t2;
+    if (denom != 0)
+      a = a2 - (a2 - a1) * (d2 + t2 - t1) / denom;
+  }
+  // the negated test also catches NaN
+  if (!(a >= lo + 0.1 * width && a <= lo + 0.9 * width))
+    a = lo + 0.5 * width;
+  return a;
+}
+
+bool lbLBFGSOptimizer::zoom(long double aLo, long double fLo, long double dLo,
+			    long double aHi, long double fHi, long double dHi,
+			    long double f, long double dphi, int evals,
+			    long double& fTrial)
+{
+  for (int e = 0; e < evals; ++e) {
+    long double a = interpolate(aLo, fLo, dLo, aHi, fHi, dHi);
+    long double d;
+    long double ft = evaluate(a, d);
+    if (!(ft <= f + WOLFE_C1 * a * dphi) || ft >= fLo) {
+      aHi = a; fHi = ft; dHi = d;
+    }
+    else {
+      if (fabs(d) <= -WOLFE_C2 * dphi) {
+	fTrial = ft;
+	return true;
+      }
+      if (d * (aHi - aLo) >= 0) {
+	aHi = aLo; fHi = fLo; dHi = dLo;
+      }
+      aLo = a; fLo = ft; dLo = d;
+    }
+  }
+
+  // out of evaluations, settle for the sufficient decrease of aLo
+  if (aLo > 0) {
+    long double d;
+    fTrial = evaluate(aLo, d);
+    return true;
+  }
+  return false;
+}
+
+bool lbLBFGSOptimizer::lineSearch(long double f, long double dphi, long double alpha,
+				  long double& fTrial)
+{
+  long double aPrev = 0;
+  long double fPrev = f;
+  long double dPrev = dphi;
+  for (int e = 0; e < MAX_LINE_EVALS; ++e) {
+    long double d;
+    long double ft = evaluate(alpha, d);
+    if (!(ft <= f + WOLFE_C1 * alpha * dphi) || (e > 0 && ft >= fPrev))
+      return zoom(aPrev, fPrev, dPrev, alpha, ft, d, f, dphi, MAX_LINE_EVALS-e-1, fTrial);
+    if (fabs(d) <= -WOLFE_C2 * dphi) {
+      fTrial = ft;
+      return true;
+    }
+    if (d >= 0)
+      return zoom(alpha, ft, d, aPrev, fPrev, dPrev, f, dphi, MAX_LINE_EVALS-e-1, fTrial);
+    aPrev = alpha;
+    fPrev = ft;
+    dPrev = d;
+    alpha *= 2;
+  }
+  return false;
+}
+
+void lbLBFGSOptimizer::allocate()
+{
+  _x.resize(_N);
+  _g.resize(_N);
+  _dir.resize(_N);
+  _xTrial.resize(_N);
+  _gTrial.resize(_N);
+  _s.resize(_historySize * _N);
+  _y.resize(_historySize * _N);
+  _rho.resize(_historySize);
+  _alpha.resize(_historySize);
+}
+
+void lbLBFGSOptimizer::getState(vector<int>& counters, vector<long double>& state) const
+{
+  counters.clear();
+  counters.push_back(_N);
+  counters.push_back(_historySize);
+  counters.push_back(_historyBegin);
+  counters.push_back(_historyUsed);
+  counters.push_back(_iterationsTaken);
+  counters.push_back(_evaluations);
+
+  state.clear();
+  state.push_back(_f);
+  state.insert(state.end(), _x.begin(), _x.end());
+  state.insert(state.end(), _g.begin(), _g.end());
+  state.insert(state.end(), _s.begin(), _s.end());
+  state.insert(state.end(), _y.begin(), _y.end());
+  state.insert(state.end(), _rho.begin(), _rho.end());
+}
+
+void lbLBFGSOptimizer::setState(vector<int> const& counters, vector<long double> const& state)
+{
+  assert(counters.size() == 6);
+  _N = counters[0];
+  _historySize = counters[1];
+  _historyBegin = counters[2];
+  _historyUsed = counters[3];
+  _iterationsTaken = counters[4];
+  _evaluations = counters[5];
+  allocate();
+  assert((int) state.size() == 1 + 2 * _N + 2 * _historySize * _N + _historySize);
+
+  vector<long double>::const_iterator it = state.begin();
+  _f = *it++;
+  copy(it, it + _N, _x.begin());
+  it += _N;
+  copy(it, it + _N, _g.begin());
+  it += _N;
+  copy(it, it + _historySize * _N, _s.begin());
+  it += _historySize * _N;
+  copy(it, it + _historySize * _N, _y.begin());
+  it += _historySize * _N;
+  copy(it, it + _historySize, _rho.begin());
+  _resume = true;
+}
+
+long double
+lbLBFGSOptimizer::Optimize(long double const *p, long double *res,
+			   long double eps, long double step, int MaxIter)
+{
+  _stopped = false;
+  if ( _resume ) {
+    // the state of a saved optimizer is already in place
+    assert(_N == _Func.paramNum());
+    _resume = false;
+    cerr << "Continuing L-BFGS at iteration " << _iterationsTaken << endl;
+  }
+  else {
+    _N = _Func.paramNum();
+    allocate();
+    _x.assign(p, p + _N);
+    _historyBegin = 0;
+    _historyUsed = 0;
+    _evaluations = 0;
+    _iterationsTaken = 0;
+    cerr << "Optimizing with " << _N << " parameters and a history of "
+	 << _historySize << " steps\n";
+
+    _f = _Func.fdf(&_x[0], &_g[0]);
+    ++_evaluations;
+  }
+
+  long double& f = _f;
+  while ( _iterationsTaken < MaxIter ) {
+    long double gnorm = sqrt(dot(_g, _g, _N));
+    if ( gnorm < eps )
+      break;
+
+    searchDirection();
+    long double dphi = dot(_g, _dir, _N);
+    if ( dphi >= 0 ) {
+      // the approximation lost positive definiteness, restart from the gradient
+      _historyUsed = 0;
+      searchDirection();
+      dphi = dot(_g, _dir, _N);
+    }
+
+    // the first step (and the first after a restart) has length step
+    long double alpha = 1.0;
+    if ( _historyUsed == 0 )
+      alpha = step / gnorm;
+
+    long double fTrial;
+    if ( !lineSearch(f, dphi, alpha, fTrial) ) {
+      if ( _historyUsed == 0 ) {
+	cerr << "L-BFGS: line search failed at iteration " << _iterationsTaken << endl;
+	break;
+      }
+      cerr << "L-BFGS: line search failed, restarting from the gradient\n";
+      _historyUsed = 0;
+      continue;
+    }
+
+    // keep the pair only if it has positive curvature, replacing the
+    // oldest one when the history is full
+    long double ys = 0;
+    long double yy = 0;
+    for (int i = 0; i < _N; ++i) {
+      long double dy = _gTrial[i] - _g[i];
+      ys += dy * (_xTrial[i] - _x[i]);
+      yy += dy * dy;
+    }
+    if ( ys > 1e-10 * yy ) {
+      int slot = (_historyBegin + _historyUsed) % _historySize;
+      long double* s = &_s[slot*_N];
+      long double* y = &_y[slot*_N];
+      for (int i = 0; i < _N; ++i) {
+	s[i] = _xTrial[i] - _x[i];
+	y[i] = _gTrial[i] - _g[i];
+      }
+      _rho[slot] = 1.0 / ys;
+      if ( _historyUsed < _historySize )
+	++_historyUsed;
+      else
+	_historyBegin = (_historyBegin + 1) % _historySize;
+    }
+
+    _x.swap(_xTrial);
+    _g.swap(_gTrial);
+    f = fTrial;
+    ++_iterationsTaken;
+    cerr << "L-BFGS: iteration " << _iterationsTaken << ", objective " << f
+	 << ", gradient norm " << sqrt(dot(_g, _g, _N)) << ", evaluations " << _evaluations << endl;
+
+    if ( _checkpointer != NULL && _iterationsTaken % _checkpointInterval == 0 &&
+	 _iterationsTaken < MaxIter && !_checkpointer->checkpoint(*this) ) {
+      _stopped = true;
+      break;
+    }
+  }
+
+  for (int i = 0; i < _N; ++i)
+    res[i] = _x[i];
+  return f;
+}
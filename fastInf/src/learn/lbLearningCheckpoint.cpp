@@ -0,0 +1,108 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbLearningCheckpoint.h>
+#include <fstream>
+#include <stdio.h>
+
+using namespace std;
+using namespace lbLib;
+
+// the first bytes of a checkpoint file, and its version
+static char const CHECKPOINT_MAGIC[8] = { 'F', 'I', 'C', 'K', 'P', 'T', '0', '1' };
+
+template <class T>
+static void writeValue(ostream& out, T const& value) {
+  out.write((char const*) &value, sizeof(T));
+}
+
+template <class T>
+static bool readValue(istream& in, T& value) {
+  in.read((char*) &value, sizeof(T));
+  return in.good();
+}
+
+template <class VEC>
+static void writeVector(ostream& out, VEC const& vec) {
+  int size = vec.size();
+  writeValue(out, size);
+  if (size > 0)
+    out.write((char const*) &vec[0], size * sizeof(vec[0]));
+}
+
+template <class VEC>
+static bool readVector(istream& in, VEC& vec) {
+  int size;
+  if (!readValue(in, size) || size < 0)
+    return false;
+  vec.resize(size);
+  if (size > 0)
+    in.read((char*) &vec[0], size * sizeof(vec[0]));
+  return in.good();
+}
+
+lbLearningCheckpoint::lbLearningCheckpoint()
+  : method(0),
+    emIter(0),
+    like(0),
+    inOptimizer(false)
+{
+}
+
+bool lbLearningCheckpoint::write(string const& fileName) const {
+  string tmpName = fileName + ".tmp";
+  {
+    ofstream out(tmpName.c_str(), ios::binary);
+    if (!out.good())
+      return false;
+    out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    writeValue(out, method);
+    writeValue(out, emIter);
+    writeValue(out, like);
+    writeVector(out, params);
+    int optimizerFlag = inOptimizer;
+    writeValue(out, optimizerFlag);
+    writeVector(out, optCounters);
+    writeVector(out, optState);
+    writeVector(out, counts);
+    out.flush();
+    if (!out.good())
+      return false;
+  }
+  return rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+bool lbLearningCheckpoint::read(string const& fileName) {
+  ifstream in(fileName.c_str(), ios::binary);
+  if (!in.good())
+    return false;
+  char magic[sizeof(CHECKPOINT_MAGIC)];
+  in.read(magic, sizeof(magic));
+  if (!in.good() || string(magic, sizeof(magic)) != string(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC))) {
+    cerr << "ERROR: " << fileName << " is not a learning checkpoint" << endl;
+    return false;
+  }
+  int optimizerFlag;
+  bool ok = readValue(in, method) && readValue(in, emIter) && readValue(in, like) &&
+    readVector(in, params) && readValue(in, optimizerFlag) &&
+    readVector(in, optCounters) && readVector(in, optState) && readVector(in, counts);
+  inOptimizer = (optimizerFlag != 0);
+  return ok;
+}
@@ -0,0 +1,172 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbLearningSweep.h>
+#include <lbBeliefPropagation.h>
+#include <iomanip>
+#include <sstream>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace lbLib;
+
+// name of a method in the summary and the output files
+static char const* methodName(tGSLOptimizer::tProcType method) {
+  switch (method) {
+  case tGSLOptimizer::FR: return "FR";
+  case tGSLOptimizer::PR: return "PR";
+  case tGSLOptimizer::BFGS: return "BFGS";
+  case tGSLOptimizer::STEEP: return "STEEP";
+  case tGSLOptimizer::SIMPLEX: return "SIMPLEX";
+  case tGSLOptimizer::NEWTON: return "NEWTON";
+  case tGSLOptimizer::GRADIENT: return "GRADIENT";
+  case tGSLOptimizer::LBFGS: return "LBFGS";
+  }
+  return "UNKNOWN";
+}
+
+lbLearningSweep::lbLearningSweep(lbModel& model,
+				 lbMeasureDispatcher const& disp,
+				 string evidenceFileName,
+				 set<measIndex> const* measSet)
+  : _model(model),
+    _disp(disp),
+    _evidenceFileName(evidenceFileName),
+    _methods(1, tGSLOptimizer::FR),
+    _smoothings(1, 0.5),
+    _thresh(1e-5),
+    _compareType(C_MAX),
+    _queueType(MQT_WEIGHTED),
+    _warmStart(true),
+    _lbfgsHistory(10),
+    _numThreads(0)
+{
+  if ( measSet != NULL )
+    _measSet = *measSet;
+}
+
+void lbLearningSweep::addRegularization(RegularizationType type, double param) {
+  _regTypes.push_back(type);
+  _regParams.push_back(param);
+}
+
+void lbLearningSweep::setInference(double thresh, lbMessageCompareType cType, lbMessageQueueType qType) {
+  _thresh = thresh;
+  _compareType = cType;
+  _queueType = qType;
+}
+
+int lbLearningSweep::getNumOfSettings() const {
+  return _methods.size() * _smoothings.size() * max((int) _regTypes.size(), 1);
+}
+
+void lbLearningSweep::buildSettings(string const& outputPrefix) {
+  _settings.clear();
+  int numOfRegs = max((int) _regTypes.size(), 1);
+  for (uint m = 0; m < _methods.size(); m++) {
+    for (uint s = 0; s < _smoothings.size(); s++) {
+      for (int r = 0; r < numOfRegs; r++) {
+	lbSweepSetting setting;
+	setting.method = _methods[m];
+	setting.smooth = _smoothings[s];
+	setting.regType = _regTypes.empty() ? REG_NONE : _regTypes[r];
+	setting.regParam = _regTypes.empty() ? 0 : _regParams[r];
+	setting.like = 0;
+	setting.seconds = 0;
+	if (!outputPrefix.empty()) {
+	  ostringstream name;
+	  name << outputPrefix << "_" << methodName(setting.method) << "_pS" << setting.smooth;
+	  if (setting.regType == REG_L1)
+	    name << "_r1" << setting.regParam;
+	  else if (setting.regType == REG_L2)
+	    name << "_r2" << setting.regParam;
+	  name << ".net";
+	  setting.output = name.str();
+	}
+	_settings.push_back(setting);
+      }
+    }
+  }
+}
+
+void lbLearningSweep::runSetting(lbSuffStat const& evidence, lbSweepSetting& setting,
+				 probType eps, probType step, int maxIter, int maxEMIter) const {
+  double start = wallTime();
+  lbModel model(_model);
+  lbBeliefPropagation infObj(model, _disp);
+  infObj.setThreshold(_thresh);
+  infObj.setCompareType(_compareType);
+  infObj.setSmoothing(setting.smooth);
+  infObj.setQueueType(_queueType);
+  lbSuffStat suff(infObj, evidence, _measSet);
+  suff.setNumThreads(1);
+
+  lbGSLLearningObject learner(model, &suff, &infObj, _disp, &_measSet);
+  learner.setWarmStart(_warmStart);
+  learner.setLBFGSHistory(_lbfgsHistory);
+  if (setting.regType == REG_L1)
+    learner.setRegularizeParamL1(setting.regParam);
+  else if (setting.regType == REG_L2)
+    learner.setRegularizeParamL2(setting.regParam);
+  setting.like = learner.learnEM(setting.method, eps, step, maxIter, maxEMIter);
+
+  if (!setting.output.empty())
+    model.printAllNetToFile(setting.output);
+  setting.seconds = wallTime() - start;
+}
+
+void lbLearningSweep::run(probType eps, probType step, int maxIter, int maxEMIter,
+			  string const& outputPrefix) {
+  buildSettings(outputPrefix);
+
+  // the evidence is parsed once, on the original model
+  lbBeliefPropagation infObj(_model, _disp);
+  infObj.setThreshold(_thresh);
+  lbSuffStat evidence(infObj, _evidenceFileName, _measSet);
+
+  int numOfSettings = _settings.size();
+#ifdef _OPENMP
+  int threads = ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#endif
+  cerr<<"Sweep : learning "<<numOfSettings<<" settings"<<endl;
+#pragma omp parallel for schedule(dynamic,1) num_threads(threads)
+  for (int s = 0; s < numOfSettings; s++) {
+    runSetting(evidence, _settings[s], eps, step, maxIter, maxEMIter);
+  }
+}
+
+void lbLearningSweep::printSummary(ostream& out) const {
+  out << "# method\tsmoothing\tregularization\tlog likelihood\tseconds\toutput" << endl;
+  for (uint s = 0; s < _settings.size(); s++) {
+    lbSweepSetting const& setting = _settings[s];
+    out << methodName(setting.method) << "\t" << setting.smooth << "\t";
+    if (setting.regType == REG_L1)
+      out << "L1 " << setting.regParam;
+    else if (setting.regType == REG_L2)
+      out << "L2 " << setting.regParam;
+    else
+      out << "none";
+    out << "\t" << setprecision(10) << setting.like << setprecision(6)
+	<< "\t" << setting.seconds << "\t"
+	<< (setting.output.empty() ? string("-") : setting.output) << endl;
+  }
+}
@@ -0,0 +1,342 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbLocalLikelihood.h>
+#include <lbTableMeasure.h>
+#include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace std;
+using namespace lbLib;
+
+// rows whose conditionals are kept at once by the pseudo likelihood
+static const int ROW_BLOCK = 256;
+
+lbLocalLikelihood::lbLocalLikelihood(lbSuffStat const& suff,
+				     lbModel& model,
+				     set<measIndex> const& measSet)
+  : _model(model),
+    _measSet(measSet),
+    _paramNum(model.getParamNum()),
+    _numOfVars(model.getGraph().getNumOfVars()),
+    _numThreads(0),
+    _rows(suff.getFullRows()),
+    _numOfRows(suff.getNumOfFullEvidence()),
+    _totalWeight(0)
+{
+  if (suff.getNumOfFullEvidence() < suff.getNumOfDistinctEvidence()) {
+    cerr<<"Local likelihood ignores "<<suff.getNumOfDistinctEvidence()-suff.getNumOfFullEvidence()
+	<<" partially observed rows"<<endl;
+  }
+  for (int r = 0; r < _numOfRows; r++)
+    _totalWeight += _rows.getWeight(r);
+
+  int numOfCliques = model.getGraph().getNumOfCliques();
+  _cliqVars = vector<varsVec>(numOfCliques);
+  _cliqStrides = vector<intVec>(numOfCliques);
+  _logTables = vector<probVector>(numOfCliques);
+  _counts = vector<probVector>(numOfCliques);
+  for (cliqIndex cliq = 0; cliq < numOfCliques; cliq++) {
+    varsVec const& vars = model.getAssignedMeasureForClique(cliq).getVars();
+    int size = vars.size();
+    _cliqVars[cliq] = vars;
+    _cliqStrides[cliq] = intVec(size);
+    int tableSize = 1;
+    for (int k = size - 1; k >= 0; k--) {
+      _cliqStrides[cliq][k] = tableSize;
+      tableSize *= model.getCards().getCardForVar(vars[k]);
+    }
+    _logTables[cliq] = probVector(tableSize);
+    _counts[cliq] = probVector(tableSize, 0);
+    for (int r = 0; r < _numOfRows; r++) {
+      int index = 0;
+      for (int k = 0; k < size; k++)
+	index += _rows.getValue(r, vars[k]) * _cliqStrides[cliq][k];
+      _counts[cliq][index] += _rows.getWeight(r);
+    }
+  }
+  _expected = _counts;
+
+  _measExpected = measurePtrVec(model.getNumOfMeasures());
+  _measEmpirical = measurePtrVec(model.getNumOfMeasures());
+  for (measIndex meas = 0; meas < model.getNumOfMeasures(); meas++) {
+    if ( _measSet.size() == 0 || _measSet.find(meas)!=_measSet.end() ) {
+      _measExpected[meas] = lbMeasure_Sptr(new lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
+      _measEmpirical[meas] = lbMeasure_Sptr(new lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
+    }
+  }
+}
+
+void lbLocalLikelihood::initEmpirical(bool perVariable) {
+  vector<probVector> empirical = _counts;
+  if (perVariable) {
+    for (uint cliq = 0; cliq < empirical.size(); cliq++)
+      for (uint i = 0; i < empirical[cliq].size(); i++)
+	empirical[cliq][i] *= _cliqVars[cliq].size();
+  }
+  addToMeasures(empirical, _measEmpirical);
+}
+
+int lbLocalLikelihood::numThreads() const {
+#ifdef _OPENMP
+  return ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#else
+  return 1;
+#endif
+}
+
+void lbLocalLikelihood::setParams(long double const* p) {
+  _model.updateLogParamsFromVector(p,true,_measSet);
+  for (uint cliq = 0; cliq < _logTables.size(); cliq++) {
+    lbAssignedMeasure const& cliqueAM = _model.getAssignedMeasureForClique(cliq);
+    varsVec const& vars = _cliqVars[cliq];
+    intVec const& strides = _cliqStrides[cliq];
+    cardVec cards = _model.getCardForVars(vars);
+    lbAssignment assign;
+    for (uint k = 0; k < vars.size(); k++)
+      assign.setValueForVar(vars[k], 0);
+    do {
+      int index = 0;
+      for (uint k = 0; k < vars.size(); k++)
+	index += assign.getValueForVar(vars[k]) * strides[k];
+      _logTables[cliq][index] = cliqueAM.logValueOfFull(assign);
+    } while (assign.advanceOne(cards, vars));
+  }
+}
+
+void lbLocalLikelihood::addToMeasures(vector<probVector> const& counts,
+				      measurePtrVec& tables) const {
+  for (uint meas = 0; meas < tables.size(); meas++)
+    if (tables[meas])
+      tables[meas]->makeZeroes();
+  for (uint cliq = 0; cliq < counts.size(); cliq++) {
+    measIndex meas = _model.getMeasureIndexForClique(cliq);
+    if (!tables[meas])
+      continue;
+    lbMeasure& table = *tables[meas];
+    varsVec const& vars = _cliqVars[cliq];
+    intVec const& strides = _cliqStrides[cliq];
+    cardVec cards = _model.getCardForVars(vars);
+    lbAssignment assign;
+    for (uint k = 0; k < vars.size(); k++)
+      assign.setValueForVar(vars[k], 0);
+    do {
+      int index = 0;
+      for (uint k = 0; k < vars.size(); k++)
+	index += assign.getValueForVar(vars[k]) * strides[k];
+      if (counts[cliq][index] != 0)
+	table.setValueOfFull(assign,vars,table.valueOfFull(assign,vars)+counts[cliq][index]);
+    } while (assign.advanceOne(cards, vars));
+  }
+}
+
+int lbLocalLikelihood::derivFromCounts(long double* res) {
+  addToMeasures(_expected, _measExpected);
+  int index = 0;
+  for (measIndex meas=0;meas<_model.getNumOfMeasures();meas++)
+    if ( _measSet.size() == 0 || _measSet.find(meas)!=_measSet.end() )
+      if (!(_model.getMeasure(meas).isDirected()))
+	index += _model.getMeasure(meas).calcDeriv(res,index,*_measExpected[meas],*_measEmpirical[meas]);
+  return index;
+}
+
+double lbLocalLikelihood::f(long double const* p) {
+  setParams(p);
+  probType retVal = localLikelihood(NULL);
+  if (regularize())
+    retVal -= regPenalty(p,_paramNum);
+  return -retVal; // "-" since we minimize
+}
+
+void lbLocalLikelihood::df(long double const* p, long double* res) {
+  fdf(p,res);
+}
+
+long double lbLocalLikelihood::fdf(long double const* p, long double* res) {
+  setParams(p);
+  probType retVal = localLikelihood(&_expected);
+  int index = derivFromCounts(res);
+  if (regularize()) {
+    retVal -= regPenalty(p,_paramNum);
+    long double* tmp = new long double[index];
+    dRegPenalty(p,index,tmp);
+    for ( int i=0 ; i<index ; i++ )
+      res[i] += tmp[i]; // we minimize (therefore we add)!
+    delete[] tmp;
+  }
+  return -retVal;
+}
+
+lbPseudoLikelihood::lbPseudoLikelihood(lbSuffStat const& suff,
+				       lbModel& model,
+				       set<measIndex> const& measSet)
+  : lbLocalLikelihood(suff, model, measSet)
+{
+  initEmpirical(true);
+  _terms = vector< vector<lbVarTerm> >(_numOfVars);
+  for (uint cliq = 0; cliq < _cliqVars.size(); cliq++) {
+    for (uint k = 0; k < _cliqVars[cliq].size(); k++) {
+      lbVarTerm term;
+      term.cliq = cliq;
+      term.pos = k;
+      _terms[_cliqVars[cliq][k]].push_back(term);
+    }
+  }
+  _condOffset = intVec(_numOfVars + 1, 0);
+  for (int var = 0; var < _numOfVars; var++)
+    _condOffset[var + 1] = _condOffset[var] + model.getCards().getCardForVar(var);
+  _conds = probVector((long) min(ROW_BLOCK, _numOfRows) * _condOffset[_numOfVars]);
+  _block = intVec((long) min(ROW_BLOCK, _numOfRows) * _numOfVars);
+  _varLikelihood = probVector(_numOfVars);
+}
+
+probType lbPseudoLikelihood::conditional(int var, int const* row, probType* cond) const {
+  int card = _condOffset[var + 1] - _condOffset[var];
+  for (int val = 0; val < card; val++)
+    cond[val] = 0;
+  vector<lbVarTerm> const& terms = _terms[var];
+  for (uint t = 0; t < terms.size(); t++) {
+    varsVec const& vars = _cliqVars[terms[t].cliq];
+    intVec const& strides = _cliqStrides[terms[t].cliq];
+    int stride = strides[terms[t].pos];
+    int base = 0;
+    for (uint k = 0; k < vars.size(); k++)
+      base += row[vars[k]] * strides[k];
+    base -= row[var] * stride;
+    probType const* table = &_logTables[terms[t].cliq][base];
+    for (int val = 0; val < card; val++)
+      cond[val] += table[val * stride];
+  }
+
+  probType maxLog = cond[0];
+  for (int val = 1; val < card; val++)
+    maxLog = max(maxLog, cond[val]);
+  probType sum = 0;
+  for (int val = 0; val < card; val++)
+    sum += exp(cond[val] - maxLog);
+  probType logZ = maxLog + log(sum);
+  probType logProb = cond[row[var]] - logZ;
+  for (int val = 0; val < card; val++)
+    cond[val] = exp(cond[val] - logZ);
+  return logProb;
+}
+
+probType lbPseudoLikelihood::localLikelihood(vector<probVector>* counts) {
+  int threads = numThreads();
+  int numOfCliques = _cliqVars.size();
+  int width = _condOffset[_numOfVars];
+  if (counts != NULL) {
+    for (int cliq = 0; cliq < numOfCliques; cliq++)
+      (*counts)[cliq].assign((*counts)[cliq].size(), 0);
+  }
+  _varLikelihood.assign(_numOfVars, 0);
+
+  for (int begin = 0; begin < _numOfRows; begin += ROW_BLOCK) {
+    int end = min(begin + ROW_BLOCK, _numOfRows);
+    _rows.getRows(begin, end, &_block[0]);
+
+    // conditionals of the rows of the block, a variable per thread
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (int var = 0; var < _numOfVars; var++) {
+      probType ll = 0;
+      for (int r = begin; r < end; r++) {
+	ll += _rows.getWeight(r) * conditional(var, &_block[(long) (r - begin) * _numOfVars],
+					       &_conds[(long) (r - begin) * width + _condOffset[var]]);
+      }
+      _varLikelihood[var] += ll;
+    }
+
+    if (counts == NULL)
+      continue;
+
+    // the expected counts of a clique add the conditional of each of
+    // its variables given the rest of the row, a clique per thread
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (int cliq = 0; cliq < numOfCliques; cliq++) {
+      varsVec const& vars = _cliqVars[cliq];
+      intVec const& strides = _cliqStrides[cliq];
+      probType* cliqCounts = &(*counts)[cliq][0];
+      for (int r = begin; r < end; r++) {
+	int const* row = &_block[(long) (r - begin) * _numOfVars];
+	probType weight = _rows.getWeight(r);
+	probType const* conds = &_conds[(long) (r - begin) * width];
+	int base = 0;
+	for (uint k = 0; k < vars.size(); k++)
+	  base += row[vars[k]] * strides[k];
+	for (uint k = 0; k < vars.size(); k++) {
+	  int var = vars[k];
+	  int card = _condOffset[var + 1] - _condOffset[var];
+	  probType const* cond = conds + _condOffset[var];
+	  int varBase = base - row[var] * strides[k];
+	  for (int val = 0; val < card; val++)
+	    cliqCounts[varBase + val * strides[k]] += weight * cond[val];
+	}
+      }
+    }
+  }
+
+  probType ll = 0;
+  for (int var = 0; var < _numOfVars; var++)
+    ll += _varLikelihood[var];
+  return ll;
+}
+
+lbPiecewiseLikelihood::lbPiecewiseLikelihood(lbSuffStat const& suff,
+					     lbModel& model,
+					     set<measIndex> const& measSet)
+  : lbLocalLikelihood(suff, model, measSet)
+{
+  initEmpirical(false);
+  _cliqLikelihood = probVector(_cliqVars.size());
+}
+
+probType lbPiecewiseLikelihood::localLikelihood(vector<probVector>* counts) {
+  int threads = numThreads();
+  int numOfCliques = _cliqVars.size();
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (int cliq = 0; cliq < numOfCliques; cliq++) {
+    probVector const& table = _logTables[cliq];
+    int size = table.size();
+    probType maxLog = table[0];
+    for (int i = 1; i < size; i++)
+      maxLog = max(maxLog, table[i]);
+    probType sum = 0;
+    for (int i = 0; i < size; i++)
+      sum += exp(table[i] - maxLog);
+    probType logZ = maxLog + log(sum);
+
+    probType ll = -_totalWeight * logZ;
+    for (int i = 0; i < size; i++) {
+      if (_counts[cliq][i] != 0)
+	ll += _counts[cliq][i] * table[i];
+      if (counts != NULL)
+	(*counts)[cliq][i] = _totalWeight * exp(table[i] - logZ);
+    }
+    _cliqLikelihood[cliq] = ll;
+  }
+
+  probType ll = 0;
+  for (int cliq = 0; cliq < numOfCliques; cliq++)
+    ll += _cliqLikelihood[cliq];
+  return ll;
+}
@@ -26,6 +26,9 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 #include <Matrix.h>
 #include <ObjectiveFunction.h>
 #include <math.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace std;
 using namespace lbLib;
@@ -172,7 +175,12 @@ lbNewtonDiagonalOptimizer::Optimize(long double const *p, long double *res,
   long double* deriv = new long double[N];
   long double* hessian = new long double[N];
   long double* invhessian = new long double[N];
-  long double** full_hessian = NewMatrix(N, N);
+  // only the diagonals of the blocks are used
+  vector<int> blockSizes = _Func.hessianBlocks();
+  int blocksLength = 0;
+  for (uint b = 0; b < blockSizes.size(); ++b)
+    blocksLength += blockSizes[b]*blockSizes[b];
+  long double* blocks = new long double[blocksLength];
   for ( int i=0 ; i<N ; i++ ) {
     hessian[i] = 0.0;
     invhessian[i] = 0.0;
@@ -192,10 +200,13 @@ lbNewtonDiagonalOptimizer::Optimize(long double const *p, long double *res,
     // Compute gradient
     _Func.df(p_curr,deriv);
     // Compute Hessian
-    _Func.ddf(p_curr, full_hessian);
-    for (int i = 0; i < N; ++i) {
-      hessian[i] = full_hessian[i][i];
-      invhessian[i] = 1.0/hessian[i];
+    _Func.ddfBlocks(p_curr, blocks);
+    for (uint b = 0, i = 0, offset = 0; b < blockSizes.size(); ++b) {
+      for (int k = 0; k < blockSizes[b]; ++k, ++i) {
+	hessian[i] = blocks[offset + k*blockSizes[b] + k];
+	invhessian[i] = 1.0/hessian[i];
+      }
+      offset += blockSizes[b]*blockSizes[b];
     }
     
     if (!firstStep) {
@@ -247,7 +258,153 @@ lbNewtonDiagonalOptimizer::Optimize(long double const *p, long double *res,
     res[i] = p_curr[i];
   }
   delete[] p_curr;
-  FreeMatrix(full_hessian, N);
+  delete[] blocks;
+  return retVal;
+}
+
+lbNewtonBlockOptimizer::lbNewtonBlockOptimizer(ObjectiveFunction& obj)
+  : Optimizer(obj),
+    _numThreads(0)
+{}
+
+void lbNewtonBlockOptimizer::solveBlock(long double* block, int size, long double* rhs)
+{
+  // ridge relative to the largest diagonal entry
+  long double maxDiag = 0.0;
+  for (int i = 0; i < size; ++i)
+    maxDiag = max(maxDiag, fabsl(block[i*size+i]));
+  long double ridge = 1e-6 * (maxDiag > 0 ? maxDiag : 1.0);
+  long double* diag = new long double[size];
+  for (int i = 0; i < size; ++i) {
+    block[i*size+i] += ridge;
+    diag[i] = block[i*size+i];
+  }
+
+  // lower triangular Cholesky factor in place
+  bool positive = true;
+  for (int j = 0; j < size && positive; ++j) {
+    long double d = block[j*size+j];
+    for (int k = 0; k < j; ++k)
+      d -= block[j*size+k]*block[j*size+k];
+    if (d <= 0) {
+      positive = false;
+      break;
+    }
+    d = sqrtl(d);
+    block[j*size+j] = d;
+    for (int i = j+1; i < size; ++i) {
+      long double v = block[i*size+j];
+      for (int k = 0; k < j; ++k)
+	v -= block[i*size+k]*block[j*size+k];
+      block[i*size+j] = v/d;
+    }
+  }
+
+  if (positive) {
+    // L y = rhs, then L^T x = y
+    for (int i = 0; i < size; ++i) {
+      for (int k = 0; k < i; ++k)
+	rhs[i] -= block[i*size+k]*rhs[k];
+      rhs[i] /= block[i*size+i];
+    }
+    for (int i = size-1; i >= 0; --i) {
+      for (int k = i+1; k < size; ++k)
+	rhs[i] -= block[k*size+i]*rhs[k];
+      rhs[i] /= block[i*size+i];
+    }
+  }
+  else {
+    for (int i = 0; i < size; ++i)
+      rhs[i] = ( diag[i] > 0 ? rhs[i]/diag[i] : 0.0 );
+  }
+  delete[] diag;
+}
+
+long double
+lbNewtonBlockOptimizer::Optimize(long double const *p, long double *res,
+				 long double eps, long double step, int MaxIter)
+{
+  double retVal = 0.0;
+  int N = _Func.paramNum();
+  bool firstStep = true;
+
+  vector<int> blockSizes = _Func.hessianBlocks();
+  int numOfBlocks = blockSizes.size();
+  vector<int> paramBegin(numOfBlocks+1, 0);
+  vector<int> blockBegin(numOfBlocks+1, 0);
+  for (int b = 0; b < numOfBlocks; ++b) {
+    paramBegin[b+1] = paramBegin[b] + blockSizes[b];
+    blockBegin[b+1] = blockBegin[b] + blockSizes[b]*blockSizes[b];
+  }
+  assert(paramBegin[numOfBlocks] == N);
+  cerr << "Optimizing with " << N << " parameters in " << numOfBlocks << " blocks\n";
+
+  long double* deriv = new long double[N];
+  long double* oldDeriv = new long double[N];
+  long double* blocks = new long double[blockBegin[numOfBlocks]];
+  long double* p_curr = new long double[N];
+  long double* p_new = new long double[N];
+  long double* temp;
+  for ( int i=0 ; i<N ; i++ ) {
+    p_curr[i] = p[i];
+  }
+#ifdef _OPENMP
+  int threads = ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#endif
+
+  // Newton Outer Loop
+  _iterationsTaken = 0;
+  do {
+    _Func.df(p_curr,deriv);
+    _Func.ddfBlocks(p_curr,blocks);
+
+    if (!firstStep) {
+      double dotProduct = 0;
+      for (int i = 0; i < N; ++i)
+	dotProduct += deriv[i] * oldDeriv[i];
+      if (dotProduct < 0) {
+	step = step *.75;
+	cerr << "Dot product < 0, decreasing step size to " << step << endl;
+      }
+    }
+    firstStep = false;
+
+    // keep the gradient for the next step size check, and solve
+    // H * dir = grad block by block
+    for (int i = 0; i < N; ++i)
+      oldDeriv[i] = deriv[i];
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (int b = 0; b < numOfBlocks; ++b)
+      solveBlock(blocks + blockBegin[b], blockSizes[b], deriv + paramBegin[b]);
+
+    // p_new = p - step_size * inv_H * grad
+    long double der_magnitude = 0;
+    for (int i = 0; i < N; ++i) {
+      p_new[i] = p_curr[i] - step * deriv[i];
+      der_magnitude += deriv[i]*deriv[i];
+    }
+    temp = p_curr;
+    p_curr = p_new;
+    p_new = temp;
+
+    if ( der_magnitude < eps) {
+      break;
+    } else {
+      cerr << "Newton: iteration " << _iterationsTaken << ", Newton step magnitude: "
+	   << der_magnitude << endl;
+    }
+    ++_iterationsTaken;
+
+  } while ( _iterationsTaken < MaxIter);
+
+  for (int i = 0; i < N; ++i) {
+    res[i] = p_curr[i];
+  }
+  delete[] deriv;
+  delete[] oldDeriv;
+  delete[] blocks;
+  delete[] p_curr;
+  delete[] p_new;
   return retVal;
 }
 
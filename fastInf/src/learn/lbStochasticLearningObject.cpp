@@ -0,0 +1,159 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbStochasticLearningObject.h>
+#include <lbBeliefPropagation.h>
+#include <lbEvidenceMatrix.h>
+#include <fstream>
+#include <math.h>
+
+using namespace std;
+using namespace lbLib;
+
+// moment decays of Adam, and the term keeping the steps of Adam and
+// Adagrad finite
+static const long double ADAM_BETA1 = 0.9;
+static const long double ADAM_BETA2 = 0.999;
+static const long double STEP_EPS = 1e-8;
+// rows read at a time when adding up the weight of the evidence
+static const int COUNT_ROWS = 10000;
+
+lbStochasticLearningObject::lbStochasticLearningObject(string evidenceFileName,
+						       lbModel& model,
+						       lbMeasureDispatcher const& disp,
+						       double thresh,
+						       lbMessageCompareType cType,
+						       double smooth,
+						       lbMessageQueueType qType,
+						       set<measIndex> const* measSet)
+  : _evidenceFileName(evidenceFileName),
+    _model(model),
+    _update(SU_ADAM),
+    _batchSize(100),
+    _rate(0.05),
+    _decay(0)
+{
+  if ( measSet != NULL )
+    _measSet = *measSet;
+
+  _infObj = new lbBeliefPropagation(model, disp);
+  _infObj->setThreshold(thresh);
+  _infObj->setCompareType(cType);
+  _infObj->setSmoothing(smooth);
+  _infObj->setQueueType(qType);
+  _suffStat = new lbSuffStat(*_infObj,_measSet);
+  _suffStat->setWarmStart(true);
+  _objFunc = new GSLFuncWrapper(*_suffStat,_model,_model.getParamNum(),_measSet,REG_NONE,0.0);
+
+  ifstream in(evidenceFileName.c_str());
+  if (!in) {
+    cerr<<"error while reading file: "<<evidenceFileName<<endl;
+  }
+  // the rows the mini-batches will have, read the way they read them
+  lbEvidenceMatrix rows(_model.getCardVec());
+  _totalWeight = 0;
+  while (rows.readStream(in,COUNT_ROWS) > 0) {
+    for (int r = 0; r < rows.getNumOfRows(); r++)
+      _totalWeight += rows.getWeight(r);
+    rows.clear();
+  }
+  cerr<<"total weight of the evidence "<<_totalWeight<<endl;
+}
+
+lbStochasticLearningObject::~lbStochasticLearningObject() {
+  delete _objFunc;
+  delete _suffStat;
+  delete _infObj;
+}
+
+void lbStochasticLearningObject::update(probType* p, int size, int step, probType batchWeight) {
+  switch (_update) {
+  case SU_SGD:
+    {
+      long double rate = _rate / (1 + _decay * step);
+      for (int i = 0; i < size; i++)
+	p[i] -= rate * _grad[i] / batchWeight;
+    }
+    break;
+  case SU_ADAGRAD:
+    for (int i = 0; i < size; i++) {
+      long double g = _grad[i] / batchWeight;
+      _second[i] += g * g;
+      p[i] -= _rate * g / (sqrt(_second[i]) + STEP_EPS);
+    }
+    break;
+  case SU_ADAM:
+    {
+      // the moments start at zero, the corrections remove that bias
+      long double firstCorrection = 1 - pow(ADAM_BETA1, (long double) step);
+      long double secondCorrection = 1 - pow(ADAM_BETA2, (long double) step);
+      for (int i = 0; i < size; i++) {
+	long double g = _grad[i] / batchWeight;
+	_first[i] = ADAM_BETA1 * _first[i] + (1 - ADAM_BETA1) * g;
+	_second[i] = ADAM_BETA2 * _second[i] + (1 - ADAM_BETA2) * g * g;
+	p[i] -= _rate * (_first[i] / firstCorrection) /
+	  (sqrt(_second[i] / secondCorrection) + STEP_EPS);
+      }
+    }
+    break;
+  default:
+    assert(false);
+  }
+}
+
+probType lbStochasticLearningObject::learn(int epochs) {
+  int pSize;
+  probType* p = _model.getLogParamVector(pSize,true,_measSet);
+  _grad.assign(pSize,0);
+  _first.assign(pSize,0);
+  _second.assign(pSize,0);
+  _suffStat->resetRunStatistics();
+
+  ifstream in(_evidenceFileName.c_str());
+  int step = 0;
+  probType like = 0;
+  for (int epoch = 0; epoch < epochs; epoch++) {
+    in.clear();
+    in.seekg(0);
+    probType epochLike = 0;
+    probType epochWeight = 0;
+    int batches = 0;
+    while (_suffStat->setEvidence(in,_batchSize) > 0) {
+      probType batchWeight = _suffStat->getNumOfEvidence();
+      _objFunc->setRegularizeScale(batchWeight / _totalWeight);
+      _objFunc->df(p,&_grad[0]);
+      // the likelihood at the parameters of the gradient
+      epochLike += _suffStat->getLogLikelihood();
+      epochWeight += batchWeight;
+      update(p,pSize,++step,batchWeight);
+      batches++;
+    }
+    if (epochWeight > 0)
+      like = epochLike / epochWeight;
+    cerr<<"Stochastic : epoch "<<epoch+1<<" ("<<batches<<" batches) log likelihood per row : "
+	<<like<<endl;
+  }
+
+  _model.updateLogParamsFromVector(p,true,_measSet);
+  cerr<<"Inference ("<<(_suffStat->getWarmStart() ? "warm" : "cold")<<" start) : "
+      <<_suffStat->getNumOfRuns()<<" propagations, "<<_suffStat->getTotalMessageCount()<<" messages"<<endl;
+  delete[] p;
+  return like;
+}
@@ -20,7 +20,12 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "lbSuffStat.h"
 #include <lbTableMeasure.h>
-
+#include <lbBeliefPropagation.h>
+#include <map>
+#include <algorithm>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 using namespace lbLib ;
 
@@ -28,7 +33,12 @@ lbSuffStat::lbSuffStat(lbInferenceObject& infObj,string const& evidenceFileName,
                        set<measIndex> const& measSet) 
   : lbModelListener(infObj.getModel()),
     _infObj(infObj),
-    _measSet(measSet)
+    _fullRows(infObj.getModel().getCardVec()),
+    _totalWeight(0),
+    _fullWeight(0),
+    _measSet(measSet),
+    _numThreads(0),
+    _warmStart(false)
 {
   readEvidenceFromFile(evidenceFileName);
   Init();
@@ -37,15 +47,40 @@ lbSuffStat::lbSuffStat(lbInferenceObject& infObj,string const& evidenceFileName,
 lbSuffStat::lbSuffStat(lbInferenceObject& infObj,set<measIndex> const& measSet) 
   : lbModelListener(infObj.getModel()),
     _infObj(infObj),
-    _measSet(measSet)
+    _fullRows(infObj.getModel().getCardVec()),
+    _totalWeight(0),
+    _fullWeight(0),
+    _measSet(measSet),
+    _numThreads(0),
+    _warmStart(false)
 {
   Init();
 }
 
+lbSuffStat::lbSuffStat(lbInferenceObject& infObj,lbSuffStat const& other,
+                       set<measIndex> const& measSet) 
+  : lbModelListener(infObj.getModel()),
+    _infObj(infObj),
+    _weights(other._weights),
+    _fullRows(other._fullRows),
+    _fullCounts(other._fullCounts),
+    _totalWeight(other._totalWeight),
+    _fullWeight(other._fullWeight),
+    _measSet(measSet),
+    _EMMode(other._EMMode),
+    _numThreads(other._numThreads),
+    _warmStart(other._warmStart)
+{
+  for (uint i=0;i<other._evidence.size();i++)
+    _evidence.push_back(new lbFullAssignment(*other._evidence[i]));
+  Init();
+}
+
 void lbSuffStat::Init()
 {
   initCounts();
   _lLikelihood=0;
+  _inferredComputed = false;
   _empiricalComputed = false;
   _estimatedComputed = false;
   _llComputed = false;
@@ -55,28 +90,67 @@ void lbSuffStat::Init()
 }
 
 void lbSuffStat::readEvidenceFromFile(string evidenceFileName) {
-
-  ifstream_ptr in;
-  try {
-    in = ifstream_ptr(new ifstream(evidenceFileName.c_str()));
-  }
-  catch (...){
+  lbEvidenceMatrix matrix(_infObj.getModel().getCardVec());
+  if (!matrix.readFile(evidenceFileName,_numThreads))
     cerr<<"error while reading file: "<<evidenceFileName<<endl;
-  }
+  int numOfLines = setEvidenceRows(matrix,evidenceFileName);
+  cerr<<"num of evidences "<<numOfLines<<" ("<<getNumOfDistinctEvidence()<<" distinct, "
+      <<_fullRows.getNumOfRows()<<" of them fully observed)"<<endl;
+}
+
+int lbSuffStat::setEvidence(istream& in,int maxRows) {
+  for (uint i=0;i<_evidence.size();i++)
+    if (_evidence[i])
+      delete _evidence[i];
+  return readEvidence(in,"stream",maxRows);
+}
+
+int lbSuffStat::readEvidence(istream& in,string const& name,int maxRows) {
+  lbEvidenceMatrix matrix(_infObj.getModel().getCardVec());
+  matrix.readStream(in,maxRows);
+  return setEvidenceRows(matrix,name);
+}
+
+int lbSuffStat::setEvidenceRows(lbEvidenceMatrix const& matrix,string const& name) {
   _evidence = fullAssignmentPtrVec();
+  _weights = probVector();
+  _fullRows.clear();
+  _totalWeight = 0;
+  _fullWeight = 0;
+  intVec const& badLines = matrix.getBadLines();
+  for (uint i=0;i<badLines.size();i++)
+    cerr<<"Error reading assignment from "<<name<<" (line "<<badLines[i]<<")"<<endl;
+
+  // the row of every distinct assignment, fully observed rows are
+  // stored as -1-row
+  intVec distinct,rowOf;
+  matrix.findDistinctRows(distinct,rowOf);
+  intVec rows(distinct.size());
   bool isEvidenceFull = true;
-  while (!in->eof()) {
-    lbFullAssignment_ptr assign(new lbFullAssignment());
-    if (assign->readAssignmentFromFile(*in,_infObj.getModel().getGraph().getNumOfVars())) {
-      _evidence.push_back(assign);
-      //check whether this is partial assignment
-      if (!isEvidenceFull) //unless some evidence is already partial and checked this flag
-	if (!(assign->areAssigned(_infObj.getGraph().getVars().getVarsVec())))
-	  isEvidenceFull=false;
+  for (uint d=0;d<distinct.size();d++) {
+    //full rows are counted directly and need no inference
+    if (matrix.isFullyObserved(distinct[d])) {
+      rows[d] = -1-_fullRows.getNumOfRows();
+      _fullRows.appendRow(matrix,distinct[d],0);
+      continue;
+    }
+    //only the distinct partial rows are made into assignments
+    rows[d] = _evidence.size();
+    _evidence.push_back(matrix.makeAssignment(distinct[d]));
+    _weights.push_back(0);
+    isEvidenceFull = false;
+  }
+  int numOfLines = matrix.getNumOfRows();
+  for (int r=0;r<numOfLines;r++) {
+    probType weight = matrix.getWeight(r);
+    int row = rows[rowOf[r]];
+    _totalWeight += weight;
+    if (row < 0) {
+      _fullRows.addWeight(-1-row,weight);
+      _fullWeight += weight;
     }
     else {
-      cerr<<"Error reading assignment from file "<<evidenceFileName<<endl;
-      delete assign;
+      _weights[row] += weight;
     }
   }
   //after reading all evidence, if all are full, no need to compute partition function or each evidence
@@ -87,25 +161,110 @@ void lbSuffStat::readEvidenceFromFile(string evidenceFileName) {
     _EMMode = true;
   }
 
-  cerr<<"num of evidences "<<_evidence.size()<<endl;
-  in->close();
+  countFullEvidence();
   _empiricalComputed = false;
   _estimatedComputed = false;
   _llComputed = false;
+  _inferredComputed = false;
   _expllComputed = false;
   _countsInitialized = false;
+  return numOfLines;
+}
+
+int lbSuffStat::cliqueStrides(cliqIndex cliq,intVec& strides) const {
+  // the last variable of the clique changes fastest
+  varsVec const& vars = _model.getAssignedMeasureForClique(cliq).getVars();
+  strides = intVec(vars.size());
+  int size = 1;
+  for (int k=vars.size()-1;k>=0;k--) {
+    strides[k] = size;
+    size *= _model.getCards().getCardForVar(vars[k]);
+  }
+  return size;
+}
+
+void lbSuffStat::countFullEvidence() {
+  int numOfCliques = _graph.getNumOfCliques();
+  int numOfRows = _fullRows.getNumOfRows();
+  _fullCounts = vector<probVector>(numOfCliques);
+  if (numOfRows == 0)
+    return;
+
+  // one pass over the packed rows for every clique
+  for (cliqIndex cliq=0;cliq<numOfCliques;cliq++) {
+    varsVec const& vars = _model.getAssignedMeasureForClique(cliq).getVars();
+    intVec strides;
+    probVector& counts = _fullCounts[cliq];
+    counts.assign(cliqueStrides(cliq,strides),0);
+    int numOfCliqVars = vars.size();
+    for (int r=0;r<numOfRows;r++) {
+      int index = 0;
+      for (int k=0;k<numOfCliqVars;k++)
+        index += _fullRows.getValue(r,vars[k])*strides[k];
+      counts[index] += _fullRows.getWeight(r);
+    }
+  }
+}
+
+void lbSuffStat::addFullCounts() const {
+  if (_fullRows.getNumOfRows() == 0)
+    return;
+  for (cliqIndex cliq=0;cliq<_graph.getNumOfCliques();cliq++) {
+    measIndex meas = _model.getMeasureIndexForClique(cliq);
+    if (_measSet.size() == 0 || _measSet.find(meas)!=_measSet.end()) {
+      lbMeasure& counts = *_empirCounts[getMeasVecIndex(meas)];
+      varsVec const& vars = _model.getAssignedMeasureForClique(cliq).getVars();
+      intVec strides;
+      cliqueStrides(cliq,strides);
+      cardVec cards = _model.getCardForVars(vars);
+      lbAssignment assign;
+      for (uint k=0;k<vars.size();k++)
+        assign.setValueForVar(vars[k],0);
+      do {
+        int index = 0;
+        for (uint k=0;k<vars.size();k++)
+          index += assign.getValueForVar(vars[k])*strides[k];
+        if (_fullCounts[cliq][index] != 0)
+          counts.setValueOfFull(assign,vars,counts.valueOfFull(assign,vars)+_fullCounts[cliq][index]);
+      } while (assign.advanceOne(cards,vars));
+    }
+  }
+}
+
+probType lbSuffStat::fullLogLikelihood() const {
+  if (_fullRows.getNumOfRows() == 0)
+    return 0;
+  // the log potentials of the observed entries, less the log partition
+  // function for every row
+  probType ll = 0;
+  for (cliqIndex cliq=0;cliq<_graph.getNumOfCliques();cliq++) {
+    lbAssignedMeasure const& cliqueAM = _model.getAssignedMeasureForClique(cliq);
+    varsVec const& vars = cliqueAM.getVars();
+    intVec strides;
+    cliqueStrides(cliq,strides);
+    cardVec cards = _model.getCardForVars(vars);
+    lbAssignment assign;
+    for (uint k=0;k<vars.size();k++)
+      assign.setValueForVar(vars[k],0);
+    do {
+      int index = 0;
+      for (uint k=0;k<vars.size();k++)
+        index += assign.getValueForVar(vars[k])*strides[k];
+      if (_fullCounts[cliq][index] != 0)
+        ll += _fullCounts[cliq][index]*cliqueAM.logValueOfFull(assign);
+    } while (assign.advanceOne(cards,vars));
+  }
+  return ll - _fullWeight*_infObj.initialPartitionFunction();
 }
 
 void lbSuffStat::initCounts(){
   //make all measures for stroing counts
   lbModel const& model = _infObj.getModel();
   int len = measureNum() ;
-  _empirCounts = measurePtrVec(len);
+  _empirCounts = makeCounts();
   _estimatedCounts = measurePtrVec(len);
   for (int i=0;i<len;i++) {
     measIndex meas = getMeasRealIndex(i) ;
-    _empirCounts[i] = lbMeasure_Sptr(new lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
-    _empirCounts[i]->makeZeroes();
     _estimatedCounts[i] = lbMeasure_Sptr(new lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
   }
 
@@ -114,12 +273,82 @@ void lbSuffStat::initCounts(){
   _empirCountsVec = new probType[lenEmpir];
 }
 
+measurePtrVec lbSuffStat::makeCounts() const {
+  lbModel const& model = _infObj.getModel();
+  int len = measureNum() ;
+  measurePtrVec counts(len);
+  for (int i=0;i<len;i++) {
+    measIndex meas = getMeasRealIndex(i) ;
+    counts[i] = lbMeasure_Sptr(new lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
+    counts[i]->makeZeroes();
+  }
+  return counts;
+}
+
+int lbSuffStat::numWorkers() const {
+#ifdef _OPENMP
+  int threads = ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#else
+  int threads = 1;
+#endif
+  threads = min(threads, (int) _evidence.size());
+  // the duplicates register with the model, so they are made here and
+  // not by the threads
+  while ((int) _workers.size() + 1 < threads) {
+    lbInferenceObject* worker = _infObj.duplicate();
+    if (worker == NULL) {
+      break;
+    }
+    _workers.push_back(worker);
+  }
+  return max(1, min(threads, (int) _workers.size() + 1));
+}
+
+lbInferenceObject& lbSuffStat::getWorker(int thread) const {
+  if (thread == 0)
+    return _infObj;
+  return *_workers[thread - 1];
+}
+
+probType lbSuffStat::addEvidenceCounts(lbInferenceObject& infObj,int begin,int end,
+                                       measurePtrVec* counts) const {
+  lbModel& model = infObj.getModel();
+  lbGraphStruct const& graph = model.getGraph();
+  probType ll = 0;
+
+  for (int evidIndex = begin; evidIndex < end; evidIndex++) {
+    if (isVerbose(V_TEMPORARY)) {
+      cerr << "Changing evidence" << endl;
+    }
+
+    infObj.changeEvidence(*(_evidence[evidIndex]));
+    if (counts != NULL) {
+      for (cliqIndex cliq=0;cliq<graph.getNumOfCliques();cliq++){
+        varsVec vars = graph.getVarsVecForClique(cliq);
+        measIndex meas = model.getMeasureIndexForClique(cliq);
+        if (_measSet.size() == 0 || _measSet.find(meas)!=_measSet.end()) {
+          lbAssignedMeasure_ptr assignedMeasPtr = infObj.prob(vars,cliq);
+          ((lbTableMeasure<lbValue>&) *(*counts)[getMeasVecIndex(meas)]).addWeightedMeasure(
+            (lbTableMeasure<lbLogValue> const&) assignedMeasPtr->getMeasure(), _weights[evidIndex]);
+          delete assignedMeasPtr;
+        }
+      }
+    }
+    ll +=_weights[evidIndex]*infObj.evidenceLogProb();
+  }
+
+  infObj.resetEvidence();
+  return ll;
+}
+
 lbSuffStat::~lbSuffStat() {
   for (uint i=0;i<_evidence.size();i++)
     if(_evidence[i])
       delete _evidence[i];
   if (_empirCountsVec)
     delete[] _empirCountsVec;
+  for (uint i=0;i<_workers.size();i++)
+    delete _workers[i];
 }
 
 
@@ -140,10 +369,9 @@ void lbSuffStat::calcEstimatedCounts() const {
     //get estimated count
     if (_measSet.size() == 0 || _measSet.find(meas)!=_measSet.end()) {
       lbAssignedMeasure_ptr assignedMeasPtr = _infObj.prob(vars,cliq);
-      lbTableMeasure<lbValue> tab((lbTableMeasure<lbLogValue> const&)assignedMeasPtr->getMeasure());
+      ((lbTableMeasure<lbValue>&) *_estimatedCounts[getMeasVecIndex(meas)]).addWeightedMeasure(
+        (lbTableMeasure<lbLogValue> const&) assignedMeasPtr->getMeasure(), getNumOfEvidence());
       delete assignedMeasPtr;
-      tab.multiplyMeasureByNumber(getNumOfEvidence());
-      _estimatedCounts[getMeasVecIndex(meas)]->addMeasure(tab);
     }
   }
   
@@ -155,34 +383,39 @@ void lbSuffStat::calcEmpiricalCounts() const {
   if ( _empiricalComputed && _countsInitialized )
     return; 
 
-  _lLikelihood=0;
   resetEmpiricalSuffStat();
-  lbModel& model = _infObj.getModel();
-  lbGraphStruct const& graph = model.getGraph();
-  
-  for (uint evidIndex =0;evidIndex<_evidence.size();evidIndex++) {
-    if (isVerbose(V_TEMPORARY)) {
-      cerr << "Changing evidence" << endl;
-    }
-
-    _infObj.changeEvidence(*(_evidence[evidIndex]));
-    for (cliqIndex cliq=0;cliq<_graph.getNumOfCliques();cliq++){
-      varsVec vars = graph.getVarsVecForClique(cliq);
-      measIndex meas = model.getMeasureIndexForClique(cliq);
-      if (_measSet.size() == 0 || _measSet.find(meas)!=_measSet.end()) {
-        lbAssignedMeasure_ptr assignedMeasPtr = _infObj.prob(vars,cliq);
-        lbTableMeasure<lbValue> tab((lbTableMeasure<lbLogValue> const&)assignedMeasPtr->getMeasure());
-        delete assignedMeasPtr;
-        _empirCounts[getMeasVecIndex(meas)]->addMeasure(tab);
-      }
-    }
-    _lLikelihood +=_infObj.evidenceLogProb();
+  addFullCounts();
+  int threads = numWorkers();
+  int numOfEvidence = _evidence.size();
+
+  // the first thread adds to the counts themselves, the others to their
+  // own tables which are then added in order
+  vector<measurePtrVec> counts(threads);
+  counts[0] = _empirCounts;
+  for (int t = 1; t < threads; t++) {
+    counts[t] = makeCounts();
   }
+  vector<probType> ll(threads, 0);
 
-  //cerr << "*** LL in SScalcEmpirical is " << _lLikelihood << endl;
+#pragma omp parallel for schedule(static,1) num_threads(threads)
+  for (int t = 0; t < threads; t++) {
+    ll[t] = addEvidenceCounts(getWorker(t), (long) numOfEvidence * t / threads,
+                              (long) numOfEvidence * (t + 1) / threads, &counts[t]);
+  }
 
-  _infObj.resetEvidence();
+  _inferredLikelihood = ll[0];
+  for (int t = 1; t < threads; t++) {
+    for (int i = 0; i < measureNum(); i++) {
+      _empirCounts[i]->addMeasure(*counts[t][i]);
+    }
+    _inferredLikelihood += ll[t];
+  }
+  _inferredComputed = true;
   
+  fillEmpiricalCountsVec();
+}
+
+void lbSuffStat::fillEmpiricalCountsVec() const {
   int len=_model.getSize(false,_measSet);
   for (int i=0;i<len;i++)
     _empirCountsVec[i] = 0;
@@ -194,7 +427,62 @@ void lbSuffStat::calcEmpiricalCounts() const {
 
   _countsInitialized = true;
   _empiricalComputed = true;
-  _llComputed = true;
+}
+
+void lbSuffStat::getEmpiricalCounts(probVector& counts) const {
+  calcEmpiricalCounts();
+  counts.clear();
+  for (int i=0;i<measureNum();i++) {
+    probVector values = _empirCounts[i]->measure2Vec();
+    counts.insert(counts.end(),values.begin(),values.end());
+  }
+}
+
+void lbSuffStat::setEmpiricalCounts(probVector const& counts) {
+  int index = 0;
+  for (int i=0;i<measureNum();i++)
+    index += ((lbTableMeasure<lbValue>&) *_empirCounts[i]).setValuesFromVector(&counts[0],index);
+  assert(index == (int) counts.size());
+  fillEmpiricalCountsVec();
+}
+
+void lbSuffStat::restartInference(bool resetEmpirical) {
+  resetCounts(resetEmpirical);
+  _infObj.reset(true);
+  for (uint i = 0; i < _workers.size(); i++) {
+    _workers[i]->reset(true);
+  }
+}
+
+int lbSuffStat::getNumOfRuns() const {
+  int runs = 0;
+  for (uint i = 0; i <= _workers.size(); i++) {
+    lbBeliefPropagation const* bp =
+      dynamic_cast<lbBeliefPropagation const*>(i == 0 ? &_infObj : _workers[i-1]);
+    if (bp != NULL)
+      runs += bp->getNumOfRuns();
+  }
+  return runs;
+}
+
+long lbSuffStat::getTotalMessageCount() const {
+  long messages = 0;
+  for (uint i = 0; i <= _workers.size(); i++) {
+    lbBeliefPropagation const* bp =
+      dynamic_cast<lbBeliefPropagation const*>(i == 0 ? &_infObj : _workers[i-1]);
+    if (bp != NULL)
+      messages += bp->getTotalMessageCount();
+  }
+  return messages;
+}
+
+void lbSuffStat::resetRunStatistics() {
+  for (uint i = 0; i <= _workers.size(); i++) {
+    lbBeliefPropagation* bp =
+      dynamic_cast<lbBeliefPropagation*>(i == 0 ? &_infObj : _workers[i-1]);
+    if (bp != NULL)
+      bp->resetRunStatistics();
+  }
 }
 
 void lbSuffStat::resetEstimatedSuffStat() const
@@ -248,12 +536,26 @@ void lbSuffStat::calcLogLikelihood() const
   if ( _llComputed )
     return ;
 
- _lLikelihood=0;
-  for (unsigned int evidIndex =0;evidIndex<_evidence.size();evidIndex++) {
-    _infObj.changeEvidence(*(_evidence[evidIndex]));
-    _lLikelihood +=_infObj.evidenceLogProb();
+  // only the partially observed rows need inference
+  if (!_inferredComputed) {
+    int threads = numWorkers();
+    int numOfEvidence = _evidence.size();
+    vector<probType> ll(threads, 0);
+
+#pragma omp parallel for schedule(static,1) num_threads(threads)
+    for (int t = 0; t < threads; t++) {
+      ll[t] = addEvidenceCounts(getWorker(t), (long) numOfEvidence * t / threads,
+                                (long) numOfEvidence * (t + 1) / threads, NULL);
+    }
+
+    _inferredLikelihood = 0;
+    for (int t = 0; t < threads; t++) {
+      _inferredLikelihood += ll[t];
+    }
+    _inferredComputed = true;
   }
-  _infObj.resetEvidence();
+
+  _lLikelihood = _inferredLikelihood + fullLogLikelihood();
   _llComputed = true;
 }
 
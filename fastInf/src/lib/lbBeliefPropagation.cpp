@@ -49,6 +49,8 @@ lbBeliefPropagation::lbBeliefPropagation(lbModel & model, lbMeasureDispatcher co
   _messageQueueType = MQT_WEIGHTED;
   _monitor = NULL;
   _messageBank = NULL;
+  _messageCount = 0;
+  resetRunStatistics();
 
   _maxMessages = 10000000;
   _maxSeconds = 10000;
@@ -70,6 +72,28 @@ lbBeliefPropagation::lbBeliefPropagation(lbBeliefPropagation const& otherPropaga
   NOT_IMPLEMENTED_YET;
 }
 
+lbInferenceObject* lbBeliefPropagation::duplicate() const {
+  // random messages are drawn from the global generator, which is not
+  // safe to share between threads
+  if (_messageInitType == MIT_RANDOM) {
+    return NULL;
+  }
+  lbBeliefPropagation* other = new lbBeliefPropagation(getModel(), getDispatcher());
+  other->_smoothParam = _smoothParam;
+  other->_threshold = _threshold;
+  other->_compareType = _compareType;
+  other->_messageInitType = _messageInitType;
+  other->_messageQueueType = _messageQueueType;
+  other->_ordering = _ordering;
+  other->_maxMessages = _maxMessages;
+  other->_maxSeconds = _maxSeconds;
+  other->_updateSize = _updateSize;
+  other->_WType = _WType;
+  other->_unzeroCopiedMessages = _unzeroCopiedMessages;
+  other->setInduceSpanningTrees(getInduceSpanningTrees());
+  return other;
+}
+
 void lbBeliefPropagation::setOptions(lbOptions & opt, int argc, char *argv[]) {
   int compareType = _compareType;
   int messageQueueType = _messageQueueType;
@@ -161,7 +185,8 @@ lbMessageBank * lbBeliefPropagation::getNewMessageBank() {
 
 void lbBeliefPropagation::initialize(bool allocate,bool useOldInfo) {
   lbPropagationInference::initialize(allocate);
-  resetMessages(false);
+  // a soft reset starts from the current messages
+  resetMessages(useOldInfo);
 }
 
 void lbBeliefPropagation::resetMessages(bool useOld)
@@ -499,6 +524,8 @@ bool lbBeliefPropagation::calcProbs() {
   } while (_messageBank->update());
   
   _timeEnd = clock();
+  _numOfRuns++;
+  _totalMessageCount += _messageCount;
   setCalculatedBeliefs(true);
   setFactorsUpdated(false);  
   if (_monitor != NULL) {
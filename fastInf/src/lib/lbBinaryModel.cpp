@@ -0,0 +1,244 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbBinaryModel.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace lbLib;
+
+const char lbBinaryModelReader::MAGIC[8] = { 'F', 'I', 'M', 'O', 'D', 'E', 'L', '\0' };
+const int32_t lbBinaryModelReader::VERSION = 1;
+const int32_t lbBinaryModelReader::BYTE_ORDER_MARK = 0x01020304;
+
+lbBinaryModelWriter::lbBinaryModelWriter() {
+}
+
+lbBinaryModelWriter::~lbBinaryModelWriter() {
+  if (_out.is_open()) {
+    _out.close();
+  }
+}
+
+bool lbBinaryModelWriter::open(string const& fileName) {
+  _table.clear();
+  _out.open(fileName.c_str(), ios::out | ios::binary | ios::trunc);
+  if (!_out) {
+    return false;
+  }
+  // the header is written again by close(), when the table is known
+  lbBinaryModelHeader header;
+  memset(&header, 0, sizeof(header));
+  _out.write((char const*) &header, sizeof(header));
+  return _out.good();
+}
+
+bool lbBinaryModelWriter::close() {
+  pad(sizeof(probType));
+  lbBinaryModelHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, lbBinaryModelReader::MAGIC, sizeof(header.magic));
+  header.version = lbBinaryModelReader::VERSION;
+  header.byteOrder = lbBinaryModelReader::BYTE_ORDER_MARK;
+  header.valueSize = sizeof(probType);
+  header.tableOffset = (int64_t) _out.tellp();
+  header.tableSize = _table.size();
+  if (!_table.empty()) {
+    _out.write((char const*) &_table[0], _table.size() * sizeof(probType));
+  }
+  _out.seekp(0);
+  _out.write((char const*) &header, sizeof(header));
+  bool ok = _out.good();
+  _out.close();
+  _table.clear();
+  return ok;
+}
+
+void lbBinaryModelWriter::writeInt(int val) {
+  int32_t v = val;
+  _out.write((char const*) &v, sizeof(v));
+}
+
+void lbBinaryModelWriter::writeInts(intVec const& vec) {
+  writeInt(vec.size());
+  for (uint i = 0; i < vec.size(); i++) {
+    writeInt(vec[i]);
+  }
+}
+
+void lbBinaryModelWriter::writeString(string const& str) {
+  writeInt(str.size());
+  _out.write(str.data(), str.size());
+  pad(sizeof(int32_t));
+}
+
+void lbBinaryModelWriter::writeLogValue(probType val) {
+  // zero the padding bytes of a long double, so that a model is always
+  // written to the same file
+  _table.resize(_table.size() + 1);
+  memset(&_table.back(), 0, sizeof(probType));
+  _table.back() = val;
+}
+
+void lbBinaryModelWriter::pad(int alignment) {
+  long pos = (long) _out.tellp();
+  while (pos % alignment != 0) {
+    _out.put('\0');
+    pos++;
+  }
+}
+
+lbBinaryModelReader::lbBinaryModelReader() :
+  _data(NULL),
+  _size(0),
+  _pos(0),
+  _end(0),
+  _table(NULL),
+  _tableSize(0),
+  _tablePos(0)
+{
+}
+
+lbBinaryModelReader::~lbBinaryModelReader() {
+  close();
+}
+
+bool lbBinaryModelReader::isBinaryModel(string const& fileName) {
+  ifstream in(fileName.c_str(), ios::in | ios::binary);
+  char magic[sizeof(MAGIC)];
+  if (!in.read(magic, sizeof(magic))) {
+    return false;
+  }
+  return memcmp(magic, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+bool lbBinaryModelReader::open(string const& fileName) {
+  close();
+  _fileName = fileName;
+  int fd = ::open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(lbBinaryModelHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping stays valid after the file is closed
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+  _data = (char const*) data;
+  _size = st.st_size;
+
+  lbBinaryModelHeader const* header = (lbBinaryModelHeader const*) _data;
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    close();
+    return false;
+  }
+  if (header->byteOrder != BYTE_ORDER_MARK || header->valueSize != sizeof(probType)) {
+    cerr << "Error: " << fileName << " was written on a machine of another byte order or probType" << endl;
+    close();
+    return false;
+  }
+  if (header->version != VERSION) {
+    cerr << "Error: " << fileName << " is a binary model of version " << header->version
+	 << ", expected version " << VERSION << endl;
+    close();
+    return false;
+  }
+  if (header->tableOffset < (int64_t) sizeof(lbBinaryModelHeader) ||
+      header->tableOffset % sizeof(probType) != 0 || header->tableSize < 0 ||
+      (size_t) header->tableOffset + header->tableSize * sizeof(probType) > _size) {
+    corrupted();
+  }
+  _pos = sizeof(lbBinaryModelHeader);
+  _end = header->tableOffset;
+  _table = (probType const*) (_data + header->tableOffset);
+  _tableSize = header->tableSize;
+  _tablePos = 0;
+  return true;
+}
+
+void lbBinaryModelReader::close() {
+  if (_data) {
+    munmap((void*) _data, _size);
+  }
+  _data = NULL;
+  _size = 0;
+  _table = NULL;
+}
+
+int lbBinaryModelReader::readInt() {
+  return *(int32_t const*) take(sizeof(int32_t));
+}
+
+int const* lbBinaryModelReader::readInts(int count) {
+  if (count < 0) {
+    corrupted();
+  }
+  return (int const*) take(count * sizeof(int32_t));
+}
+
+intVec lbBinaryModelReader::readIntVec() {
+  int size = readInt();
+  int const* vals = readInts(size);
+  return intVec(vector<int>(vals, vals + size));
+}
+
+string lbBinaryModelReader::readString() {
+  int size = readInt();
+  if (size < 0) {
+    corrupted();
+  }
+  char const* chars = take(size);
+  string res(chars, size);
+  // skip the padding
+  take((sizeof(int32_t) - size % sizeof(int32_t)) % sizeof(int32_t));
+  return res;
+}
+
+probType const* lbBinaryModelReader::readLogValues(int count) {
+  if (count < 0 || _tablePos + count > _tableSize) {
+    corrupted();
+  }
+  probType const* res = _table + _tablePos;
+  _tablePos += count;
+  return res;
+}
+
+char const* lbBinaryModelReader::take(size_t bytes) {
+  if (_pos + bytes > _end) {
+    corrupted();
+  }
+  char const* res = _data + _pos;
+  _pos += bytes;
+  return res;
+}
+
+void lbBinaryModelReader::corrupted() const {
+  cerr << "Error, binary model " << _fileName << " is corrupted" << endl;
+  exit(1);
+}
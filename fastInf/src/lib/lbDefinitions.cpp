@@ -19,6 +19,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <lbDefinitions.h>
+#include <sys/time.h>
 
 using namespace lbLib ;
 
@@ -60,3 +61,9 @@ const probType lbDefinitions::TINY = 1e-7;
 const probType lbDefinitions::SMALL = 1e-4;
 
 probType lbDefinitions::PARAM_EPSILON = 1e-10;
+
+double lbLib::wallTime() {
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return now.tv_sec + now.tv_usec * 1e-6;
+}
@@ -20,6 +20,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 
 
 #include <lbDriver.h>
+#include <lbBinaryModel.h>
 
 using namespace lbLib;
 
@@ -125,6 +126,10 @@ bool lbDriver::readExact(ifstream_ptr in, lbModel *model) {
 bool lbDriver::readUniverse(string inputFileName, bool readLogValues) {
   //  cout<<"reading univ"<<endl;
   //open in stream
+  if (lbBinaryModelReader::isBinaryModel(inputFileName)) {
+    return readBinaryUniverse(inputFileName);
+  }
+
   char_ptr buffer(new char[lbDefinitions::MAX_BUF_SIZE]);
   ifstream_ptr in(new ifstream(inputFileName.c_str()));
 
@@ -219,6 +224,146 @@ bool lbDriver::readUniverse(string inputFileName, bool readLogValues) {
   return true;
 }
 
+static varsVec readVars(lbBinaryModelReader& in) {
+  int size = in.readInt();
+  int const* vals = in.readInts(size);
+  varsVec vars;
+  for (int i = 0; i < size; i++) {
+    vars.push_back(vals[i]);
+  }
+  return vars;
+}
+
+static void writeVars(lbBinaryModelWriter& out, varsVec const& vars) {
+  out.writeInt(vars.size());
+  for (uint i = 0; i < vars.size(); i++) {
+    out.writeInt(vars[i]);
+  }
+}
+
+//reads the sections of a binary model in the order written by
+//writeBinaryUniverse, building the model as readUniverse does
+bool lbDriver::readBinaryUniverse(string inputFileName) {
+  lbBinaryModelReader in;
+  if (!in.open(inputFileName))
+    return false;
+
+  int numOfVars = in.readInt();
+  vector<string> varsVector(numOfVars);
+  cardVec varsCards(numOfVars);
+  for (int var = 0; var < numOfVars; var++) {
+    varsVector[var] = in.readString();
+    varsCards[var] = in.readInt();
+  }
+  _vars = lbVarsList_ptr(new lbVarsList());
+  _vars->addVarList(varsVector);
+  _cards = lbCardsList_ptr(new lbCardsList(*_vars));
+  _cards->setCardsForAllVars(varsCards);
+  _graph = lbGraphStruct_ptr(new lbGraphStruct(*_vars));
+  _model = lbModel_ptr(new lbModel(*_graph,*_cards,_measDisp));
+
+  int numOfCliques = in.readInt();
+  vector<cliquesVec> neighbors(numOfCliques);
+  vector<separatorsVec> separators(numOfCliques);
+  for (int cliq = 0; cliq < numOfCliques; cliq++) {
+    _graph->addClique(readVars(in));
+    int numOfNeighbors = in.readInt();
+    for (int i = 0; i < numOfNeighbors; i++) {
+      neighbors[cliq].push_back(in.readInt());
+      separators[cliq].push_back(readVars(in));
+    }
+  }
+  // the lists are kept as they were written (with their order), once
+  // all the cliques exist
+  for (int cliq = 0; cliq < numOfCliques; cliq++) {
+    if (!_graph->setCliqueNeighborsList(cliq, neighbors[cliq], separators[cliq])) {
+      cerr << "illegal input - failed reading cliques" << endl;
+      return false;
+    }
+  }
+
+  int numOfMeasures = in.readInt();
+  for (int meas = 0; meas < numOfMeasures; meas++) {
+    string mesName = in.readString();
+    lbMeasure_Sptr measPtr = _measDisp.getNewMeasure();
+    measPtr->readOneMeasureBinary(in);
+    _model->addMeasure(measPtr,mesName);
+  }
+
+  for (int cliq = 0; cliq < numOfCliques; cliq++) {
+    int meas = in.readInt();
+    if (meas >= 0)
+      _model->setMeasureForClique(cliq,meas);
+  }
+
+  intVec directed = in.readIntVec();
+  for (uint i = 0; i < directed.size(); i++) {
+    _model->makeMeasureDirected(directed[i]);
+  }
+
+  int numOfExact = in.readInt();
+  if (numOfExact > 0) {
+    assignedMesVec amv;
+    for (int i = 0; i < numOfExact; i++) {
+      varsVec vars = readVars(in);
+      lbMeasure_Sptr measPtr = _measDisp.getNewMeasure();
+      measPtr->readOneMeasureBinary(in);
+      amv.push_back(new lbAssignedMeasure(measPtr, vars));
+    }
+    _model->setExactBeliefs(amv);
+  }
+  return true;
+}
+
+bool lbDriver::writeBinaryUniverse(lbModel const& model, string outputFileName) {
+  lbBinaryModelWriter out;
+  if (!out.open(outputFileName))
+    return false;
+
+  lbCardsList const& cards = model.getCards();
+  lbVarsList const& vars = cards.getVarsList();
+  out.writeInt(vars.getNumOfVars());
+  for (rVarIndex var = 0; var < vars.getNumOfVars(); var++) {
+    out.writeString(vars.getNameOfVar(var));
+    out.writeInt(cards.getCardForVar(var));
+  }
+
+  lbGraphStruct const& graph = model.getGraph();
+  out.writeInt(graph.getNumOfCliques());
+  for (cliqIndex cliq = 0; cliq < graph.getNumOfCliques(); cliq++) {
+    writeVars(out, graph.getVarsVecForClique(cliq));
+    cliquesVec const& neighbors = graph.cliqueNeighbors(cliq);
+    separatorsVec const& separators = graph.cliqueNeighborSeparators(cliq);
+    out.writeInt(neighbors.size());
+    for (uint i = 0; i < neighbors.size(); i++) {
+      out.writeInt(neighbors[i]);
+      writeVars(out, separators[i]);
+    }
+  }
+
+  intVec directed;
+  out.writeInt(model.getNumOfMeasures());
+  for (measIndex meas = 0; meas < model.getNumOfMeasures(); meas++) {
+    out.writeString(model.getMeasureName(meas));
+    model.getMeasure(meas).writeBinary(out);
+    if (model.getMeasure(meas).isDirected())
+      directed.push_back(meas);
+  }
+
+  for (cliqIndex cliq = 0; cliq < graph.getNumOfCliques(); cliq++) {
+    out.writeInt(model.isMeasureAssignedForClique(cliq) ? (int) model.getMeasureIndexForClique(cliq) : -1);
+  }
+  out.writeInts(directed);
+
+  assignedMesVec const& exact = model.getExactBeliefs();
+  out.writeInt(exact.size());
+  for (uint i = 0; i < exact.size(); i++) {
+    writeVars(out, exact[i]->getVars());
+    exact[i]->getMeasure().writeBinary(out);
+  }
+  return out.close();
+}
+
 void lbDriver::exitDriver(string msg) {
   cerr << msg << endl;
   
@@ -0,0 +1,194 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbEngineSelector.h>
+#include <queue>
+
+using namespace lbLib;
+
+// Cost of a junction tree entry relative to a loopy BP message entry,
+// measured on the grid inputs: it covers the collect and distribute
+// passes, the beliefs, and the slower iteration over large cliques
+static const realVal EXACT_ENTRY_COST = 15;
+
+// sweeps of asynchronous BP on a junction tree
+static const realVal TREE_BP_SWEEPS = 2;
+
+// sweeps of loopy BP = base + per average number of cliques a variable is in
+static const realVal LOOPY_BASE_SWEEPS = 10;
+static const realVal LOOPY_SWEEPS_PER_DEGREE = 5;
+
+lbEngineSelector::lbEngineSelector(lbModel const& model, lbEngineAccuracy accuracy) :
+  _model(model),
+  _accuracy(accuracy),
+  _exactCost(HUGE_VAL),
+  _jtWeight(HUGE_VAL),
+  _treewidth(-1),
+  _exactFeasible(false),
+  _bpCost(HUGE_VAL),
+  _bpSweeps(0),
+  _isJunctionTree(false),
+  _choice(ET_LOOPY_BP)
+{
+  estimateExactCost();
+  estimateBPCost();
+}
+
+void lbEngineSelector::estimateExactCost() {
+  _jtWeight = lbJunctionTree::EstimateJunctionTreeWeight(&_model, lbJunctionTree::eMinFill, &_treewidth);
+  _exactFeasible = (_jtWeight <= lbJunctionTree::MaxLog10CliquesWeight());
+  _exactCost = _jtWeight + log10(EXACT_ENTRY_COST);
+}
+
+void lbEngineSelector::estimateBPCost() {
+  lbGraphStruct const& graph = _model.getGraph();
+  int numVars = graph.getNumOfVars();
+  int numCliques = graph.getNumOfCliques();
+
+  // Every message out of a clique marginalizes its table
+  realVal sweepCost = 0;
+  for (cliqIndex cliq = 0; cliq < numCliques; cliq++) {
+    varsVec const& vars = graph.getVarsVecForClique(cliq);
+    realVal size = 1;
+    for (uint i = 0; i < vars.size(); i++) {
+      size *= _model.getCards().getCardForVar(vars[i]);
+    }
+    sweepCost += size * max((int) graph.cliqueNeighbors(cliq).size(), 1);
+  }
+
+  _isJunctionTree = graphIsJunctionTree();
+  if (_isJunctionTree) {
+    _bpSweeps = TREE_BP_SWEEPS;
+  }
+  else {
+    realVal memberships = 0;
+    for (rVarIndex var = 0; var < numVars; var++) {
+      memberships += graph.getAllCliquesForVar(var).size();
+    }
+    _bpSweeps = LOOPY_BASE_SWEEPS + LOOPY_SWEEPS_PER_DEGREE * memberships / max(numVars, 1);
+  }
+
+  _bpCost = log10(sweepCost * _bpSweeps);
+}
+
+bool lbEngineSelector::graphIsJunctionTree() const {
+  lbGraphStruct const& graph = _model.getGraph();
+  int numCliques = graph.getNumOfCliques();
+
+  // The clique graph has to be a forest...
+  int edges = 0;
+  int components = 0;
+  boolVec visited(numCliques, false);
+  for (cliqIndex start = 0; start < numCliques; start++) {
+    edges += graph.cliqueNeighbors(start).size();
+    if (visited[start]) {
+      continue;
+    }
+
+    components++;
+    queue<cliqIndex> q;
+    q.push(start);
+    visited[start] = true;
+    while (!q.empty()) {
+      cliquesVec const& neighbors = graph.cliqueNeighbors(q.front());
+      q.pop();
+      for (uint j = 0; j < neighbors.size(); j++) {
+	if (!visited[neighbors[j]]) {
+	  visited[neighbors[j]] = true;
+	  q.push(neighbors[j]);
+	}
+      }
+    }
+  }
+  if (edges / 2 != numCliques - components) {
+    return false;
+  }
+
+  // ...with the running intersection property
+  for (rVarIndex var = 0; var < graph.getNumOfVars(); var++) {
+    if (!graph.runningIntersectionSatisfied(var)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+lbEngineType lbEngineSelector::select() {
+  if (_accuracy == EA_EXACT) {
+    if (_isJunctionTree && (!_exactFeasible || _bpCost <= _exactCost)) {
+      _choice = ET_LOOPY_BP;
+      _reason = "clique graph is a junction tree so BP is exact";
+    }
+    else if (_exactFeasible) {
+      _choice = ET_EXACT;
+      _reason = "exact answers required";
+    }
+    else {
+      _choice = ET_LOOPY_BP;
+      _reason = "exact answers required but the junction tree is too large, falling back to loopy BP";
+    }
+  }
+  else {
+    if (_exactFeasible && _exactCost < _bpCost) {
+      _choice = ET_EXACT;
+      _reason = "junction tree is cheaper than loopy BP";
+    }
+    else {
+      _choice = ET_LOOPY_BP;
+      _reason = (_exactFeasible ? "loopy BP is cheaper than the junction tree" :
+		 "junction tree is too large");
+    }
+  }
+  return _choice;
+}
+
+void lbEngineSelector::print(ostream& out) const {
+  out << "Engine selection (" << (_accuracy == EA_EXACT ? "exact" : "approx") << "):" << endl;
+  out << "  treewidth: " << _treewidth
+      << " JT state space: 10^(" << _jtWeight << ")"
+      << (_exactFeasible ? "" : " [infeasible]") << endl;
+  out << "  predicted cost: exact 10^(" << _exactCost << ") loopy BP 10^(" << _bpCost
+      << ") [" << _bpSweeps << " sweeps" << (_isJunctionTree ? ", junction tree" : "") << "]" << endl;
+  out << "  chosen: " << getEngineName(_choice) << " (" << _reason << ")" << endl;
+}
+
+string lbEngineSelector::getEngineName(lbEngineType engine) {
+  switch (engine) {
+  case ET_EXACT:
+    return "exact";
+  case ET_LOOPY_BP:
+    return "loopy BP";
+  default:
+    NOT_REACHED;
+  }
+  return "";
+}
+
+bool lbEngineSelector::readAccuracy(string const& str, lbEngineAccuracy& accuracy) {
+  if (str == "exact") {
+    accuracy = EA_EXACT;
+    return true;
+  }
+  if (str == "approx") {
+    accuracy = EA_APPROX;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,350 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbEvidenceMatrix.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace lbLib;
+
+// bytes read from a file at a time
+static const size_t BLOCK_SIZE = 1 << 20;
+// a block is split between threads only if each gets this many bytes
+static const size_t MIN_THREAD_BYTES = 1 << 16;
+
+static inline bool isSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+lbEvidenceMatrix::lbEvidenceMatrix(cardVec const& cards) :
+  _numOfVars(cards.size()),
+  _cards(cards),
+  _wide(false),
+  _numOfLines(0)
+{
+  for (int var = 0; var < _numOfVars; var++) {
+    if (_cards[var] > 32768) {
+      cerr << "Error: variable " << var << " has more values than evidence can hold" << endl;
+      exit(1);
+    }
+    if (_cards[var] > 128) {
+      _wide = true;
+    }
+  }
+}
+
+void lbEvidenceMatrix::clear() {
+  _values8.clear();
+  _values16.clear();
+  _weights.clear();
+  _numOfLines = 0;
+  _badLines.clear();
+}
+
+bool lbEvidenceMatrix::readFile(string const& fileName, int threads) {
+  FILE* file = fopen(fileName.c_str(), "rb");
+  if (file == NULL) {
+    return false;
+  }
+#ifdef _OPENMP
+  threads = ( threads > 0 ? threads : omp_get_max_threads() );
+#else
+  threads = 1;
+#endif
+
+  // parse every block up to its last line break and carry the rest of
+  // it (a partial line) to the next block
+  vector<char> buffer;
+  size_t used = 0;
+  bool done = false;
+  while (!done) {
+    buffer.resize(used + BLOCK_SIZE);
+    size_t got = fread(&buffer[used], 1, BLOCK_SIZE, file);
+    used += got;
+    done = (got < BLOCK_SIZE);
+    size_t end = used;
+    if (!done) {
+      while (end > 0 && buffer[end-1] != '\n') {
+	end--;
+      }
+    }
+    if (end > 0) {
+      parseBlock(&buffer[0], &buffer[0] + end, threads);
+      memmove(&buffer[0], &buffer[0] + end, used - end);
+      used -= end;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+int lbEvidenceMatrix::readStream(istream& in, int maxRows) {
+  int rows = 0;
+  string line;
+  while ((maxRows <= 0 || rows < maxRows) && getline(in, line)) {
+    _numOfLines++;
+    int res = parseLine(line.data(), line.data() + line.size());
+    if (res > 0) {
+      rows++;
+    }
+    else if (res < 0) {
+      _badLines.push_back(_numOfLines);
+    }
+  }
+  return rows;
+}
+
+void lbEvidenceMatrix::parseBlock(char const* begin, char const* end, int threads) {
+  size_t bytes = end - begin;
+  if (threads > (int) (bytes / MIN_THREAD_BYTES)) {
+    threads = bytes / MIN_THREAD_BYTES;
+  }
+  if (threads <= 1) {
+    parseLines(begin, end);
+    return;
+  }
+
+  // every part ends after a line break
+  vector<char const*> bounds(threads + 1, end);
+  bounds[0] = begin;
+  for (int t = 1; t < threads; t++) {
+    char const* p = begin + bytes * t / threads;
+    if (p < bounds[t-1]) {
+      p = bounds[t-1];
+    }
+    char const* eol = (char const*) memchr(p, '\n', end - p);
+    bounds[t] = (eol == NULL ? end : eol + 1);
+  }
+  vector<lbEvidenceMatrix> parts(threads, lbEvidenceMatrix(_cards));
+#pragma omp parallel for schedule(static) num_threads(threads)
+  for (int t = 0; t < threads; t++) {
+    parts[t].parseLines(bounds[t], bounds[t+1]);
+  }
+  for (int t = 0; t < threads; t++) {
+    append(parts[t]);
+  }
+}
+
+void lbEvidenceMatrix::parseLines(char const* begin, char const* end) {
+  char const* p = begin;
+  while (p < end) {
+    char const* eol = (char const*) memchr(p, '\n', end - p);
+    if (eol == NULL) {
+      eol = end;
+    }
+    _numOfLines++;
+    if (parseLine(p, eol) < 0) {
+      _badLines.push_back(_numOfLines);
+    }
+    p = eol + 1;
+  }
+}
+
+int lbEvidenceMatrix::parseLine(char const* p, char const* end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  if (p == end) {
+    return 0;
+  }
+  if (*p != '(') {
+    return -1;
+  }
+  p++;
+
+  // variables missing at the end of the row are not observed
+  long base = (long) _weights.size() * _numOfVars;
+  resizeValues(base + _numOfVars);
+  for (int var = 0; var < _numOfVars; var++) {
+    setValue(base + var, -1);
+  }
+  int var = 0;
+  bool closed = false;
+  while (p < end) {
+    if (isSpace(*p)) {
+      p++;
+      continue;
+    }
+    if (*p == ')') {
+      p++;
+      closed = true;
+      break;
+    }
+    if (var == _numOfVars) {
+      break;
+    }
+    if (*p == '?') {
+      p++;
+    }
+    else {
+      if (*p < '0' || *p > '9') {
+	break;
+      }
+      int value = 0;
+      while (p < end && *p >= '0' && *p <= '9' && value < _cards[var]) {
+	value = value * 10 + (*p - '0');
+	p++;
+      }
+      if (value >= _cards[var]) {
+	break;
+      }
+      setValue(base + var, value);
+    }
+    if (p < end && !isSpace(*p) && *p != ')') {
+      break;
+    }
+    var++;
+  }
+
+  // an optional weight follows the assignment
+  probType weight = 1;
+  while (closed && p < end && isSpace(*p)) {
+    p++;
+  }
+  if (closed && p < end) {
+    char number[64];
+    size_t len = 0;
+    while (p < end && !isSpace(*p) && len < sizeof(number) - 1) {
+      number[len++] = *p++;
+    }
+    number[len] = '\0';
+    char* numberEnd;
+    weight = strtod(number, &numberEnd);
+    if (numberEnd != number + len) {
+      closed = false;
+    }
+    while (p < end && isSpace(*p)) {
+      p++;
+    }
+  }
+  if (!closed || p != end || !(weight > 0)) {
+    resizeValues(base);
+    return -1;
+  }
+  _weights.push_back(weight);
+  return 1;
+}
+
+void lbEvidenceMatrix::append(lbEvidenceMatrix const& other) {
+  _values8.insert(_values8.end(), other._values8.begin(), other._values8.end());
+  _values16.insert(_values16.end(), other._values16.begin(), other._values16.end());
+  _weights.insert(_weights.end(), other._weights.begin(), other._weights.end());
+  for (uint i = 0; i < other._badLines.size(); i++) {
+    _badLines.push_back(_numOfLines + other._badLines[i]);
+  }
+  _numOfLines += other._numOfLines;
+}
+
+void lbEvidenceMatrix::resizeValues(long size) {
+  if (_wide) {
+    _values16.resize(size);
+  }
+  else {
+    _values8.resize(size);
+  }
+}
+
+void lbEvidenceMatrix::getRow(int row, int* values) const {
+  getRows(row, row + 1, values);
+}
+
+void lbEvidenceMatrix::getRows(int begin, int end, int* values) const {
+  long first = (long) begin * _numOfVars;
+  long last = (long) end * _numOfVars;
+  if (_wide) {
+    for (long i = first; i < last; i++) {
+      *values++ = _values16[i];
+    }
+  }
+  else {
+    for (long i = first; i < last; i++) {
+      *values++ = _values8[i];
+    }
+  }
+}
+
+void lbEvidenceMatrix::appendRow(lbEvidenceMatrix const& other, int row, probType weight) {
+  assert(other._numOfVars == _numOfVars && other._wide == _wide);
+  long base = (long) _weights.size() * _numOfVars;
+  resizeValues(base + _numOfVars);
+  if (_numOfVars > 0) {
+    memcpy(_wide ? (char*) &_values16[base] : (char*) &_values8[base],
+	   other.rowData(row), _numOfVars * getValueSize());
+  }
+  _weights.push_back(weight);
+}
+
+void lbEvidenceMatrix::findDistinctRows(intVec& distinct, intVec& rowOf) const {
+  int numOfRows = getNumOfRows();
+  size_t bytes = _numOfVars * getValueSize();
+  distinct.clear();
+  rowOf = intVec(numOfRows);
+
+  // open addressing over the distinct rows, at most half full
+  size_t size = 2;
+  while (size < 2 * (size_t) numOfRows) {
+    size *= 2;
+  }
+  intVec table(size, -1);
+  for (int r = 0; r < numOfRows; r++) {
+    // FNV-1a of the packed values
+    unsigned long hash = 2166136261UL;
+    unsigned char const* data = (unsigned char const*) (bytes > 0 ? rowData(r) : NULL);
+    for (size_t i = 0; i < bytes; i++) {
+      hash = (hash ^ data[i]) * 16777619UL;
+    }
+    size_t slot = hash & (size - 1);
+    while (table[slot] >= 0 &&
+	   (bytes > 0 && memcmp(rowData(distinct[table[slot]]), data, bytes) != 0)) {
+      slot = (slot + 1) & (size - 1);
+    }
+    if (table[slot] < 0) {
+      table[slot] = distinct.size();
+      distinct.push_back(r);
+    }
+    rowOf[r] = table[slot];
+  }
+}
+
+bool lbEvidenceMatrix::isFullyObserved(int row) const {
+  for (int var = 0; var < _numOfVars; var++) {
+    if (getValue(row, var) < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+lbFullAssignment_ptr lbEvidenceMatrix::makeAssignment(int row) const {
+  lbFullAssignment_ptr assign = new lbFullAssignment();
+  for (int var = 0; var < _numOfVars; var++) {
+    int value = getValue(row, var);
+    if (value < 0) {
+      assign->UnsetValueForVar(var);
+    }
+    else {
+      assign->setValueForVar(var, value);
+    }
+  }
+  return assign;
+}
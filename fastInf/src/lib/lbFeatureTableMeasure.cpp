@@ -148,29 +148,37 @@ int lbFeatureTableMeasure::calcDeriv(probType* res,int index,
     exit(1);
   }
   
-  lbTableMeasure<lbValue> temp((lbTableMeasure<lbValue> const &)Estimated);
-
-  if ( isDirected() ) {
-    temp.normalizeDirected();
-    temp.multiplyByConditionalSumOfMeasure((lbTableMeasure<lbValue> const&)Empirical);
-  }
-  temp.subtractMeasure((lbTableMeasure<lbValue> const&)Empirical);
-  
-  //
   uint p;
   for (p = 0; p < _params.size() ; p++ )
     res[index+p] = 0.0;
+
+  lbTableMeasure<lbValue> const& estimated = (lbTableMeasure<lbValue> const &)Estimated;
+  lbTableMeasure<lbValue> const& empirical = (lbTableMeasure<lbValue> const&)Empirical;
+  if ( !isDirected() ) {
+    // collect the difference of the counts of all cells in place (this
+    // already takes care of sharing)
+    int ind = 0;
+    for ( uint i = 0; i<estimated.getPrimarySize() ; i++ )
+      for ( uint j = 0; j<estimated.getSecondarySize() ; j++,ind++ ) {
+	probType diff = (*estimated.getValues())[i][j].getValue() - (*empirical.getValues())[i][j].getValue();
+	if ( diff != 0.0 )
+	  res[_paramIndices[ind][0]+index] += diff;
+      }
+    return _params.size();
+  }
+
+  lbTableMeasure<lbValue> temp(estimated);
+  temp.normalizeDirected();
+  temp.multiplyByConditionalSumOfMeasure(empirical);
+  temp.subtractMeasure(empirical);
   
   // collect from all cells in the table (this already takes care of sharing)
   int ind = 0;
-  vector<int> paramCount(_params.size(),0);
   for ( uint i = 0; i<temp.getPrimarySize() ; i++ )
     for ( uint j = 0; j<temp.getSecondarySize() ; j++,ind++ ) {
       int pind = _paramIndices[ind][0];
-      if ( (*temp.getValues())[i][j].getValue() != 0.0 ) {
+      if ( (*temp.getValues())[i][j].getValue() != 0.0 )
 	res[pind+index] +=  (*temp.getValues())[i][j].getValue();
-        paramCount[pind]++;
-      }
     }
   
   return _params.size();
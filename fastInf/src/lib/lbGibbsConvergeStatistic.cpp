@@ -0,0 +1,180 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbGibbsConvergeStatistic.h>
+
+using namespace lbLib;
+
+lbGibbsConvergeStatistic::lbGibbsConvergeStatistic (safeVec<lbAssignment_ptr> const& assignsVec,
+						    lbModel const& model,
+						    double convergeThresh)
+  : _model_(model),
+    _numOfSamples_(0),
+    _convergenceThreshold_(convergeThresh)
+{
+  initialize (assignsVec.size()) ;
+  updateStats (assignsVec) ; // read initial assignments
+}
+
+lbGibbsConvergeStatistic::lbGibbsConvergeStatistic (vector<intVec> const& valuesVec,
+						    lbModel const& model,
+						    double convergeThresh)
+  : _model_(model),
+    _numOfSamples_(0),
+    _convergenceThreshold_(convergeThresh)
+{
+  initialize (valuesVec.size()) ;
+  updateStats (valuesVec) ; // read initial assignments
+}
+
+void lbGibbsConvergeStatistic::initialize (int numOfChains) {
+  _numOfChains_ = numOfChains ;
+
+  int numOfMeasures = _model_.getNumOfMeasures() ;
+  _measOffset = intVec (numOfMeasures+1,0) ;
+  for (int meas=0 ; meas<numOfMeasures ; ++meas) {
+    _measOffset[meas+1] = _measOffset[meas] + _model_.getMeasure(meas).getSize() ;
+  }
+  _numOfStatistics_ = _measOffset[numOfMeasures] ;
+
+  int numOfCliques = _model_.getGraph().getNumOfCliques() ;
+  _cliqOffset = intVec (numOfCliques) ;
+  _cliqBegin = intVec (numOfCliques+1,0) ;
+  _cliqVars.clear() ;
+  _cliqStrides.clear() ;
+  for (int cliq=0 ; cliq<numOfCliques ; ++cliq) {
+    _cliqOffset[cliq] = _measOffset[_model_.getMeasureIndexForClique(cliq)] ;
+    varsVec const& vars = _model_.getAssignedMeasureForClique(cliq).getVars() ;
+    int stride = 1 ;
+    _cliqVars.resize (_cliqBegin[cliq]+vars.size()) ;
+    _cliqStrides.resize (_cliqBegin[cliq]+vars.size()) ;
+    for (int k=vars.size()-1 ; k>=0 ; --k) {
+      _cliqVars[_cliqBegin[cliq]+k] = vars[k] ;
+      _cliqStrides[_cliqBegin[cliq]+k] = stride ;
+      stride *= _model_.getCards().getCardForVar(vars[k]) ;
+    }
+    _cliqBegin[cliq+1] = _cliqBegin[cliq] + vars.size() ;
+  }
+
+  _sum      = vector<double> (_numOfStatistics_*_numOfChains_,0.0) ;
+  _sum2     = vector<double> (_numOfStatistics_*_numOfChains_,0.0) ;
+  _totalSum = vector<double> (_numOfStatistics_,0.0) ;
+  _counts   = intVec (_numOfStatistics_,0) ;
+  _touched.reserve (numOfCliques) ;
+}
+
+void lbGibbsConvergeStatistic::setMeasures (measIndicesVec const& measures) {
+  _checked.clear() ;
+  for (uint i=0 ; i<measures.size() ; ++i) {
+    for (int stat=_measOffset[measures[i]] ; stat<_measOffset[(int)measures[i]+1] ; ++stat) {
+      _checked.push_back(stat) ;
+    }
+  }
+}
+
+void lbGibbsConvergeStatistic::updateStats (safeVec<lbAssignment_ptr> const& assignsVec) {
+  assert (_numOfChains_ == (int)assignsVec.size()) ;
+  _numOfSamples_++ ;
+  for (int chain=0 ; chain<_numOfChains_ ; ++chain) {
+    addChain (chain,assignsVec[chain]) ;
+  }
+}
+
+void lbGibbsConvergeStatistic::updateStats (vector<intVec> const& valuesVec) {
+  assert (_numOfChains_ == (int)valuesVec.size()) ;
+  _numOfSamples_++ ;
+  for (int chain=0 ; chain<_numOfChains_ ; ++chain) {
+    addChain (chain,valuesVec[chain]) ;
+  }
+}
+
+bool lbGibbsConvergeStatistic::statConverged (int stat) const {
+  // Taken from "Markov Chain Monte Carlo In Practice"/ Gilks, Richardson and Spiegelhalter (1996), p. 137.
+  // Gelman and Rubin 1992.
+
+  // if we had a single statistic to compute over m chains and n samples in each chain
+  // with average mu, chain average mu_i, chain sum S_i, and chain square sum S2_i:
+  //
+  // B = n/(m-1) * sum_i (mu_i - mu)^2
+  // W = 1/(m*(n-1)) * sum_i [S2_i - 2*mu_i*S_i + n*mu_i^2]
+  // R = (n-1)/n * W + 1/n * B
+  //
+  // and we check whether R is close to 1.0
+
+  double totalMu = _totalSum[stat] / (_numOfChains_*_numOfSamples_) ;
+
+  double B = 0 ;
+  double W = 0 ;
+  for (int i=0 ; i<_numOfChains_ ; ++i) {
+    double mu = sum(stat,i) / _numOfSamples_ ;
+    B += (mu-totalMu)*(mu-totalMu) ;
+    W += (sum2(stat,i) - 2*mu*sum(stat,i) + _numOfSamples_*mu*mu) ;
+  }
+  B *= (double) _numOfSamples_/(_numOfChains_-1) ;
+  W *= 1.0/(_numOfChains_*(_numOfSamples_-1)) ;
+
+  double estimVar = (double)(_numOfSamples_-1)/_numOfSamples_ * W + 1.0/_numOfSamples_ * B ;
+
+  double R = estimVar/W ;
+
+  return !(R > _convergenceThreshold_) ;
+}
+
+bool lbGibbsConvergeStatistic::didConverge() const {
+  if (_checked.empty()) {
+    for (int stat=0 ; stat<_numOfStatistics_ ; ++stat) {
+      if (!statConverged(stat)) {
+	return false ; // no need to check other statistics
+      }
+    }
+    return true ;
+  }
+
+  for (uint i=0 ; i<_checked.size() ; ++i) {
+    if (!statConverged(_checked[i])) {
+      return false ;
+    }
+  }
+  return true ;
+}
+
+void lbGibbsConvergeStatistic::printStats (ostream & out) const {
+  out << "Printing statistics of convergence tester:\n" ;
+  out << " Number of chains: " << _numOfChains_ << "\n" ;
+  out << " Number of samples: " << _numOfSamples_ << "\n" ;
+  out << " Number of statistics: " << _numOfStatistics_ << "\n" ;
+  out << " totalSum: (" << vec2str(_totalSum,",") << ")\n" ;
+  out << " sums:\n" ;
+  for (int s=0 ; s<_numOfStatistics_ ; ++s) {
+    out << "  sum["<<s<<"] = (" ;
+    for (int i=0 ; i<_numOfChains_ ; ++i) {
+      out << (i>0 ? "," : "") << sum(s,i) ;
+    }
+    out << ")\n" ;
+  }
+  out << " sums2:\n" ;
+  for (int s=0 ; s<_numOfStatistics_ ; ++s) {
+    out << "  sum2["<<s<<"] = (" ;
+    for (int i=0 ; i<_numOfChains_ ; ++i) {
+      out << (i>0 ? "," : "") << sum2(s,i) ;
+    }
+    out << ")\n" ;
+  }
+}
@@ -0,0 +1,183 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbGibbsInference.h>
+#include <iomanip>
+
+using namespace lbLib;
+
+lbGibbsInference::lbGibbsInference(lbModel const& model, int numOfChains, unsigned long seed) :
+  _model(model),
+  _sampler(model, numOfChains, seed),
+  _numOfVars(model.getGraph().getNumOfVars()),
+  _numOfChains(numOfChains),
+  _offsets(_numOfVars + 1, 0),
+  _sums(numOfChains),
+  _numOfSamples(0),
+  _burnIn(0.2),
+  _raoBlackwell(true)
+{
+  _sampler.setScan(lbGibbsSampler::GS_CHROMATIC);
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _offsets[(int) var + 1] = _offsets[var] + model.getCards().getCardForVar(var);
+  }
+  clearSamples();
+}
+
+void lbGibbsInference::clearSamples() {
+  for (int chain = 0; chain < _numOfChains; chain++) {
+    _sums[chain].assign(_offsets[_numOfVars], 0);
+  }
+  _numOfSamples = 0;
+}
+
+void lbGibbsInference::changeEvidence(lbAssignment const& assign) {
+  _sampler.setEvidence(assign);
+  clearSamples();
+}
+
+void lbGibbsInference::resetEvidence() {
+  _sampler.resetEvidence();
+  clearSamples();
+}
+
+void lbGibbsInference::addSamples() {
+#pragma omp parallel for schedule(static)
+  for (int chain = 0; chain < _numOfChains; chain++) {
+    probType* sums = &_sums[chain][0];
+    for (rVarIndex var = 0; var < _numOfVars; var++) {
+      probType* sum = sums + _offsets[var];
+      if (_raoBlackwell && !_sampler.isObserved(var)) {
+	int card = _offsets[(int) var + 1] - _offsets[var];
+	probType stackDist[lbGibbsSampler::MAX_STACK_CARD];
+	probVector heapDist;
+	probType* dist = stackDist;
+	if (card > lbGibbsSampler::MAX_STACK_CARD) {
+	  heapDist.resize(card);
+	  dist = &heapDist[0];
+	}
+	_sampler.getConditional(chain, var, dist);
+	for (int val = 0; val < card; val++) {
+	  sum[val] += dist[val];
+	}
+      }
+      else {
+	sum[_sampler.getValue(chain, var)] += 1;
+      }
+    }
+  }
+  _numOfSamples++;
+}
+
+int lbGibbsInference::run(double seconds) {
+  clearSamples();
+  int sweep = _numOfVars;  // run() rounds it to a sweep in the chromatic scan
+  double start = wallTime();
+  do {
+    _sampler.run(sweep);
+  } while (wallTime() - start < _burnIn * seconds);
+
+  // at least one sample, even when the time is up
+  do {
+    _sampler.run(sweep);
+    addSamples();
+  } while (wallTime() - start < seconds);
+  return _numOfSamples;
+}
+
+int lbGibbsInference::runSweeps(int burnIn, int sweeps) {
+  clearSamples();
+  _sampler.run(burnIn * _numOfVars);
+  for (int i = 0; i < sweeps; i++) {
+    _sampler.run(_numOfVars);
+    addSamples();
+  }
+  return _numOfSamples;
+}
+
+probVector lbGibbsInference::getMarginal(rVarIndex var) const {
+  int card = _offsets[(int) var + 1] - _offsets[var];
+  probVector marginal(card, 0);
+  if (_numOfSamples == 0) {
+    return probVector(card, 1.0 / card);
+  }
+  for (int chain = 0; chain < _numOfChains; chain++) {
+    for (int val = 0; val < card; val++) {
+      marginal[val] += _sums[chain][_offsets[var] + val];
+    }
+  }
+  for (int val = 0; val < card; val++) {
+    marginal[val] /= (probType) _numOfSamples * _numOfChains;
+  }
+  return marginal;
+}
+
+probVector lbGibbsInference::getStdError(rVarIndex var) const {
+  int card = _offsets[(int) var + 1] - _offsets[var];
+  probVector error(card, 0);
+  if (_numOfSamples == 0 || _numOfChains < 2) {
+    return error;
+  }
+  // the chains are independent, so the variance of their mean is the
+  // variance between the chain averages over the number of chains
+  probVector marginal = getMarginal(var);
+  for (int chain = 0; chain < _numOfChains; chain++) {
+    for (int val = 0; val < card; val++) {
+      probType diff = _sums[chain][_offsets[var] + val] / _numOfSamples - marginal[val];
+      error[val] += diff * diff;
+    }
+  }
+  for (int val = 0; val < card; val++) {
+    error[val] = sqrt(error[val] / ((probType) _numOfChains * (_numOfChains - 1)));
+  }
+  return error;
+}
+
+void lbGibbsInference::printMarginals(ostream& out, int k) const {
+  out << setprecision(5);
+  // the header of lbInferenceMonitor, which scripts look for
+  if (k > 0) {
+    out << "# belief marginals / exact marginals / KL Divergence" << endl;
+  }
+  for (rVarIndex var = 0; var < _numOfVars && var < k; var++) {
+    probVector marginal = getMarginal(var);
+    out << var << "\t";
+    for (uint val = 0; val < marginal.size(); val++) {
+      out << setw(15) << marginal[val] << "\t";
+    }
+    out << endl;
+  }
+}
+
+void lbGibbsInference::printStdErrors(ostream& out, int k) const {
+  out << setprecision(5);
+  if (k > 0) {
+    out << "# standard errors (" << _numOfSamples << " samples in each of "
+	<< _numOfChains << " chains)" << endl;
+  }
+  for (rVarIndex var = 0; var < _numOfVars && var < k; var++) {
+    probVector error = getStdError(var);
+    out << var << "\t";
+    for (uint val = 0; val < error.size(); val++) {
+      out << setw(15) << error[val] << "\t";
+    }
+    out << endl;
+  }
+}
@@ -0,0 +1,850 @@
+/* Copyright 2009 Ariel Jaimovich, Ofer Meshi, Ian McGraw and Gal Elidan */
+
+
+/*
+This file is part of FastInf library.
+
+FastInf is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+FastInf is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <lbGibbsSampler.h>
+#include <lbMathFunctions.h>
+#include <set>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+using namespace lbLib;
+
+// steps between two checks of the clock when running for a given time
+static const int TIME_CHECK_INTERVAL = 100;
+
+// smaller color classes are not worth starting threads for
+static const int MIN_PARALLEL_CLASS = 32;
+
+const int lbGibbsSampler::MAX_STACK_CARD;
+
+// a potential at temperature 1/power
+static inline probType raise(probType value, probType power) {
+  return (power == 1 ? value : pow(value, power));
+}
+
+lbGibbsSampler::lbGibbsSampler(lbModel const& model, int numOfChains, unsigned long seed) :
+  _model(model),
+  _numOfVars(model.getGraph().getNumOfVars()),
+  _cards(_numOfVars),
+  _observed(_numOfVars, false),
+  _values(numOfChains, intVec(_numOfVars, 0)),
+  _chains(numOfChains),
+  _generators(numOfChains),
+  _temps(numOfChains, 1.0),
+  _logLik(numOfChains, 0),
+  _tempering(false),
+  _swapInterval(100),
+  _swapRound(0),
+  _swapAttempts(0),
+  _swapAccepts(0),
+  // chain i draws from stream i, the swaps from the stream after the chains
+  _swapGenerator(seed, numOfChains),
+  _metropolis(false),
+  _scan(GS_RANDOM),
+  _maxBlockSize(0),
+  _syncInterval(1),
+  _convergeThresh(1.05),
+  _converged(false),
+  _numThreads(0)
+{
+  assert(numOfChains > 0);
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _cards[var] = model.getCards().getCardForVar(var);
+    _freeVars.push_back(var);
+  }
+  for (int chain = 0; chain < numOfChains; chain++) {
+    _chains[chain] = new lbAssignment();
+    _generators[chain] = _swapGenerator.split(chain);
+  }
+  compile();
+  initChains();
+}
+
+lbGibbsSampler::~lbGibbsSampler() {
+  for (uint chain = 0; chain < _chains.size(); chain++) {
+    delete _chains[chain];
+  }
+}
+
+void lbGibbsSampler::compile() {
+  lbGraphStruct const& graph = _model.getGraph();
+  int numOfCliques = graph.getNumOfCliques();
+
+  // flat table of every clique, the last variable changes fastest
+  vector<intVec> strides(numOfCliques);
+  _tables = vector<probVector>(numOfCliques);
+  _cliqBegin = intVec(numOfCliques + 1, 0);
+  _cliqVars.clear();
+  _cliqStrides.clear();
+  for (cliqIndex cliq = 0; cliq < numOfCliques; cliq++) {
+    lbAssignedMeasure const& cliqueAM = _model.getAssignedMeasureForClique(cliq);
+    varsVec const& vars = cliqueAM.getVars();
+    int size = vars.size();
+
+    strides[cliq] = intVec(size);
+    int tableSize = 1;
+    for (int k = size - 1; k >= 0; k--) {
+      strides[cliq][k] = tableSize;
+      tableSize *= _cards[vars[k]];
+    }
+
+    _tables[cliq] = probVector(tableSize);
+    lbAssignment assign;
+    for (int k = 0; k < size; k++) {
+      assign.setValueForVar(vars[k], 0);
+    }
+    cardVec cards = _model.getCardForVars(vars);
+    do {
+      int index = 0;
+      for (int k = 0; k < size; k++) {
+	index += assign.getValueForVar(vars[k]) * strides[cliq][k];
+      }
+      _tables[cliq][index] = cliqueAM.valueOfFull(assign);
+    } while (assign.advanceOne(cards, vars));
+
+    _cliqVars.insert(_cliqVars.end(), vars.begin(), vars.end());
+    _cliqStrides.insert(_cliqStrides.end(), strides[cliq].begin(), strides[cliq].end());
+    _cliqBegin[(int) cliq + 1] = _cliqVars.size();
+  }
+
+  // the terms of every variable (the tables are not resized from here on)
+  _terms = vector< vector<lbConditionalTerm> >(_numOfVars);
+  _otherVars.clear();
+  _otherStrides.clear();
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    cliquesVec const& cliques = graph.getAllCliquesForVar(var);
+    for (uint i = 0; i < cliques.size(); i++) {
+      varsVec const& vars = _model.getAssignedMeasureForClique(cliques[i]).getVars();
+      lbConditionalTerm term;
+      term.table = &_tables[cliques[i]][0];
+      term.stride = 0;
+      term.begin = _otherVars.size();
+      for (uint k = 0; k < vars.size(); k++) {
+	if (vars[k] == var) {
+	  term.stride = strides[cliques[i]][k];
+	}
+	else {
+	  _otherVars.push_back(vars[k]);
+	  _otherStrides.push_back(strides[cliques[i]][k]);
+	}
+      }
+      term.end = _otherVars.size();
+      _terms[var].push_back(term);
+    }
+  }
+
+  resetLogLikelihoods();
+}
+
+probType lbGibbsSampler::computeLogLikelihood(int chain) const {
+  intVec const& values = _values[chain];
+  probType logLik = 0;
+  for (uint cliq = 0; cliq < _tables.size(); cliq++) {
+    int index = 0;
+    for (int k = _cliqBegin[cliq]; k < _cliqBegin[cliq + 1]; k++) {
+      index += values[_cliqVars[k]] * _cliqStrides[k];
+    }
+    logLik += log(_tables[cliq][index]);
+  }
+  return logLik;
+}
+
+void lbGibbsSampler::resetLogLikelihoods() {
+  if (!_tempering) {
+    return;
+  }
+  for (uint chain = 0; chain < _values.size(); chain++) {
+    _logLik[chain] = computeLogLikelihood(chain);
+  }
+}
+
+void lbGibbsSampler::initChains() {
+  for (uint chain = 0; chain < _chains.size(); chain++) {
+    for (rVarIndex var = 0; var < _numOfVars; var++) {
+      int value = _generators[chain].RandomInt(_cards[var]);
+      if (!_observed[var]) {
+	_values[chain][var] = value;
+      }
+    }
+  }
+  _converged = false;
+  resetLogLikelihoods();
+}
+
+void lbGibbsSampler::syncChain(int chain) {
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _chains[chain]->setValueForVar(var, _values[chain][var]);
+  }
+}
+
+lbAssignment const& lbGibbsSampler::getChain(int chain) {
+  syncChain(chain);
+  return *_chains[chain];
+}
+
+safeVec<lbAssignment_ptr> const& lbGibbsSampler::getChains() {
+  for (uint chain = 0; chain < _chains.size(); chain++) {
+    syncChain(chain);
+  }
+  return _chains;
+}
+
+void lbGibbsSampler::setChain(int chain, lbAssignment const& assign) {
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _values[chain][var] = assign.getValueForVar(var);
+  }
+  if (_tempering) {
+    _logLik[chain] = computeLogLikelihood(chain);
+  }
+}
+
+void lbGibbsSampler::setEvidence(lbAssignment const& assign) {
+  _freeVars.clear();
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _observed[var] = assign.isAssigned(var);
+    if (!_observed[var]) {
+      _freeVars.push_back(var);
+      continue;
+    }
+    for (uint chain = 0; chain < _values.size(); chain++) {
+      _values[chain][var] = assign.getValueForVar(var);
+    }
+  }
+  _converged = false;
+  resetLogLikelihoods();
+}
+
+void lbGibbsSampler::resetEvidence() {
+  _freeVars.clear();
+  for (rVarIndex var = 0; var < _numOfVars; var++) {
+    _observed[var] = false;
+    _freeVars.push_back(var);
+  }
+  _converged = false;
+}
+
+void lbGibbsSampler::getConditional(int chain, rVarIndex var, probType* dist) const {
+  int card = _cards[var];
+  conditional(var, _values[chain], _temps[chain], dist);
+  probType total = 0;
+  for (int val = 0; val < card; val++) {
+    total += dist[val];
+  }
+  for (int val = 0; val < card; val++) {
+    dist[val] = (total > 0 ? dist[val] / total : 1.0 / card);
+  }
+}
+
+void lbGibbsSampler::swapChains(int chain1, int chain2) {
+  _values[chain1].swap(_values[chain2]);
+  swap(_logLik[chain1], _logLik[chain2]);
+}
+
+void lbGibbsSampler::addLogLikelihood(int chain, probType delta) {
+  if (!_tempering || delta == 0) {
+    return;
+  }
+  _logLik[chain] += delta;
+  // leaving a state of probability zero, the difference is not defined
+  if (!(_logLik[chain] > -HUGE_VAL && _logLik[chain] < HUGE_VAL)) {
+    _logLik[chain] = computeLogLikelihood(chain);
+  }
+}
+
+void lbGibbsSampler::setTemperatureLadder(vector<double> const& temps) {
+  assert(temps.size() == _temps.size());
+  for (uint chain = 1; chain < temps.size(); chain++) {
+    assert(temps[chain] >= temps[chain - 1]);
+  }
+  _temps = temps;
+  _tempering = true;
+  _swapRound = 0;
+  _swapAttempts = 0;
+  _swapAccepts = 0;
+  resetLogLikelihoods();
+}
+
+void lbGibbsSampler::setGeometricLadder(double maxTemp) {
+  int numOfChains = _temps.size();
+  vector<double> temps(numOfChains, 1.0);
+  for (int chain = 1; chain < numOfChains; chain++) {
+    temps[chain] = pow(maxTemp, (double) chain / (numOfChains - 1));
+  }
+  setTemperatureLadder(temps);
+}
+
+int lbGibbsSampler::runTempering(int steps, double seconds) {
+  assert(_tempering);
+  double startTime = wallTime();
+  int done = 0;
+  while (true) {
+    int round = (seconds > 0 ? _swapInterval : min(_swapInterval, steps - done));
+    if (round > 0) {
+      run(round);  // a thread per rung
+      done += round;
+    }
+    swapReplicas();
+    if (seconds > 0 ? wallTime() - startTime >= seconds : done >= steps) {
+      break;
+    }
+  }
+  return done;
+}
+
+void lbGibbsSampler::swapReplicas() {
+  // exchanging the states of chains at inverse temperatures b1 and b2
+  // is accepted with probability min {1, exp((b1-b2)(L2-L1))}
+  int numOfChains = _values.size();
+  for (int chain = _swapRound % 2; chain + 1 < numOfChains; chain += 2) {
+    double b1 = 1.0 / _temps[chain];
+    double b2 = 1.0 / _temps[chain + 1];
+    probType logRatio = (b1 - b2) * (_logLik[chain + 1] - _logLik[chain]);
+    _swapAttempts++;
+    if (logRatio >= 0 || _swapGenerator.RandomDouble(1) < exp(logRatio)) {
+      swapChains(chain, chain + 1);
+      _swapAccepts++;
+    }
+  }
+  _swapRound++;
+}
+
+void lbGibbsSampler::setScan(lbGibbsScan scan) {
+  _scan = scan;
+  if (_scan == GS_CHROMATIC && _colors.empty()) {
+    _colors = _model.getGraph().colorVars();
+  }
+  if (_scan == GS_BLOCKED && _blocks.empty()) {
+    buildBlocks();
+  }
+}
+
+void lbGibbsSampler::setMaxBlockSize(int size) {
+  _maxBlockSize = size;
+  _blocks.clear();
+  if (_scan == GS_BLOCKED) {
+    buildBlocks();
+  }
+}
+
+void lbGibbsSampler::buildBlocks() {
+  intVecVec neighbors = _model.getGraph().getVarsNeighbors();
+  _blocks.clear();
+  _blockOf = intVec(_numOfVars, -1);
+  _parentPos = intVec(_numOfVars, -1);
+
+  // grow a block from every variable that is not in one yet. A variable
+  // joins when exactly one of its neighbors is in the block, so the
+  // block stays a tree and shares at most a pair of variables with any
+  // clique.
+  for (rVarIndex root = 0; root < _numOfVars; root++) {
+    if (_blockOf[root] >= 0) {
+      continue;
+    }
+    int block = _blocks.size();
+    _blocks.push_back(intVec(1, root));
+    _blockOf[root] = block;
+    intVec& vars = _blocks.back();
+    for (uint head = 0; head < vars.size(); head++) {
+      intVec const& next = neighbors[vars[head]];
+      for (uint n = 0; n < next.size(); n++) {
+	if (_maxBlockSize > 0 && (int) vars.size() >= _maxBlockSize) {
+	  break;
+	}
+	int var = next[n];
+	if (_blockOf[var] >= 0) {
+	  continue;
+	}
+	int inBlock = 0;
+	for (uint k = 0; k < neighbors[var].size(); k++) {
+	  inBlock += (_blockOf[neighbors[var][k]] == block);
+	}
+	if (inBlock == 1) {
+	  _blockOf[var] = block;
+	  _parentPos[var] = head;
+	  vars.push_back(var);
+	}
+      }
+    }
+  }
+
+  // the cliques of every block, by their variable farthest from the root
+  int numOfBlocks = _blocks.size();
+  intVec position(_numOfVars);
+  for (int block = 0; block < numOfBlocks; block++) {
+    for (uint i = 0; i < _blocks[block].size(); i++) {
+      position[_blocks[block][i]] = i;
+    }
+  }
+  vector< vector< vector<lbBlockTerm> > > termsOf(numOfBlocks);
+  for (int block = 0; block < numOfBlocks; block++) {
+    termsOf[block].resize(_blocks[block].size());
+  }
+  int numOfCliques = _tables.size();
+  for (int cliq = 0; cliq < numOfCliques; cliq++) {
+    for (int k = _cliqBegin[cliq]; k < _cliqBegin[cliq + 1]; k++) {
+      int block = _blockOf[_cliqVars[k]];
+      // the deepest variable of this block in the clique
+      int deepest = -1;
+      for (int j = _cliqBegin[cliq]; j < _cliqBegin[cliq + 1]; j++) {
+	int var = _cliqVars[j];
+	if (_blockOf[var] == block && (deepest < 0 || position[var] > position[_cliqVars[deepest]])) {
+	  deepest = j;
+	}
+      }
+      if (deepest != k) {
+	continue;
+      }
+      int var = _cliqVars[k];
+      lbBlockTerm term;
+      term.cliq = cliq;
+      term.stride = _cliqStrides[k];
+      term.parentStride = 0;
+      for (int j = _cliqBegin[cliq]; j < _cliqBegin[cliq + 1]; j++) {
+	if (j != k && _blockOf[_cliqVars[j]] == block) {
+	  assert(position[_cliqVars[j]] == _parentPos[var]);
+	  term.parentStride = _cliqStrides[j];
+	}
+      }
+      termsOf[block][position[var]].push_back(term);
+    }
+  }
+  _blockTerms = vector< vector<lbBlockTerm> >(numOfBlocks);
+  _blockTermBegin = intVecVec(numOfBlocks);
+  for (int block = 0; block < numOfBlocks; block++) {
+    _blockTermBegin[block].push_back(0);
+    for (uint i = 0; i < termsOf[block].size(); i++) {
+      _blockTerms[block].insert(_blockTerms[block].end(),
+				termsOf[block][i].begin(), termsOf[block][i].end());
+      _blockTermBegin[block].push_back(_blockTerms[block].size());
+    }
+  }
+
+  // blocks of the same color share no clique, so they are independent
+  // given the rest and can be resampled together
+  intVecVec blockNeighbors(numOfBlocks);
+  for (int block = 0; block < numOfBlocks; block++) {
+    set<int> others;
+    for (uint i = 0; i < _blocks[block].size(); i++) {
+      intVec const& next = neighbors[_blocks[block][i]];
+      for (uint n = 0; n < next.size(); n++) {
+	if (_blockOf[next[n]] != block) {
+	  others.insert(_blockOf[next[n]]);
+	}
+      }
+    }
+    blockNeighbors[block].assign(others.begin(), others.end());
+  }
+  _blockColors = lbGraphStruct::colorGraph(blockNeighbors);
+}
+
+void lbGibbsSampler::setTemperature(double temp) {
+  for (uint chain = 0; chain < _temps.size(); chain++) {
+    _temps[chain] = temp;
+  }
+}
+
+int lbGibbsSampler::numThreads() const {
+#ifdef _OPENMP
+  return ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#else
+  return 1;
+#endif
+}
+
+void lbGibbsSampler::run(int steps) {
+  int numOfChains = _chains.size();
+  int threads = min(numThreads(), numOfChains);
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (int chain = 0; chain < numOfChains; chain++) {
+    runChain(chain, steps);
+  }
+}
+
+void lbGibbsSampler::runForTime(double seconds) {
+  int numOfChains = _chains.size();
+  int threads = min(numThreads(), numOfChains);
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+  for (int chain = 0; chain < numOfChains; chain++) {
+    runChainForTime(chain, seconds);
+  }
+}
+
+void lbGibbsSampler::runChain(int chain, int steps) {
+  if (_scan != GS_RANDOM) {
+    int sweeps = (steps + _numOfVars - 1) / _numOfVars;
+    for (int i = 0; i < sweeps; i++) {
+      if (_scan == GS_CHROMATIC) {
+	sweep(chain);
+      }
+      else {
+	blockSweep(chain);
+      }
+    }
+    return;
+  }
+  for (int i = 0; i < steps; i++) {
+    step(chain);
+  }
+}
+
+void lbGibbsSampler::runChainForTime(int chain, double seconds) {
+  double startTime = wallTime();
+  do {
+    runChain(chain, TIME_CHECK_INTERVAL);
+  } while (wallTime() - startTime < seconds);
+}
+
+int lbGibbsSampler::runUntilConverged(int maxSteps, int checkInterval, double seconds) {
+  assert(_chains.size() > 1);
+  lbGibbsConvergeStatistic stats(_values, _model, _convergeThresh);
+  if (!_checkedMeasures.empty()) {
+    stats.setMeasures(_checkedMeasures);
+  }
+
+  double startTime = wallTime();
+  int steps = 0;
+  _converged = false;
+  while (true) {
+    run(_syncInterval);
+    steps += _syncInterval;
+    stats.updateStats(_values);
+
+    // we might not want to check convergence in every sample
+    if (stats.getNumOfSamples() % checkInterval == 0 && stats.didConverge()) {
+      _converged = true;
+      break;
+    }
+    if (seconds > 0) {
+      if (wallTime() - startTime >= seconds) {
+	break;
+      }
+    }
+    else if (steps >= maxSteps) {
+      break;
+    }
+  }
+  return steps;
+}
+
+void lbGibbsSampler::conditional(rVarIndex var, intVec const& values, double temp,
+				 probType* dist) const {
+  int card = _cards[var];
+  for (int val = 0; val < card; val++) {
+    dist[val] = 1;
+  }
+
+  vector<lbConditionalTerm> const& terms = _terms[var];
+  for (uint t = 0; t < terms.size(); t++) {
+    lbConditionalTerm const& term = terms[t];
+    int offset = 0;
+    for (int k = term.begin; k < term.end; k++) {
+      offset += values[_otherVars[k]] * _otherStrides[k];
+    }
+    probType const* entry = term.table + offset;
+    for (int val = 0; val < card; val++, entry += term.stride) {
+      dist[val] *= *entry;
+    }
+  }
+
+  if (temp != 1.0) {
+    for (int val = 0; val < card; val++) {
+      dist[val] = pow(dist[val], (probType) (1.0 / temp));
+    }
+  }
+}
+
+int lbGibbsSampler::sample(probType const* dist, int card, probType u, int skip) const {
+  probType total = 0;
+  for (int val = 0; val < card; val++) {
+    if (val != skip) {
+      total += dist[val];
+    }
+  }
+  probType randD = u * total;
+  probType cummulative = 0;
+  int last = -1;
+  for (int val = 0; val < card; val++) {
+    if (val == skip || dist[val] == 0) {
+      continue;
+    }
+    cummulative += dist[val];
+    last = val;
+    if (cummulative > randD) {
+      return val;
+    }
+  }
+  // rounding, return the last value with positive probability
+  return (last >= 0 ? last : 0);
+}
+
+void lbGibbsSampler::step(int chain) {
+  if (_freeVars.empty()) {
+    return;
+  }
+  lbCounterGenerator& rng = _generators[chain];
+  rVarIndex var = (rVarIndex) _freeVars[rng.RandomInt(_freeVars.size())];
+  probType u = rng.RandomDouble(1);
+  probType v = (_metropolis ? rng.RandomDouble(1) : 0);
+  addLogLikelihood(chain, update(chain, var, u, v));
+}
+
+void lbGibbsSampler::sweep(int chain) {
+  assert(!_colors.empty());
+  lbCounterGenerator& rng = _generators[chain];
+  int threads = numThreads();
+  for (uint c = 0; c < _colors.size(); c++) {
+    intVec const& vars = _colors[c];
+    int size = vars.size();
+
+    // draw in order so that the sweep does not depend on the threads
+    probVector u(size);
+    probVector v(size, 0);
+    probVector delta(size, 0);
+    rng.Fill(u);
+    if (_metropolis) {
+      rng.Fill(v);
+    }
+
+    // the variables of a class do not share cliques, so each update
+    // only reads values that are not written by the others
+#pragma omp parallel for schedule(static) num_threads(threads) if(size >= MIN_PARALLEL_CLASS)
+    for (int i = 0; i < size; i++) {
+      delta[i] = update(chain, vars[i], u[i], v[i]);
+    }
+    // summed in order, so the likelihood does not depend on the threads either
+    for (int i = 0; i < size; i++) {
+      addLogLikelihood(chain, delta[i]);
+    }
+  }
+}
+
+void lbGibbsSampler::blockSweep(int chain) {
+  assert(!_blocks.empty());
+  lbCounterGenerator& rng = _generators[chain];
+  int threads = numThreads();
+  for (uint c = 0; c < _blockColors.size(); c++) {
+    intVec const& blocks = _blockColors[c];
+    int size = blocks.size();
+
+    // a random number per variable, drawn in order
+    intVec first(size + 1, 0);
+    for (int i = 0; i < size; i++) {
+      first[i + 1] = first[i] + _blocks[blocks[i]].size();
+    }
+    probVector u(first[size]);
+    rng.Fill(u);
+    probVector delta(size, 0);
+
+#pragma omp parallel for schedule(dynamic) num_threads(threads) if(first[size] >= MIN_PARALLEL_CLASS)
+    for (int i = 0; i < size; i++) {
+      delta[i] = updateBlock(chain, blocks[i], &u[first[i]]);
+    }
+    for (int i = 0; i < size; i++) {
+      addLogLikelihood(chain, delta[i]);
+    }
+  }
+}
+
+probType lbGibbsSampler::blockLogLikelihood(int chain, int block) const {
+  intVec const& values = _values[chain];
+  vector<lbBlockTerm> const& terms = _blockTerms[block];
+  probType logLik = 0;
+  for (uint t = 0; t < terms.size(); t++) {
+    int cliq = terms[t].cliq;
+    int index = 0;
+    for (int k = _cliqBegin[cliq]; k < _cliqBegin[cliq + 1]; k++) {
+      index += values[_cliqVars[k]] * _cliqStrides[k];
+    }
+    logLik += log(_tables[cliq][index]);
+  }
+  return logLik;
+}
+
+probType lbGibbsSampler::updateBlock(int chain, int block, probType const* u) {
+  intVec& values = _values[chain];
+  intVec const& vars = _blocks[block];
+  vector<lbBlockTerm> const& terms = _blockTerms[block];
+  intVec const& termBegin = _blockTermBegin[block];
+  int size = vars.size();
+  probType power = (probType) (1.0 / _temps[chain]);
+
+  probType before = 0;
+  if (_tempering) {
+    before = blockLogLikelihood(chain, block);
+  }
+
+  // the part of every term that the variables outside the block fix
+  intVec offset(terms.size(), 0);
+  for (uint t = 0; t < terms.size(); t++) {
+    int cliq = terms[t].cliq;
+    for (int k = _cliqBegin[cliq]; k < _cliqBegin[cliq + 1]; k++) {
+      if (_blockOf[_cliqVars[k]] != block) {
+	offset[t] += values[_cliqVars[k]] * _cliqStrides[k];
+      }
+    }
+  }
+
+  // beliefs of the variables, with their single variable terms
+  intVec first(size + 1, 0);
+  for (int i = 0; i < size; i++) {
+    first[i + 1] = first[i] + _cards[vars[i]];
+  }
+  probVector belief(first[size], 1);
+  for (int i = 0; i < size; i++) {
+    int card = _cards[vars[i]];
+    for (int t = termBegin[i]; t < termBegin[i + 1]; t++) {
+      if (terms[t].parentStride != 0) {
+	continue;
+      }
+      probType const* entry = &_tables[terms[t].cliq][offset[t]];
+      for (int val = 0; val < card; val++) {
+	belief[first[i] + val] *= raise(entry[val * terms[t].stride], power);
+      }
+    }
+    // evidence leaves a single value
+    if (_observed[vars[i]]) {
+      for (int val = 0; val < card; val++) {
+	if (val != values[vars[i]]) {
+	  belief[first[i] + val] = 0;
+	}
+      }
+    }
+  }
+
+  // pairwise potential of variable i with its parent
+  probVector pairwise;
+  intVec pairFirst(size + 1, 0);
+  for (int i = 1; i < size; i++) {
+    pairFirst[i + 1] = pairFirst[i] + _cards[vars[i]] * _cards[vars[_parentPos[vars[i]]]];
+  }
+  pairwise.resize(pairFirst[size], 1);
+  for (int i = 1; i < size; i++) {
+    int card = _cards[vars[i]];
+    int parentCard = _cards[vars[_parentPos[vars[i]]]];
+    for (int t = termBegin[i]; t < termBegin[i + 1]; t++) {
+      lbBlockTerm const& term = terms[t];
+      if (term.parentStride == 0) {
+	continue;
+      }
+      probType const* table = &_tables[term.cliq][offset[t]];
+      for (int p = 0; p < parentCard; p++) {
+	for (int val = 0; val < card; val++) {
+	  pairwise[pairFirst[i] + p * card + val] *=
+	    raise(table[p * term.parentStride + val * term.stride], power);
+	}
+      }
+    }
+  }
+
+  // forward filtering: messages from the leaves to the root
+  for (int i = size - 1; i > 0; i--) {
+    int card = _cards[vars[i]];
+    int parent = _parentPos[vars[i]];
+    int parentCard = _cards[vars[parent]];
+    probType* message = &belief[first[parent]];
+    probType total = 0;
+    probVector toParent(parentCard, 0);
+    for (int p = 0; p < parentCard; p++) {
+      probType const* pair = &pairwise[pairFirst[i] + p * card];
+      for (int val = 0; val < card; val++) {
+	toParent[p] += pair[val] * belief[first[i] + val];
+      }
+      total += toParent[p];
+    }
+    for (int p = 0; p < parentCard; p++) {
+      message[p] *= (total > 0 ? toParent[p] / total : toParent[p]);
+    }
+  }
+
+  // backward sampling: the root from its belief, then every variable
+  // given its parent
+  probVector dist;
+  for (int i = 0; i < size; i++) {
+    if (_observed[vars[i]]) {
+      continue;
+    }
+    int card = _cards[vars[i]];
+    dist.assign(belief.begin() + first[i], belief.begin() + first[i + 1]);
+    if (i > 0) {
+      int parentVal = values[vars[_parentPos[vars[i]]]];
+      probType const* pair = &pairwise[pairFirst[i] + parentVal * card];
+      for (int val = 0; val < card; val++) {
+	dist[val] *= pair[val];
+      }
+    }
+    values[vars[i]] = sample(&dist[0], card, u[i]);
+  }
+
+  if (!_tempering) {
+    return 0;
+  }
+  return blockLogLikelihood(chain, block) - before;
+}
+
+probType lbGibbsSampler::update(int chain, rVarIndex var, probType u, probType v) {
+  if (_observed[var]) {
+    return 0;
+  }
+  intVec& values = _values[chain];
+  int card = _cards[var];
+
+  probType stackDist[MAX_STACK_CARD];
+  probVector heapDist;
+  probType* dist = stackDist;
+  if (card > MAX_STACK_CARD) {
+    heapDist.resize(card);
+    dist = &heapDist[0];
+  }
+  conditional(var, values, _temps[chain], dist);
+
+  int prevVal = values[var];
+  int newVal;
+  if (!_metropolis) {
+    newVal = sample(dist, card, u);  // always accept
+  }
+  else {
+    // acceptance probability is:  min {1, [1-p(xi|X\Xi)]/[1-p(x'i|X\Xi)]}
+    probType total = 0;
+    for (int val = 0; val < card; val++) {
+      total += dist[val];
+    }
+    probType curAssignProb = dist[prevVal] / total;  // = p(xi|X\Xi)
+    if (curAssignProb >= 1) {
+      return 0;  // no other value is possible
+    }
+
+    // only consider new values
+    newVal = sample(dist, card, u, prevVal);
+    probType nextAssignProb = dist[newVal] / total;  // = p(x'i|X\Xi)
+
+    double acceptanceProb = Min(1, (1 - curAssignProb) / (1 - nextAssignProb));
+    if (v > acceptanceProb) {
+      newVal = prevVal;
+    }
+  }
+  values[var] = newVal;
+
+  if (!_tempering || newVal == prevVal) {
+    return 0;
+  }
+  // the conditional is the likelihood up to a constant, raised to 1/temp
+  return _temps[chain] * (log(dist[newVal]) - log(dist[prevVal]));
+}
@@ -19,6 +19,8 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <queue>
+#include <set>
+#include <algorithm>
 #include <lbGraphStruct.h>
 #include <lbGraphListener.h>
 
@@ -181,6 +183,23 @@ bool lbGraphStruct::setCliqueNeighbors (cliqIndex clique, cliquesVec& cliqueNeig
   return true;
 }
 
+bool lbGraphStruct::setCliqueNeighborsList(cliqIndex clique, cliquesVec const& cliqueNeighbors,
+					   separatorsVec const& separators) {
+  if (clique>=_numOfCliques || cliqueNeighbors.size()!=separators.size()){
+    cerr <<"In setting the neighbors of clique "<<clique<<", the clique or the separators are not legal"<<endl;
+    return false;
+  }
+  for (uint ind=0;ind<cliqueNeighbors.size();ind++){
+    if (cliqueNeighbors[ind]<0 || cliqueNeighbors[ind]>=_numOfCliques) {
+      cerr <<"In setting the neighbors of clique "<<clique<<", neighbor "<<cliqueNeighbors[ind]<<" is not legal"<<endl;
+      return false;
+    }
+  }
+  _cliqueNeighborsVec[clique] = cliqueNeighbors;
+  _cliqueNeighborSeparatorVec[clique] = separators;
+  return true;
+}
+
 bool lbGraphStruct::addCliqueNeighbor(cliqIndex clique, cliqIndex Neighbor) {
   
   varsVec vec = varsVec(); 
@@ -583,6 +602,61 @@ bool lbGraphStruct::runningIntersectionSatisfied (rVarIndex var) const {
   return true;
 }
 
+intVecVec lbGraphStruct::getVarsNeighbors() const {
+  int numOfVars = getNumOfVars();
+  intVecVec neighbors(numOfVars);
+  for (rVarIndex var = 0; var < numOfVars; var++) {
+    set<int> others;
+    cliquesVec const& cliques = getAllCliquesForVar(var);
+    for (uint c = 0; c < cliques.size(); c++) {
+      varsVec const& vars = getVarsVecForClique(cliques[c]);
+      for (uint v = 0; v < vars.size(); v++) {
+	if (vars[v] != var) {
+	  others.insert(vars[v]);
+	}
+      }
+    }
+    neighbors[var].assign(others.begin(), others.end());
+  }
+  return neighbors;
+}
+
+intVecVec lbGraphStruct::colorVars() const {
+  return colorGraph(getVarsNeighbors());
+}
+
+intVecVec lbGraphStruct::colorGraph(intVecVec const& neighbors) {
+  // color the nodes with many neighbors first
+  int numOfNodes = neighbors.size();
+  vector< pair<int,int> > byDegree;
+  for (int node = 0; node < numOfNodes; node++) {
+    byDegree.push_back(make_pair(-(int) neighbors[node].size(), node));
+  }
+  sort(byDegree.begin(), byDegree.end());
+
+  intVec color(numOfNodes, -1);
+  intVecVec colors;
+  for (int k = 0; k < numOfNodes; k++) {
+    int node = byDegree[k].second;
+    boolVec used(colors.size(), false);
+    for (uint n = 0; n < neighbors[node].size(); n++) {
+      if (color[neighbors[node][n]] >= 0) {
+	used[color[neighbors[node][n]]] = true;
+      }
+    }
+    int c = 0;
+    while (c < (int) colors.size() && used[c]) {
+      c++;
+    }
+    if (c == (int) colors.size()) {
+      colors.push_back(intVec());
+    }
+    color[node] = c;
+    colors[c].push_back(node);
+  }
+  return colors;
+}
+
 bool lbGraphStruct::isConnected () const {
   queue<cliqIndex> q;
   uint j;
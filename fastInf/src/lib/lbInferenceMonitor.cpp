@@ -25,7 +25,8 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 using namespace lbLib;
 
 lbInferenceMonitor::lbInferenceMonitor(lbBeliefPropagation const * bp) :
-  _bp(bp) {
+  _bp(bp),
+  _beliefGraph(NULL) {
   _lastUpdateT = 0;
 
   _statGapMessages = 100000000;
@@ -174,6 +175,21 @@ lbAssignedMeasure_ptr lbInferenceMonitor::getBeliefMarginal(rVarIndex var) {
   return marginal;
 }
 
+lbAssignedMeasure_ptr lbInferenceMonitor::getBeliefOf(varsVec const & vars) {
+  lbAssignedMeasure_ptr bel = NULL;
+  for (cliqIndex cliq = 0; cliq < _bp->getModel().getGraph().getNumOfCliques(); cliq++) {
+    if (vecSubset(vars, _bp->getModel().getGraph().getVarsVecForClique(cliq))) {
+      bel = _bp->computeBelief(cliq);
+      break;
+    }
+  }
+
+  assert(bel != NULL);
+  lbAssignedMeasure_ptr marginal = bel->marginalize(vars, _bp->getModel().measDispatcher());
+  delete bel;
+  return marginal;
+}
+
 lbAssignedMeasure_ptr lbInferenceMonitor::getExact(varsVec const & vars) {
   lbAssignedMeasure_ptr exact = NULL;
 
@@ -194,16 +210,26 @@ lbAssignedMeasure_ptr lbInferenceMonitor::getExact(varsVec const & vars) {
 }
 
 void lbInferenceMonitor::printBeliefs(ostream & out) {
-  printBeliefs(out, _bp->getModel().getGraph().getNumOfCliques());
+  lbGraphStruct const & graph = (_beliefGraph != NULL ? *_beliefGraph : _bp->getModel().getGraph());
+  printBeliefs(out, graph.getNumOfCliques());
 }
 
 // Print the first k beliefs.
 void lbInferenceMonitor::printBeliefs(ostream & out, int k,bool withExact) {
   int numOfCliques = _bp->getModel().getGraph().getNumOfCliques();
+  if (_beliefGraph != NULL) {
+    numOfCliques = _beliefGraph->getNumOfCliques();
+  }
 
   for (cliqIndex cliq=0; cliq < numOfCliques && cliq < k; cliq++) {
     cerr << "Belief:" << endl;
-    lbAssignedMeasure_ptr bel =_bp->computeBelief(cliq);
+    lbAssignedMeasure_ptr bel;
+    if (_beliefGraph != NULL) {
+      bel = getBeliefOf(_beliefGraph->getVarsVecForClique(cliq));
+    }
+    else {
+      bel = _bp->computeBelief(cliq);
+    }
     bel->print(cerr);
 
     lbAssignedMeasure_ptr exact = getExact(bel->getVars());
@@ -226,7 +252,9 @@ void lbInferenceMonitor::printMarginals(ostream & out) {
 }
 
 void lbInferenceMonitor::printInfo(ostream & out) const {
-
+  if (!_engineReport.empty()) {
+    out << _engineReport;
+  }
 }
 
 void lbInferenceMonitor::printMessage(ostream & out, cliqIndex toCliq, cliqIndex fromCliq) const {
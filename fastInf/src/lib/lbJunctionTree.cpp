@@ -85,6 +85,34 @@ lbModel* lbJunctionTree::CalcJunctionTreeGraphicalModel
   return JTgraphModel;
 }
 
+realVal lbJunctionTree::EstimateJunctionTreeWeight
+(const lbModel* model, lbJunctionTree::JTmethod JTmeth, int* treewidth, int* numCliques) {
+
+  lbBasicGraph* g = CreatelbBasicGraphFromModel(model);
+  pair<realVal, lbBasicGraph::CliqueList*> JTcliqsWeight = CalcJunctionTreeCliques(g, JTmeth);
+  lbBasicGraph::CliqueList* JTcliqs = JTcliqsWeight.second;
+
+  int maxSize = 0;
+  for (lbBasicGraph::CliqueList::iterator cliqIt = JTcliqs->begin(); cliqIt != JTcliqs->end(); ++cliqIt) {
+    maxSize = max(maxSize, (int) (*cliqIt)->size());
+  }
+  if (treewidth != NULL)
+    *treewidth = maxSize - 1;
+  if (numCliques != NULL)
+    *numCliques = JTcliqs->size();
+
+  for (lbBasicGraph::CliqueList::iterator cliqIt = JTcliqs->begin(); cliqIt != JTcliqs->end(); ++cliqIt)
+    delete *cliqIt;
+  delete JTcliqs;
+  delete g;
+
+  return JTcliqsWeight.first;
+}
+
+realVal lbJunctionTree::MaxLog10CliquesWeight() {
+  return MAX_LOG10_CLIQUES_WEIGHT;
+}
+
 lbBasicGraph* lbJunctionTree::CreatelbBasicGraphFromModel(const lbModel* model) {
 
   const lbGraphStruct& lbGraph = model->getGraph();
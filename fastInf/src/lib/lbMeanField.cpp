@@ -27,19 +27,26 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <lbMeanField.h>
+#include <lbPriorityQueue.h>
 #include <climits> // for INT_MAX
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 using namespace lbLib;
 
 const double MF_THRESH = lbDefinitions::SMALL;
 
+// Jacobi updates are not guaranteed to converge (even damped)
+const int MF_MAX_JACOBI_SWEEPS = 10000;
+
 lbMeanField::lbMeanField(lbModel & model,lbMeasureDispatcher const& disp) :
-  lbInferenceObject(model,disp),_MFMethod(IM_NORMAL)
+  lbInferenceObject(model,disp),_MFMethod(IM_NORMAL),_damping(0.5),_numThreads(0)
 {
   reset();
 }
 
 lbMeanField::lbMeanField(lbMeanField const& otherMeanField) 
-  : lbInferenceObject(otherMeanField),_MFMethod(IM_NORMAL)
+  : lbInferenceObject(otherMeanField),_MFMethod(IM_NORMAL),_damping(0.5),_numThreads(0)
 {
   assert(false);
 }
@@ -126,6 +133,12 @@ bool lbMeanField::calcProbs()
   case IM_LARGE_EFFECT:
     iterateLargestEffect();
     break;
+  case IM_COLORED:
+    iterateColored();
+    break;
+  case IM_JACOBI:
+    iterateJacobi();
+    break;
   default:
     assert(false);
     break;
@@ -176,66 +189,43 @@ int lbMeanField::iterateResiduals()
 
   initialize();
 
-  // compute num of effected marginals for each variable
-  vector< set<int> > affected(_measures.size());
-  for ( uint i=0 ; i<_measures.size() ; i++ ) {
-    cliquesVec const& cliques = _model.getGraph().getAllCliquesForVar(i);
-    for ( uint c=0 ; c<cliques.size() ; c++ ) {
-      varsVec const& vars = _model.getGraph().getVarsVecForClique(cliques[c]);
-      for ( uint v=0 ; v<vars.size() ; v++ )
-	if ( vars[v] != (int) i ) 
-	  affected[i].insert(vars[v]);
-    }
-  }
+  intVecVec affected = computeAffected();
 
   // create initial "future"
   measurePtrVec futureMeasures;
-  multimap< double , int, greater<double> > rqueue;
+  lbPriorityQueue<int,double> rqueue;
   int computations = 0;
   for ( uint i=0 ; i<_measures.size() ; i++ ) {
     futureMeasures.push_back(computeMarginal(i));
-    lbAssignedMeasure_ptr assignMeas = new lbAssignedMeasure(futureMeasures[i],_factors[i]->getVars());
-    double residual = assignMeas->getMaxDiff(*_factors[i]);
-    rqueue.insert(std::make_pair(residual,i));
+    rqueue.insert(i,residual(i,futureMeasures[i]));
     computations++;
   }
 
   int updates = 0;
   cerr << "Iterating mean field equations\n";
 
-  while ( rqueue.size() > 0 ) {
+  while ( !rqueue.empty() ) {
       
-    double res = rqueue.begin()->first;
-    int index = rqueue.begin()->second;
-    rqueue.erase(rqueue.begin());
+    int index = rqueue.maximum();
+    // the largest residual is small, so all of them are
+    if ( rqueue.getValue(index) <= MF_THRESH )
+      break;
+    rqueue.deleteMax();
     
-    // propagate measures
-    lbMeasure_Sptr meas = computeMarginal(index);
-    if ( res > MF_THRESH ) {
-      // move measure from future into present
-      _measures[index] = futureMeasures[index];
-      _factors[index]->replaceMeasure(_measures[index]);
-      updates++;
-      
-      // compute new future for all dependent messages
-      set<int>::iterator it;
-      for ( it=affected[index].begin() ; it!=affected[index].end() ; it++ ) {
-	futureMeasures[*it] = computeMarginal(*it);
-	lbAssignedMeasure_ptr assignMeas = new lbAssignedMeasure(futureMeasures[*it],_factors[*it]->getVars());
-	double residual = assignMeas->getMaxDiff(*_factors[*it]);
-	// take old value out of queue
-	multimap< double , int, greater<double> >::iterator qit;
-	for ( qit=rqueue.begin() ; qit!=rqueue.end() ; qit++ )
-	  if ( qit->second == *it ) {
-	    rqueue.erase(qit);
-	    break;
-	  }
-	// insert new value
-	rqueue.insert(std::make_pair(residual,*it));
-	computations++;
-      } // affected
+    // move measure from future into present
+    _measures[index] = futureMeasures[index];
+    _factors[index]->replaceMeasure(_measures[index]);
+    updates++;
       
-    } // there was an update
+    // compute new future for all dependent messages
+    for ( uint a=0 ; a<affected[index].size() ; a++ ) {
+      int other = affected[index][a];
+      futureMeasures[other] = computeMarginal(other);
+      double res = residual(other,futureMeasures[other]);
+      if ( !rqueue.changeValue(other,res) )
+	rqueue.insert(other,res);
+      computations++;
+    } // affected
     
   } // queue is not empty
   
@@ -372,6 +362,121 @@ int lbMeanField::iterate()
   return updates;
 }
 
+int lbMeanField::iterateColored()
+{
+  if ( _calculated )
+    return 0;
+
+  initialize();
+
+  intVecVec colors = _model.getGraph().colorVars();
+  cerr << "Colored variables with " << colors.size() << " colors\n";
+
+  int threads = numThreads();
+  measurePtrVec newMeasures(_measures.size());
+  bool converged = false;
+  int updates = 0;
+  cerr << "Iterating mean field equations\n";
+  while ( ! converged ) {
+
+    converged = true;
+    for ( uint c=0 ; c<colors.size() ; c++ ) {
+      intVec const& vars = colors[c];
+      int n = (int)vars.size();
+
+      // variables of one color don't read each other's marginals
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+      for ( int k=0 ; k<n ; k++ )
+	newMeasures[vars[k]] = computeMarginal(vars[k]);
+
+      for ( int k=0 ; k<n ; k++ ) {
+	int i = vars[k];
+	if ( newMeasures[i]->isDifferent(*_measures[i],C_MAX,MF_THRESH) ) {
+	  converged = false;
+	  _measures[i] = newMeasures[i];
+	  _factors[i]->replaceMeasure(_measures[i]);
+	  updates++;
+	}
+	newMeasures[i].reset();
+      }
+    } // colors
+
+  } // until convergence
+
+  cerr << "Mean field converged after " << updates << " updates\n"; 
+  _calculated = true;
+  return updates;
+}
+
+int lbMeanField::iterateJacobi()
+{
+  if ( _calculated )
+    return 0;
+
+  initialize();
+
+  int threads = numThreads();
+  int N = (int)_measures.size();
+  measurePtrVec newMeasures(N);
+  bool converged = false;
+  int updates = 0;
+  int sweeps = 0;
+  cerr << "Iterating mean field equations\n";
+  while ( ! converged && sweeps < MF_MAX_JACOBI_SWEEPS ) {
+
+    // all marginals are computed from the previous sweep
+#pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for ( int i=0 ; i<N ; i++ )
+      newMeasures[i] = computeMarginal(i);
+
+    converged = true;
+    for ( int i=0 ; i<N ; i++ ) {
+      if ( newMeasures[i]->isDifferent(*_measures[i],C_MAX,MF_THRESH) ) {
+	converged = false;
+	if ( _damping > 0 ) {
+	  lbMeasure_Sptr damped = _measures[i]->duplicate();
+	  damped->updateMeasureValues(*newMeasures[i],_damping);
+	  damped->normalize();
+	  newMeasures[i] = damped;
+	}
+	_measures[i] = newMeasures[i];
+	_factors[i]->replaceMeasure(_measures[i]);
+	updates++;
+      }
+      newMeasures[i].reset();
+    }
+    sweeps++;
+
+  } // until convergence
+
+  if ( ! converged )
+    cerr << "Mean field did not converge after " << sweeps << " Jacobi sweeps (" << updates << " updates)\n";
+  else
+    cerr << "Mean field converged after " << updates << " updates\n"; 
+  _calculated = true;
+  return updates;
+}
+
+intVecVec lbMeanField::computeAffected() const
+{
+  return _model.getGraph().getVarsNeighbors();
+}
+
+double lbMeanField::residual(int index, lbMeasure_Sptr meas) const
+{
+  lbAssignedMeasure future(meas,_factors[index]->getVars());
+  return future.getMaxDiff(*_factors[index]);
+}
+
+int lbMeanField::numThreads() const
+{
+#ifdef _OPENMP
+  return ( _numThreads > 0 ? _numThreads : omp_get_max_threads() );
+#else
+  return 1;
+#endif
+}
+
 lbMeasure_Sptr lbMeanField::computeMarginal(int index)
 {
   cardVec cards = _measures[index]->getCards();
@@ -413,8 +518,10 @@ lbMeasure_Sptr lbMeanField::computeMarginal(int index)
       assignMeas->setLogValueOfFull(assign,total+curValue);
     } while ( assign.advanceOne(cards,vars) );
 
+    delete probPtr;
   } // over cliques
 
+  delete assignMeas;
   meas->normalize();
   return meas;
 }
@@ -19,6 +19,7 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <lbMeasure.h>
+#include <lbBinaryModel.h>
 
 using namespace lbLib ;
 
@@ -55,6 +56,32 @@ void lbMeasure::setMaxProduct(bool maxProd) {
   MAX_PRODUCT=maxProd;
 }
 
+void lbMeasure::readOneMeasureBinary(lbBinaryModelReader& in) {
+  cerr<<"Error, binary models are not supported for this measure type"<<endl;
+  exit(1);
+}
+
+void lbMeasure::writeBinary(lbBinaryModelWriter& out) const {
+  cerr<<"Error, binary models are not supported for this measure type"<<endl;
+  exit(1);
+}
+
+void lbMeasure::calcHessianDiag(probType* diag,probType* counts,
+				lbMeasure const& Estimated,
+				probType numOfEvidence) const {
+  // the Hessian has the form of the gradient with the estimated counts
+  // squared in place of the empirical ones
+  lbMeasure_Sptr squared = Estimated.duplicate();
+  squared->multiplyMeasureByNumber(1.0/numOfEvidence);
+  squared->raiseToThePower(2.0);
+  squared->multiplyMeasureByNumber(numOfEvidence);
+  calcDeriv(diag,0,Estimated,*squared);
+  if (counts != NULL) {
+    lbMeasure_Sptr zero = Estimated.duplicate();
+    zero->makeZeroes();
+    calcDeriv(counts,0,Estimated,*zero);
+  }
+}
 
 int lbMeasure::buildCardVec(cardVec const& newCard) {
   _cardSize = newCard.size();
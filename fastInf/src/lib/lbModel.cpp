@@ -89,9 +89,15 @@ void lbModel::CopyFromModel(lbModel const& oldModel)
   _usingObjects = listenersVec();
   copyVectorWithDuplicate(oldModel._mesVec,_mesVec,measurePtrVec);
   _mesNames = oldModel._mesNames;
-  copyVectorWithDuplicate(oldModel._assignedMeasures,_assignedMeasures,assignedMesVec);
   _measureUsage = oldModel._measureUsage;
   _cliqueUsage = oldModel._cliqueUsage;
+  // the cliques use the copied measures (and not copies of their own),
+  // so setting the parameters of the copy changes its cliques
+  _assignedMeasures = assignedMesVec(oldModel._assignedMeasures.size(),NULL);
+  for (uint cliq=0;cliq<oldModel._assignedMeasures.size();cliq++)
+    if ( oldModel._assignedMeasures[cliq] != NULL && cliq < _cliqueUsage.size() && _cliqueUsage[cliq] >= 0 )
+      _assignedMeasures[cliq] = new lbAssignedMeasure(_mesVec[_cliqueUsage[cliq]],
+						      oldModel._assignedMeasures[cliq]->getVars());
 
   // shared
   _sharedParams = oldModel._sharedParams;
@@ -133,6 +139,10 @@ void lbModel::Clean() {
 
 //copy ctor
 lbModel::lbModel(lbModel const& oldModel) 
+  : _deepDest(false),
+    _cardsList(NULL),
+    _graph(NULL),
+    _measDispatcher(NULL)
 {
   CopyFromModel(oldModel);
 }
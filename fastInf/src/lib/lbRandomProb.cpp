@@ -109,6 +109,7 @@ lbRandomGenerator::lbRandomGenerator (unsigned long int seed) {
 }
 
 void lbRandomGenerator::Initialize (unsigned long int seed) {
+  _seed_ = seed ;
   gsl_rng_set (_rng_, seed) ;
 }
     
@@ -128,6 +129,107 @@ unsigned long int lbRandomGenerator::RandomInt(unsigned long int range)
 }
 #endif
 
+// Philox4x32-10 constants
+static const uint32_t PHILOX_M0 = 0xD2511F53u;
+static const uint32_t PHILOX_M1 = 0xCD9E8D57u;
+static const uint32_t PHILOX_W0 = 0x9E3779B9u;
+static const uint32_t PHILOX_W1 = 0xBB67AE85u;
+
+void lbCounterGenerator::philox(uint32_t const counter[4], uint32_t const key[2], uint32_t out[4])
+{
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  uint32_t k0 = key[0], k1 = key[1];
+  for (int round = 0; round < 10; round++) {
+    uint64_t p0 = (uint64_t) PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t) PHILOX_M1 * c2;
+    uint32_t hi0 = (uint32_t) (p0 >> 32), lo0 = (uint32_t) p0;
+    uint32_t hi1 = (uint32_t) (p1 >> 32), lo1 = (uint32_t) p1;
+    c0 = hi1 ^ c1 ^ k0;
+    c1 = lo1;
+    c2 = hi0 ^ c3 ^ k1;
+    c3 = lo0;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+void lbCounterGenerator::Initialize(unsigned long int seed, unsigned long int stream)
+{
+  _seed = seed;
+  _key[0] = (uint32_t) _seed;
+  _key[1] = (uint32_t) (_seed >> 32);
+  _counter[2] = (uint32_t) stream;
+  _counter[3] = (uint32_t) ((uint64_t) stream >> 32);
+  seek(0);
+}
+
+void lbCounterGenerator::seek(uint64_t block)
+{
+  _counter[0] = (uint32_t) block;
+  _counter[1] = (uint32_t) (block >> 32);
+  _used = 4;  // the block is made on the first draw
+}
+
+unsigned long int lbCounterGenerator::RandomInt(unsigned long int range)
+{
+  assert(range > 0 && (uint64_t) range <= ((uint64_t) 1 << 32));
+  // reject the top numbers that would make the lower values more likely
+  uint64_t limit = (((uint64_t) 1 << 32) / range) * range;
+  uint32_t x;
+  do {
+    x = RandomLong();
+  } while (x >= limit);
+  return x % range;
+}
+
+void lbCounterGenerator::Fill(double* out, int n)
+{
+  int i = 0;
+  // finish the pairs of the current block first
+  while (i < n && _used + 1 < 4) {
+    out[i++] = toDouble(_block[_used], _block[_used + 1]);
+    _used += 2;
+  }
+  // then two numbers from every block, without going through
+  // RandomLong. After an odd number of draws the last word of a block
+  // is the high half of the first number of the next one, and is left
+  // unused (_used is 3) between blocks.
+  bool carry = (_used == 3);
+  while (i + 1 < n) {
+    uint32_t high = _block[3];
+    nextBlock();
+    if (carry) {
+      out[i++] = toDouble(high, _block[0]);
+      out[i++] = toDouble(_block[1], _block[2]);
+      _used = 3;
+    }
+    else {
+      out[i++] = toDouble(_block[0], _block[1]);
+      out[i++] = toDouble(_block[2], _block[3]);
+      _used = 4;
+    }
+  }
+  if (i < n) {
+    uint32_t high = RandomLong();
+    uint32_t low = RandomLong();
+    out[i++] = toDouble(high, low);
+  }
+}
+
+void lbCounterGenerator::Fill(long double* out, int n)
+{
+  // through a small buffer of doubles
+  double buffer[64];
+  for (int i = 0; i < n; i += 64) {
+    int size = (n - i < 64 ? n - i : 64);
+    Fill(buffer, size);
+    for (int j = 0; j < size; j++) {
+      out[i + j] = buffer[j];
+    }
+  }
+}
+
 long double
 lbRandomGenerator::RandomProb(void)
 {
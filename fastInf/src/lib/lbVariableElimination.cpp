@@ -19,11 +19,80 @@ along with FastInf.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <lbVariableElimination.h> 
+#include <lbBasicGraph.h>
+#include <algorithm>
 using namespace lbLib;
 
+static const realVal LN_10 = log(10.0);
+
+namespace {
+
+  /*
+    Greedy elimination heuristic that only picks among the variables
+    we actually sum out. The query variables stay in the graph so the
+    fill and weight of the factors they end up in are still counted.
+  */
+  class lbQueryEliminationHeuristic : public lbJunctionTree::EliminationHeuristic {
+  public:
+    lbQueryEliminationHeuristic(lbJunctionTree::JTmethod method, set<int> const& candidates)
+      : _method(method), _candidates(candidates) {}
+
+    virtual ~lbQueryEliminationHeuristic() {}
+
+    int chooseNextVertexToEliminate(const lbBasicGraph& eliminatedSoFar) {
+      calculateEliminationValue criterion1 = CalculatePossibleCliqueFillEdges;
+      calculateEliminationValue criterion2 = CalculatePossibleCliqueSize;
+      switch (_method) {
+      case lbJunctionTree::eMinWeight:
+	criterion1 = CalculatePossibleCliqueLogWeight;
+	criterion2 = CalculatePossibleCliqueFillEdges;
+	break;
+      case lbJunctionTree::eMinSize:
+	criterion1 = CalculatePossibleCliqueSize;
+	criterion2 = CalculatePossibleCliqueFillEdges;
+	break;
+      default:
+	break;
+      }
+
+      int best = -1;
+      realVal bestValue1 = HUGE_VAL;
+      realVal bestValue2 = HUGE_VAL;
+      for (set<int>::const_iterator it = _candidates.begin(); it != _candidates.end(); ++it) {
+	if (_method == lbJunctionTree::eSeq) {
+	  best = *it;
+	  break;
+	}
+	realVal value1 = (*criterion1)(*it, eliminatedSoFar);
+	if (best == -1 || value1 < bestValue1) {
+	  best = *it;
+	  bestValue1 = value1;
+	  bestValue2 = (*criterion2)(*it, eliminatedSoFar);
+	}
+	else if (!(bestValue1 < value1)) {
+	  realVal value2 = (*criterion2)(*it, eliminatedSoFar);
+	  if (value2 < bestValue2) {
+	    best = *it;
+	    bestValue2 = value2;
+	  }
+	}
+      }
+      
+      if (best != -1) {
+	_candidates.erase(best);
+      }
+      return best;
+    }
+
+  private:
+    lbJunctionTree::JTmethod _method;
+    set<int> _candidates;
+  };
+}
+
 lbVariableElimination::lbVariableElimination(lbModel& model,
 						   lbMeasureDispatcher const& disp)
-  : _disp(disp)
+  : _disp(disp), _method(lbJunctionTree::eMinFill), _prune(true), _planHits(0)
 {
   const lbGraphStruct & graph = model.getGraph();
   int numCliques = graph.getNumOfCliques();
@@ -34,15 +103,18 @@ lbVariableElimination::lbVariableElimination(lbModel& model,
   }
 
   _vars = graph.getVars().getVarsVec();
+  _cards = model.getCardVec();
+  initVarFactors();
 }
 
 lbVariableElimination::lbVariableElimination(lbRegionModel const& rgnmodel,
 					     lbMeasureDispatcher const& disp)
-  : _disp(disp) {
+  : _disp(disp), _method(lbJunctionTree::eMinFill), _prune(true), _planHits(0) {
   uint  i;
   for (i = 0; i < rgnmodel.getCards().size(); i++) {
     _vars.push_back(i);
   }
+  _cards = rgnmodel.getCards();
 
   lbAssignedMeasureConstPtrVec ampv = rgnmodel.getAllFactors();
   _measures.resize(ampv.size());
@@ -50,36 +122,346 @@ lbVariableElimination::lbVariableElimination(lbRegionModel const& rgnmodel,
   for (i = 0; i < ampv.size(); i++) {
     _measures[i] = ampv[i]->duplicate();
   }
+  initVarFactors();
 }
 
-lbAssignedMeasure_ptr lbVariableElimination::prob(varsVec const& remaining)
+lbVariableElimination::~lbVariableElimination()
+{
+  clearPlans();
+  for (uint i = 0; i < _measures.size(); i++) {
+    delete _measures[i];
+  }
+}
+
+void lbVariableElimination::initVarFactors()
 {
-  lbAssignedMeasurePtrVec measures(_measures.size());
+  _varFactors = intVecVec(_cards.size());
+  for (uint f = 0; f < _measures.size(); f++) {
+    varsVec const& scope = _measures[f]->getVars();
+    for (uint j = 0; j < scope.size(); j++) {
+      _varFactors[scope[j]].push_back(f);
+    }
+  }
+}
 
-  for (uint index = 0; index < _measures.size(); index++) {
-    measures[index] = _measures[index]->duplicate();
+void lbVariableElimination::setEliminationMethod(lbJunctionTree::JTmethod method)
+{
+  if (method != lbJunctionTree::eMinFill && method != lbJunctionTree::eMinWeight &&
+      method != lbJunctionTree::eMinSize && method != lbJunctionTree::eSeq) {
+    cerr << "Elimination method " << method << " is not supported by variable elimination, using min-fill" << endl;
+    method = lbJunctionTree::eMinFill;
+  }
+  if (method != _method) {
+    _method = method;
+    clearPlans();
   }
+}
 
-  for (uint i = 0; i < _vars.size(); i++) {
-    bool leaveAlone = false;
+void lbVariableElimination::setPruning(bool prune)
+{
+  if (prune != _prune) {
+    _prune = prune;
+    clearPlans();
+  }
+}
 
-    for (uint j = 0; j < remaining.size(); j++) {
-      if (remaining[j] == _vars[i]) {
-	leaveAlone = true;
-	break;
+void lbVariableElimination::clearPlans()
+{
+  for (planMap::iterator it = _plans.begin(); it != _plans.end(); ++it) {
+    delete it->second;
+  }
+  _plans.clear();
+}
+
+lbAssignedMeasure_ptr lbVariableElimination::prob(varsVec const& remaining)
+{
+  return prob(remaining, lbAssignment());
+}
+
+lbAssignedMeasure_ptr lbVariableElimination::prob(varsVec const& remaining,
+						  lbAssignment const& evidence)
+{
+  boolVec observed = observedVars(remaining, evidence);
+  lbEliminationPlan const& plan = getPlan(remaining, observed);
+
+  // Slice the evidence out of the factors that take part in the query
+  lbAssignedMeasurePtrVec measures;
+  measures.reserve(plan._factors.size() + 1);
+  for (uint i = 0; i < plan._factors.size(); i++) {
+    lbAssignedMeasure_ptr mes = _measures[plan._factors[i]];
+    varsVec const& scope = mes->getVars();
+    varsVec kept;
+    for (uint j = 0; j < scope.size(); j++) {
+      if (!observed[scope[j]]) {
+	kept.push_back(scope[j]);
       }
     }
-
-    if (!leaveAlone) {
-      marginalizeSingleVariable(measures, _vars[i]);
+    
+    if (kept.size() == scope.size()) {
+      measures.push_back(mes->duplicate());
+    }
+    else {
+      measures.push_back(mes->marginalize(kept, evidence, _disp));
     }
   }
+
+  for (uint i = 0; i < plan._order.size(); i++) {
+    marginalizeSingleVariable(measures, plan._order[i]);
+  }
+
+  // Start the product from an indicator of the evidence over the
+  // query so that the result is over exactly these variables (in
+  // this order)
+  cardVec cards(remaining.size());
+  for (uint i = 0; i < remaining.size(); i++) {
+    cards[i] = _cards[remaining[i]];
+  }
+  lbAssignedMeasure_ptr indicator = new lbAssignedMeasure(_disp.getNewMeasure(cards, false), remaining);
+  indicator->makeUniform();
+  if (evidence.hasAnyAssigned(remaining)) {
+    indicator->updateAssign(evidence);
+  }
+  measures.push_back(indicator);
   
   lbAssignedMeasure_ptr result = multiplyInvolvedMeasures(measures);
   result->normalize();
   return result;
 }
 
+realVal lbVariableElimination::queryLogWeight(varsVec const& vars, lbAssignment const& evidence)
+{
+  return getPlan(vars, observedVars(vars, evidence))._logWeight;
+}
+
+boolVec lbVariableElimination::observedVars(varsVec const& vars, lbAssignment const& evidence) const
+{
+  boolVec observed(_cards.size(), false);
+  if (evidence.isEmpty()) {
+    return observed;
+  }
+  for (uint v = 0; v < _cards.size(); v++) {
+    observed[v] = evidence.isAssigned(v);
+  }
+  for (uint i = 0; i < vars.size(); i++) {
+    observed[vars[i]] = false;
+  }
+  return observed;
+}
+
+lbVariableElimination::lbEliminationPlan const&
+lbVariableElimination::getPlan(varsVec const& vars, boolVec const& observed)
+{
+  planKey key;
+  for (uint i = 0; i < vars.size(); i++) {
+    key.first.push_back(vars[i]);
+  }
+  for (uint v = 0; v < observed.size(); v++) {
+    if (observed[v]) {
+      key.second.push_back(v);
+    }
+  }
+
+  planMap::const_iterator it = _plans.find(key);
+  if (it != _plans.end()) {
+    _planHits++;
+    return *it->second;
+  }
+  
+  lbEliminationPlan* plan = compilePlan(vars, observed);
+  _plans[key] = plan;
+  return *plan;
+}
+
+lbVariableElimination::lbEliminationPlan*
+lbVariableElimination::compilePlan(varsVec const& vars, boolVec const& observed) const
+{
+  boolVec query(_cards.size(), false);
+  for (uint i = 0; i < vars.size(); i++) {
+    query[vars[i]] = true;
+  }
+
+  boolVec active(_measures.size(), true);
+  if (_prune) {
+    pruneBarrenFactors(active, query, observed);
+    pruneSeparatedFactors(active, vars, observed);
+  }
+
+  lbEliminationPlan* plan = new lbEliminationPlan();
+  boolVec eliminate(_cards.size(), false);
+  for (uint f = 0; f < _measures.size(); f++) {
+    if (!active[f]) {
+      continue;
+    }
+
+    // Factors that are fully observed are constants
+    varsVec const& scope = _measures[f]->getVars();
+    bool hidden = false;
+    for (uint j = 0; j < scope.size(); j++) {
+      if (!observed[scope[j]]) {
+	hidden = true;
+	if (!query[scope[j]]) {
+	  eliminate[scope[j]] = true;
+	}
+      }
+    }
+    if (hidden) {
+      plan->_factors.push_back(f);
+    }
+  }
+
+  plan->_order = orderEliminations(plan->_factors, eliminate, observed, plan->_logWeight);
+
+  if (isVerbose(V_PROPAGATION)) {
+    cerr << "VE plan for ( ";
+    printVector(vars, cerr);
+    cerr << "  factors: " << plan->_factors.size() << " / " << _measures.size()
+	 << " eliminations: " << plan->_order.size()
+	 << " weight: 10^(" << plan->_logWeight << ")" << endl;
+  }
+  
+  return plan;
+}
+
+void lbVariableElimination::pruneBarrenFactors(boolVec & active, boolVec const& query,
+					       boolVec const& observed) const
+{
+  // A directed factor sums to one over its child, so if nobody else
+  // looks at the child the whole factor can go. Removing it can make
+  // its parents barren as well.
+  intVec uses(_cards.size(), 0);
+  uint f;
+  for (f = 0; f < _measures.size(); f++) {
+    varsVec const& scope = _measures[f]->getVars();
+    for (uint j = 0; j < scope.size(); j++) {
+      uses[scope[j]]++;
+    }
+  }
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (f = 0; f < _measures.size(); f++) {
+      if (!active[f] || !_measures[f]->isDirected()) {
+	continue;
+      }
+      varsVec const& scope = _measures[f]->getVars();
+      rVarIndex child = scope.back();
+      if (query[child] || observed[child] || uses[child] != 1) {
+	continue;
+      }
+
+      active[f] = false;
+      changed = true;
+      for (uint j = 0; j < scope.size(); j++) {
+	uses[scope[j]]--;
+      }
+    }
+  }
+}
+
+void lbVariableElimination::pruneSeparatedFactors(boolVec & active, varsVec const& vars,
+						  boolVec const& observed) const
+{
+  // Walk from the query through unobserved variables. Anything we
+  // can't reach is separated from the query by the evidence.
+  boolVec reached(_cards.size(), false);
+  varsVec stack;
+  for (uint i = 0; i < vars.size(); i++) {
+    if (!reached[vars[i]]) {
+      reached[vars[i]] = true;
+      stack.push_back(vars[i]);
+    }
+  }
+
+  while (!stack.empty()) {
+    rVarIndex var = stack.back();
+    stack.pop_back();
+
+    intVec const& factors = _varFactors[var];
+    for (uint i = 0; i < factors.size(); i++) {
+      if (!active[factors[i]]) {
+	continue;
+      }
+      varsVec const& scope = _measures[factors[i]]->getVars();
+      for (uint j = 0; j < scope.size(); j++) {
+	if (!observed[scope[j]] && !reached[scope[j]]) {
+	  reached[scope[j]] = true;
+	  stack.push_back(scope[j]);
+	}
+      }
+    }
+  }
+
+  for (uint f = 0; f < _measures.size(); f++) {
+    if (!active[f]) {
+      continue;
+    }
+    varsVec const& scope = _measures[f]->getVars();
+    bool touches = false;
+    for (uint j = 0; j < scope.size() && !touches; j++) {
+      touches = (!observed[scope[j]] && reached[scope[j]]);
+    }
+    active[f] = touches;
+  }
+}
+
+varsVec lbVariableElimination::orderEliminations(intVec const& factors, boolVec const& eliminate,
+						 boolVec const& observed, realVal & logWeight) const
+{
+  // Interaction graph of the unobserved variables of the factors
+  set<int>** adjacencyList = lbBasicGraph::createNewAdjacencyList(_cards.size(), false);
+  set<int> candidates;
+  for (uint i = 0; i < factors.size(); i++) {
+    varsVec const& scope = _measures[factors[i]]->getVars();
+    for (uint j = 0; j < scope.size(); j++) {
+      int v = scope[j];
+      if (observed[v]) {
+	continue;
+      }
+      if (adjacencyList[v] == NULL) {
+	adjacencyList[v] = new set<int>();
+      }
+      if (eliminate[v]) {
+	candidates.insert(v);
+      }
+      for (uint k = 0; k < scope.size(); k++) {
+	if (k != j && !observed[scope[k]]) {
+	  adjacencyList[v]->insert(scope[k]);
+	}
+      }
+    }
+  }
+  lbBasicGraph g(adjacencyList, new cardVec(_cards));
+  
+  lbQueryEliminationHeuristic heur(_method, candidates);
+  varsVec order;
+  logWeight = -HUGE_VAL;
+  for (uint i = 0; i < candidates.size(); i++) {
+    int next = heur.chooseNextVertexToEliminate(g);
+    lbBasicGraph::Clique* clique = g.eliminateVertex(next);
+    // next is no longer in g, so its cardinality is taken from _cards
+    realVal cliqueWeight = 0;
+    for (lbBasicGraph::Clique::const_iterator it = clique->begin(); it != clique->end(); ++it) {
+      cliqueWeight += log((realVal) _cards[*it]);
+    }
+    logWeight = lbAddLog(logWeight, cliqueWeight);
+    delete clique;
+    order.push_back(next);
+  }
+
+  // and the final factor over the query
+  lbBasicGraph::Clique remaining;
+  for (lbBasicGraph::vertexIterator vi = g.verticesBegin(); vi != g.verticesEnd(); ++vi) {
+    remaining.insert(*vi);
+  }
+  if (!remaining.empty()) {
+    logWeight = lbAddLog(logWeight, lbJunctionTree::CalculateLogWeightOfClique(&remaining, g));
+  }
+  logWeight /= LN_10;
+  
+  return order;
+}
+
 
 bool lbVariableElimination::isVariableInScope(lbAssignedMeasure_ptr mes, rVarIndex var) 
 {
@@ -152,6 +534,10 @@ void lbVariableElimination::marginalizeSingleVariable(lbAssignedMeasurePtrVec &
     }
   }
 
-  measures.push_back(multiplied->marginalize(remaining, _disp));
+  /* Summing out the last variable of a factor leaves a constant,
+     which normalization takes care of anyway */
+  if (!remaining.empty()) {
+    measures.push_back(multiplied->marginalize(remaining, _disp));
+  }
   delete multiplied;
 }
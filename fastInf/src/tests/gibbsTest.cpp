@@ -0,0 +1,351 @@
+#include <lbDriver.h>
+#include <lbModel.h>
+#include <lbJunctionTree.h>
+#include <lbBeliefPropagation.h>
+#include <lbGibbsSampler.h>
+#include <lbGibbsInference.h>
+using namespace lbLib;
+
+const probType EPSILON = 0.05;
+const int NUM_OF_CHAINS = 4;
+const int BURN_IN = 2000;
+const int LAG = 10;
+const int NUM_OF_SAMPLES = 5000;
+
+// the same seed has to give the same chains whatever the number of threads
+bool checkReproducible(lbModel const& model, lbGibbsSampler::lbGibbsScan scan) {
+  lbGibbsSampler serial(model, NUM_OF_CHAINS, 17);
+  serial.setScan(scan);
+  serial.setNumThreads(1);
+  serial.run(500);
+
+  lbGibbsSampler parallel(model, NUM_OF_CHAINS, 17);
+  parallel.setScan(scan);
+  parallel.setNumThreads(NUM_OF_CHAINS);
+  parallel.run(500);
+
+  // a single chain runs its color classes in parallel
+  lbGibbsSampler single(model, 1, 17);
+  single.setScan(scan);
+  single.setNumThreads(NUM_OF_CHAINS);
+  single.run(500);
+
+  int numOfVars = model.getGraph().getNumOfVars();
+  bool same = true;
+  bool differentChains = false;
+  for (int chain = 0; chain < NUM_OF_CHAINS; chain++) {
+    for (rVarIndex var = 0; var < numOfVars; var++) {
+      same &= (serial.getValue(chain, var) ==
+	       parallel.getValue(chain, var));
+      differentChains |= (serial.getValue(chain, var) !=
+			  serial.getValue(0, var));
+    }
+  }
+  for (rVarIndex var = 0; var < numOfVars; var++) {
+    same &= (serial.getValue(0, var) ==
+	     single.getValue(0, var));
+  }
+  if (!same) {
+    cout << "Chains depend on the number of threads" << endl;
+  }
+  if (!differentChains) {
+    cout << "All chains are identical" << endl;
+  }
+  return same && differentChains;
+}
+
+// compare the empirical single variable marginals of the chains (only
+// the coldest one when tempering) with exact inference
+bool checkMarginals(lbGibbsSampler& sampler, lbModel const& model,
+		    lbBeliefPropagation& einf, bool tempering = false) {
+  lbCardsList const& cards = model.getCards();
+  int numOfVars = model.getGraph().getNumOfVars();
+  vector<probVector> counts(numOfVars);
+  for (rVarIndex var = 0; var < numOfVars; var++) {
+    counts[var] = probVector(cards.getCardForVar(var), 0);
+  }
+
+  int numOfChains = (tempering ? 1 : NUM_OF_CHAINS);
+  if (tempering) {
+    sampler.runTempering(BURN_IN);
+  }
+  else {
+    sampler.run(BURN_IN);
+  }
+  int total = 0;
+  for (int i = 0; i < NUM_OF_SAMPLES / numOfChains; i++) {
+    if (tempering) {
+      sampler.runTempering(LAG);
+    }
+    else {
+      sampler.run(LAG);
+    }
+    for (int chain = 0; chain < numOfChains; chain++) {
+      for (rVarIndex var = 0; var < numOfVars; var++) {
+	counts[var][sampler.getValue(chain, var)]++;
+      }
+      total++;
+    }
+  }
+
+  bool ok = true;
+  for (rVarIndex var = 0; var < numOfVars; var++) {
+    lbAssignedMeasure_ptr exact = einf.prob(varsVec(1, var));
+    lbAssignment assign;
+    for (varValue val = 0; val < cards.getCardForVar(var); val++) {
+      assign.setValueForVar(var, val);
+      probType diff = fabs(exact->valueOfFull(assign) - counts[var][val] / total);
+      if (diff > EPSILON) {
+	cout << "Mismatch on var " << var << " value " << val << ": " << diff << endl;
+	ok = false;
+      }
+    }
+    delete exact;
+  }
+  return ok;
+}
+
+// the blocks cover every variable once and are trees of the model
+bool checkBlocks(lbGibbsSampler const& sampler, lbModel const& model) {
+  lbGraphStruct const& graph = model.getGraph();
+  int numOfVars = graph.getNumOfVars();
+  intVec blockOf(numOfVars, -1);
+  bool ok = true;
+  for (int block = 0; block < sampler.getNumOfBlocks(); block++) {
+    intVec const& vars = sampler.getBlock(block);
+    for (uint i = 0; i < vars.size(); i++) {
+      ok &= (blockOf[vars[i]] < 0);
+      blockOf[vars[i]] = block;
+    }
+  }
+  for (rVarIndex var = 0; var < numOfVars; var++) {
+    ok &= (blockOf[var] >= 0);
+  }
+
+  // a tree has one edge less than it has variables
+  intVec edges(sampler.getNumOfBlocks(), 0);
+  for (cliqIndex cliq = 0; cliq < graph.getNumOfCliques(); cliq++) {
+    varsVec const& vars = graph.getVarsVecForClique(cliq);
+    for (uint i = 0; i < vars.size(); i++) {
+      for (uint j = i + 1; j < vars.size(); j++) {
+	if (blockOf[vars[i]] == blockOf[vars[j]]) {
+	  edges[blockOf[vars[i]]]++;
+	}
+      }
+    }
+  }
+  for (int block = 0; block < sampler.getNumOfBlocks(); block++) {
+    ok &= (edges[block] == (int) sampler.getBlock(block).size() - 1);
+  }
+  if (sampler.getNumOfBlocks() >= numOfVars) {
+    cout << "Blocks are single variables" << endl;
+    ok = false;
+  }
+  if (!ok) {
+    cout << "Blocks are not a partition into trees" << endl;
+  }
+  return ok;
+}
+
+// the anytime engine under evidence, against exact inference with the
+// same evidence. The error should be within a few standard errors.
+bool checkInference(lbModel const& model, lbBeliefPropagation& einf) {
+  lbGibbsInference gibbs(model, NUM_OF_CHAINS, 13);
+  lbAssignment evidence;
+  evidence.setValueForVar(0, 1);
+  evidence.setValueForVar(4, 0);
+  gibbs.changeEvidence(evidence);
+  einf.changeEvidence(evidence);
+  gibbs.runSweeps(100, 2000);
+
+  bool ok = true;
+  lbCardsList const& cards = model.getCards();
+  for (rVarIndex var = 0; var < model.getGraph().getNumOfVars(); var++) {
+    probVector marginal = gibbs.getMarginal(var);
+    probVector error = gibbs.getStdError(var);
+    lbAssignedMeasure_ptr exact = einf.prob(varsVec(1, var));
+    lbAssignment assign;
+    for (varValue val = 0; val < cards.getCardForVar(var); val++) {
+      assign.setValueForVar(var, val);
+      probType diff = fabs(exact->valueOfFull(assign) - marginal[val]);
+      if (diff > 5 * error[val] + 0.005 || error[val] > 0.01) {
+	cout << "Mismatch on var " << var << " value " << val << ": " << diff
+	     << " (standard error " << error[val] << ")" << endl;
+	ok = false;
+      }
+    }
+    delete exact;
+  }
+  einf.resetEvidence();
+  return ok;
+}
+
+// the log likelihoods kept along the run must match the chains
+bool checkLogLikelihoods(lbGibbsSampler& sampler) {
+  bool ok = true;
+  for (int chain = 0; chain < sampler.getNumOfChains(); chain++) {
+    probType diff = fabs(sampler.getLogLikelihood(chain) - sampler.computeLogLikelihood(chain));
+    if (diff > 1e-8) {
+      cout << "Log likelihood of chain " << chain << " is off by " << diff << endl;
+      ok = false;
+    }
+  }
+  if (sampler.getSwapAccepts() == 0) {
+    cout << "No replicas were swapped" << endl;
+    ok = false;
+  }
+  return ok;
+}
+
+// the statistics kept from assignments and from values must agree
+bool checkStatistics(lbModel const& model) {
+  lbGibbsSampler sampler(model, NUM_OF_CHAINS, 11);
+  vector<intVec> values(NUM_OF_CHAINS);
+  int numOfVars = model.getGraph().getNumOfVars();
+  for (int chain = 0; chain < NUM_OF_CHAINS; chain++) {
+    for (rVarIndex var = 0; var < numOfVars; var++) {
+      values[chain].push_back(sampler.getValue(chain, var));
+    }
+  }
+  lbGibbsConvergeStatistic fromAssigns(sampler.getChains(), model);
+  lbGibbsConvergeStatistic fromValues(values, model);
+  for (int i = 0; i < 100; i++) {
+    sampler.run(5);
+    for (int chain = 0; chain < NUM_OF_CHAINS; chain++) {
+      for (rVarIndex var = 0; var < numOfVars; var++) {
+	values[chain][var] = sampler.getValue(chain, var);
+      }
+    }
+    fromAssigns.updateStats(sampler.getChains());
+    fromValues.updateStats(values);
+  }
+
+  ostringstream assignsOut, valuesOut;
+  fromAssigns.printStats(assignsOut);
+  fromValues.printStats(valuesOut);
+  bool ok = (assignsOut.str() == valuesOut.str() &&
+	     fromAssigns.didConverge() == fromValues.didConverge());
+
+  // every cliques counts once in every sample
+  if (fromValues.getNumOfStatistics() != model.getSize()) {
+    ok = false;
+  }
+
+  // a subset can only be easier to pass
+  measIndicesVec first(1, 0);
+  fromValues.setMeasures(first);
+  if (fromAssigns.didConverge() && !fromValues.didConverge()) {
+    ok = false;
+  }
+  if (!ok) {
+    cout << "Convergence statistics disagree" << endl;
+  }
+  return ok;
+}
+
+int main (int argc,char** argv) {
+  if (argc != 2 && argc != 3) {
+    cout << "USAGE : gibbsTest <network file> [<large network file>]\n";
+    exit(1);
+  }
+
+  _lbRandomProbGenerator.Initialize(0);
+
+  lbMeasureDispatcher MD;
+  lbDriver driver(MD);
+  driver.readUniverse(argv[1]);
+  lbModel& model = driver.getModel();
+
+  lbModel* emodel = lbJunctionTree::CalcJunctionTreeGraphicalModel(&model);
+  lbBeliefPropagation einf(*emodel, MD);
+  einf.calcProbs();
+
+  bool ok = true;
+
+  cout << "*** Reproducibility" << endl;
+  ok &= checkReproducible(model, lbGibbsSampler::GS_RANDOM);
+  ok &= checkReproducible(model, lbGibbsSampler::GS_CHROMATIC);
+  ok &= checkReproducible(model, lbGibbsSampler::GS_BLOCKED);
+
+  cout << "*** Gibbs marginals" << endl;
+  lbGibbsSampler sampler(model, NUM_OF_CHAINS, 3);
+  ok &= checkMarginals(sampler, model, einf);
+
+  cout << "*** Chromatic marginals" << endl;
+  lbGibbsSampler chromatic(model, NUM_OF_CHAINS, 4);
+  chromatic.setScan(lbGibbsSampler::GS_CHROMATIC);
+  ok &= checkMarginals(chromatic, model, einf);
+
+  cout << "*** Blocked marginals" << endl;
+  lbGibbsSampler blocked(model, NUM_OF_CHAINS, 6);
+  blocked.setScan(lbGibbsSampler::GS_BLOCKED);
+  ok &= checkBlocks(blocked, model);
+  ok &= checkMarginals(blocked, model, einf);
+  // blocks of two variables
+  lbGibbsSampler pairs(model, NUM_OF_CHAINS, 8);
+  pairs.setScan(lbGibbsSampler::GS_BLOCKED);
+  pairs.setMaxBlockSize(2);
+  ok &= checkBlocks(pairs, model);
+  ok &= checkMarginals(pairs, model, einf);
+
+  cout << "*** Metropolis marginals" << endl;
+  lbGibbsSampler metropolis(model, NUM_OF_CHAINS, 5);
+  metropolis.setMetropolis(true);
+  ok &= checkMarginals(metropolis, model, einf);
+
+  cout << "*** Replica exchange marginals" << endl;
+  lbGibbsSampler tempering(model, NUM_OF_CHAINS, 9);
+  tempering.setGeometricLadder(4);
+  tempering.setSwapInterval(20);
+  ok &= checkMarginals(tempering, model, einf, true);
+  ok &= checkLogLikelihoods(tempering);
+  cout << "Accepted " << tempering.getSwapAccepts() << " of "
+       << tempering.getSwapAttempts() << " swaps" << endl;
+
+  cout << "*** Chromatic replica exchange" << endl;
+  lbGibbsSampler chromaticTempering(model, NUM_OF_CHAINS, 10);
+  chromaticTempering.setScan(lbGibbsSampler::GS_CHROMATIC);
+  chromaticTempering.setGeometricLadder(4);
+  chromaticTempering.runTempering(BURN_IN);
+  ok &= checkLogLikelihoods(chromaticTempering);
+
+  cout << "*** Blocked replica exchange" << endl;
+  lbGibbsSampler blockedTempering(model, NUM_OF_CHAINS, 12);
+  blockedTempering.setScan(lbGibbsSampler::GS_BLOCKED);
+  blockedTempering.setGeometricLadder(4);
+  blockedTempering.runTempering(BURN_IN);
+  ok &= checkLogLikelihoods(blockedTempering);
+
+  cout << "*** Anytime inference with evidence" << endl;
+  ok &= checkInference(model, einf);
+
+  cout << "*** Convergence statistics" << endl;
+  ok &= checkStatistics(model);
+
+  cout << "*** Convergence test" << endl;
+  lbGibbsSampler converge(model, NUM_OF_CHAINS, 7);
+  int steps = converge.runUntilConverged(100000);
+  cout << "Converged after " << steps << " steps" << endl;
+  if (!converge.didConverge()) {
+    cout << "Chains did not converge" << endl;
+    ok = false;
+  }
+
+  delete emodel;
+
+  if (argc == 3) {
+    // color classes that are large enough to be updated in parallel
+    cout << "*** Reproducibility on " << argv[2] << endl;
+    lbDriver largeDriver(MD);
+    largeDriver.readUniverse(argv[2]);
+    ok &= checkReproducible(largeDriver.getModel(), lbGibbsSampler::GS_CHROMATIC);
+    ok &= checkReproducible(largeDriver.getModel(), lbGibbsSampler::GS_BLOCKED);
+  }
+
+  if (!ok) {
+    cout << "Test FAILED" << endl;
+    return 1;
+  }
+  cout << "***\n";
+  return 0;
+}
@@ -3,6 +3,38 @@
 #include <lbJunctionTree.h>
 using namespace lbLib;
 
+// a model written to a binary model and read back prints the same, with
+// all the digits of its log values
+bool checkBinaryModel(lbModel const& model,lbMeasureDispatcher const& MD) {
+  cout << "*** Writing and reading a binary model" << endl;
+  char const* fileName = "modelTest.bin";
+  if (!lbDriver::writeBinaryUniverse(model, fileName)) {
+    cout << "Could not write the binary model" << endl;
+    return false;
+  }
+  lbDriver binaryDriver(MD);
+  bool read = binaryDriver.readUniverse(fileName);
+  remove(fileName);
+  if (!read) {
+    cout << "Could not read the binary model" << endl;
+    return false;
+  }
+  lbModel const& binaryModel = binaryDriver.getModel();
+
+  ostringstream original, binary;
+  model.printModelToFastInfFormat(original, false, 20, true);
+  binaryModel.printModelToFastInfFormat(binary, false, 20, true);
+  bool ok = (original.str() == binary.str());
+  ok &= (model.getExactBeliefs().size() == binaryModel.getExactBeliefs().size());
+  for (uint i = 0; ok && i < model.getExactBeliefs().size(); i++) {
+    ok &= !model.getExactBeliefs()[i]->getMeasure().isDifferent(binaryModel.getExactBeliefs()[i]->getMeasure(), C_MAX, 0);
+  }
+  if (!ok) {
+    cout << "The binary model differs from the original" << endl;
+  }
+  return ok;
+}
+
 
 int main (int argc,char** argv) {
   if (argc != 2) {
@@ -145,6 +177,11 @@ int main (int argc,char** argv) {
   emodel->printModelToFastInfFormat(cout);
   delete emodel;
 
+  if (!checkBinaryModel(LBModel, MD)) {
+    cout << "Test FAILED" << endl;
+    return 1;
+  }
+
   delete graphPtr;
   delete cardsPtr;
   delete varsPtr;
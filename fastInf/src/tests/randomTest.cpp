@@ -0,0 +1,131 @@
+#include <lbDefinitions.h>
+#include <lbRandomProb.h>
+using namespace lbLib;
+
+const int NUM_OF_DRAWS = 100000;
+
+// known answers of Philox4x32-10 (Random123)
+bool checkKnownAnswers() {
+  uint32_t counter[4] = { 0, 0, 0, 0 };
+  uint32_t key[2] = { 0, 0 };
+  uint32_t out[4];
+  lbCounterGenerator::philox(counter, key, out);
+  bool ok = (out[0] == 0x6627e8d5u && out[1] == 0xe169c58du &&
+	     out[2] == 0xbc57ac4cu && out[3] == 0x9b00dbd8u);
+
+  uint32_t ones[4] = { 0xffffffffu, 0xffffffffu, 0xffffffffu, 0xffffffffu };
+  uint32_t onesKey[2] = { 0xffffffffu, 0xffffffffu };
+  lbCounterGenerator::philox(ones, onesKey, out);
+  ok &= (out[0] == 0x408f276du && out[1] == 0x41c83b0eu &&
+	 out[2] == 0xa20bc7c6u && out[3] == 0x6d5451fdu);
+  if (!ok) {
+    cout << "Philox does not match the known answers" << endl;
+  }
+  return ok;
+}
+
+// a block depends only on its counter, so seeking and filling give the
+// same numbers as drawing them one by one
+bool checkCounters() {
+  lbCounterGenerator one(17, 3);
+  vector<double> drawn(1001);
+  for (uint i = 0; i < drawn.size(); i++) {
+    drawn[i] = one.RandomDouble(1.0);
+  }
+
+  lbCounterGenerator filled(17, 3);
+  vector<double> batch(drawn.size());
+  filled.Fill(batch);
+
+  // a double takes two numbers, so block 10 starts at the 21st
+  lbCounterGenerator seeked(17, 3);
+  seeked.seek(10);
+
+  // a batch that starts in the middle of a block
+  lbCounterGenerator split(17, 3);
+  split.RandomDouble(1.0);
+  vector<double> rest(drawn.size() - 1);
+  split.Fill(rest);
+
+  // and one that starts at an odd number of the block, filled in parts
+  // of odd and even sizes and continued one by one
+  lbCounterGenerator oddDrawn(17, 3), oddFilled(17, 3);
+  oddDrawn.RandomLong();
+  oddFilled.RandomLong();
+  vector<double> odd(drawn.size()), oddBatch(drawn.size());
+  for (uint i = 0; i < odd.size(); i++) {
+    odd[i] = oddDrawn.RandomDouble(1.0);
+  }
+  int sizes[4] = { 1, 2, 7, 500 };
+  uint next = 0;
+  for (int s = 0; s < 4; s++) {
+    oddFilled.Fill(&oddBatch[next], sizes[s]);
+    next += sizes[s];
+  }
+  while (next < oddBatch.size()) {
+    oddBatch[next++] = oddFilled.RandomDouble(1.0);
+  }
+
+  bool ok = (batch == drawn && seeked.RandomDouble(1.0) == drawn[20] &&
+	     vector<double>(drawn.begin() + 1, drawn.end()) == rest &&
+	     oddBatch == odd);
+  if (!ok) {
+    cout << "Filling or seeking does not follow the stream" << endl;
+  }
+  return ok;
+}
+
+// streams of one seed and the same stream of two seeds are different,
+// and all of them are uniform
+bool checkStreams() {
+  lbCounterGenerator base(5);
+  lbCounterGenerator streams[3] = { base, base.split(1), lbCounterGenerator(6) };
+  bool ok = true;
+  vector<double> first(3);
+  for (int s = 0; s < 3; s++) {
+    vector<double> u(NUM_OF_DRAWS);
+    streams[s].Fill(u);
+    first[s] = u[0];
+    double mean = 0;
+    intVec counts(10, 0);
+    for (int i = 0; i < NUM_OF_DRAWS; i++) {
+      ok &= (u[i] >= 0 && u[i] < 1);
+      mean += u[i];
+      counts[streams[s].RandomInt(10)]++;
+    }
+    mean /= NUM_OF_DRAWS;
+    ok &= (fabs(mean - 0.5) < 0.01);
+    for (int c = 0; c < 10; c++) {
+      ok &= (fabs(counts[c] - NUM_OF_DRAWS / 10.0) < 0.05 * NUM_OF_DRAWS / 10.0);
+    }
+  }
+  ok &= (first[0] != first[1] && first[0] != first[2] && first[1] != first[2]);
+
+  // the streams of the global generator follow its seed
+  _lbRandomProbGenerator.Initialize(5);
+  ok &= (lbRandomStream(1).RandomDouble(1.0) == base.split(1).RandomDouble(1.0));
+  if (!ok) {
+    cout << "Streams are not independent uniforms" << endl;
+  }
+  return ok;
+}
+
+int main (int argc,char** argv) {
+  bool ok = true;
+
+  cout << "*** Known answers" << endl;
+  ok &= checkKnownAnswers();
+
+  cout << "*** Counters" << endl;
+  ok &= checkCounters();
+
+  cout << "*** Streams" << endl;
+  ok &= checkStreams();
+
+  if (!ok) {
+    cout << "Test FAILED" << endl;
+    return 1;
+  }
+  cout << "***\n";
+  return 0;
+}
@@ -3,12 +3,224 @@
 #include <lbTableMeasure.h>
 #include <lbBeliefPropagation.h>
 #include <lbGSLLearningObject.h>
+#include <lbEvidenceMatrix.h>
 using namespace lbLib;
 
+// the counts and likelihood of fully observed rows, which lbSuffStat
+// tallies directly, against those of inference on every row
+bool checkFullEvidence(lbModel& model,lbMeasureDispatcher const& MD,
+                       lbSuffStat& suff,char const* evidenceFile) {
+  if (suff.getNumOfFullEvidence() != suff.getNumOfDistinctEvidence())
+    return true;
+
+  cout<<"*** comparing direct counts of full evidence to inference"<<endl;
+  lbBeliefPropagation infObj(model, MD);
+  lbGraphStruct const& graph = model.getGraph();
+  vector<lbTableMeasure<lbValue> > counts;
+  for (int meas=0;meas<model.getNumOfMeasures();meas++) {
+    counts.push_back(lbTableMeasure<lbValue>(model.getMeasure(meas).getCards(),false));
+    counts.back().makeZeroes();
+  }
+  probType ll = 0;
+  ifstream in(evidenceFile);
+  string line;
+  while (getline(in,line)) {
+    lbFullAssignment assign;
+    if (!assign.readAssignmentFromString(line,graph.getNumOfVars()))
+      continue;
+    infObj.changeEvidence(assign);
+    for (cliqIndex cliq=0;cliq<graph.getNumOfCliques();cliq++) {
+      lbAssignedMeasure_ptr belief = infObj.prob(graph.getVarsVecForClique(cliq),cliq);
+      lbTableMeasure<lbValue> tab((lbTableMeasure<lbLogValue> const&)belief->getMeasure());
+      delete belief;
+      counts[model.getMeasureIndexForClique(cliq)].addMeasure(tab);
+    }
+    ll += infObj.evidenceLogProb();
+  }
+
+  bool ok = true;
+  for (int meas=0;meas<model.getNumOfMeasures();meas++) {
+    if (counts[meas].isDifferentAVG(suff.getEmpiricalExpectation(meas),1e-6)) {
+      cout<<"Direct counts differ for measure "<<meas<<endl;
+      ok = false;
+    }
+  }
+  if (fabs(ll - suff.getLogLikelihood()) > 1e-4 * (1 + fabs(ll))) {
+    cout<<"Direct log likelihood "<<suff.getLogLikelihood()<<" is not "<<ll<<endl;
+    ok = false;
+  }
+  return ok;
+}
+
+// the gradients of the local objectives against finite differences of
+// their values, and the same with several threads
+bool checkLocalLikelihood(lbModel& model,lbLocalLikelihood& local,char const* name) {
+  cout<<"*** checking the gradient of the "<<name<<" likelihood"<<endl;
+  int pSize;
+  probType* p = model.getLogParamVector(pSize,true);
+  int n = local.paramNum();
+  vector<long double> grad(n), threaded(n);
+  local.setNumThreads(1);
+  long double value = local.fdf(p,&grad[0]);
+  local.setNumThreads(3);
+  long double threadedValue = local.fdf(p,&threaded[0]);
+  bool ok = (value == threadedValue && grad == threaded);
+  if (!ok)
+    cout<<"Threaded "<<name<<" likelihood differs"<<endl;
+
+  const long double h = 1e-5;
+  for (int i = 0; i < n; i++) {
+    long double old = p[i];
+    p[i] = old + h;
+    long double up = local.f(p);
+    p[i] = old - h;
+    long double down = local.f(p);
+    p[i] = old;
+    long double numeric = (up - down) / (2 * h);
+    if (fabs(numeric - grad[i]) > 1e-4 * (1 + fabs(numeric))) {
+      cout<<"Derivative "<<i<<" of the "<<name<<" likelihood is "<<grad[i]
+          <<" and not "<<numeric<<endl;
+      ok = false;
+    }
+  }
+  local.setNumThreads(0);
+  model.updateLogParamsFromVector(p,true);
+  delete[] p;
+  return ok;
+}
+
+
+// learn a copy of the model with checkpoints, stopping after
+// maxCheckpoints of them (0 - not stopping) or resuming from the last
+// one, and return its parameters. With local the pseudo likelihood is
+// learned first (unless resuming, since the checkpoint has it).
+probVector learnWithCheckpoints(lbModel const& model,lbMeasureDispatcher const& MD,
+                                char const* evidenceFile,int maxCheckpoints,bool resume,
+                                bool local) {
+  char const* fileName = "suffStatTest.checkpoint";
+  lbModel copy(model);
+  lbBeliefPropagation infObj(copy, MD);
+  lbSuffStat suff(infObj, string(evidenceFile), set<measIndex>());
+  lbGSLLearningObject learner(copy, &suff, &infObj, MD);
+  learner.setWarmStart(true);
+  learner.setCheckpoint(fileName, 2, maxCheckpoints);
+  if (resume && !learner.resumeFromCheckpoint(fileName))
+    return probVector();
+  if (local && !resume)
+    learner.learnLocal(OBJ_PSEUDO, tGSLOptimizer::LBFGS, 1e-4, 0.01, 10);
+  learner.learnEM(tGSLOptimizer::LBFGS, 1e-4, 0.01, 10, 3);
+  if (maxCheckpoints > 0 && !learner.stoppedAtCheckpoint())
+    return probVector();
+
+  int size;
+  probType* params = copy.getLogParamVector(size, false);
+  probVector res(size);
+  for (int i = 0; i < size; i++) {
+    res[i] = params[i];
+  }
+  delete[] params;
+  return res;
+}
+
+// a run stopped at a checkpoint and resumed from it ends with the
+// parameters of a run that was not stopped (with the pseudo likelihood
+// learned first if local)
+bool checkCheckpoint(lbModel const& model,lbMeasureDispatcher const& MD,char const* evidenceFile,
+                     bool local = false) {
+  cout<<"*** comparing learning resumed from a checkpoint to a whole run"
+      <<(local ? " after the pseudo likelihood" : "")<<endl;
+  probVector whole = learnWithCheckpoints(model, MD, evidenceFile, 0, false, local);
+  learnWithCheckpoints(model, MD, evidenceFile, 3, false, local);
+  probVector resumed = learnWithCheckpoints(model, MD, evidenceFile, 0, true, local);
+  remove("suffStatTest.checkpoint");
+  if (whole.empty() || resumed != whole) {
+    cout<<"Resumed learning differs from the whole run"<<endl;
+    return false;
+  }
+  return true;
+}
+
+// the rows of the evidence matrix against the assignments read a line
+// at a time (in two bytes a value when a variable has more than 128),
+// its distinct rows against comparing every row to the earlier ones,
+// and a large copy of the evidence (read in several blocks) parsed by
+// one thread and by several
+bool checkEvidenceMatrix(lbModel const& model,char const* evidenceFile) {
+  cout<<"*** comparing the evidence matrix to the assignments"<<endl;
+  int numOfVars = model.getGraph().getNumOfVars();
+  lbEvidenceMatrix matrix(model.getCardVec());
+  bool ok = matrix.readFile(evidenceFile) && matrix.getBadLines().empty();
+  ifstream in(evidenceFile);
+  string line;
+  vector<string> lines;
+  int row = 0;
+  while (ok && getline(in,line)) {
+    lines.push_back(line);
+    lbFullAssignment assign;
+    if (!assign.readAssignmentFromString(line.substr(0,line.rfind(')')+1),numOfVars))
+      continue;
+    for (int var=0;var<numOfVars && row<matrix.getNumOfRows();var++) {
+      int value = assign.isAssigned(var) ? (int) assign.getValueForVar(var) : -1;
+      if (matrix.getValue(row,var) != value)
+        ok = false;
+    }
+    row++;
+  }
+  ok &= (row == matrix.getNumOfRows());
+  bool wide = false;
+  for (int var=0;var<numOfVars;var++)
+    wide |= (model.getCardVec()[var] > 128);
+  ok &= (matrix.getValueSize() == (wide ? 2 : 1));
+
+  intVec distinct,rowOf;
+  matrix.findDistinctRows(distinct,rowOf);
+  uint numOfDistinct = 0;
+  for (int r=0;ok && r<matrix.getNumOfRows();r++) {
+    int first = r;
+    for (int s=0;s<r && first==r;s++) {
+      bool same = true;
+      for (int var=0;var<numOfVars;var++)
+        same &= (matrix.getValue(s,var) == matrix.getValue(r,var));
+      if (same)
+        first = s;
+    }
+    if (first == r)
+      ok &= (numOfDistinct < distinct.size() && distinct[numOfDistinct++] == r);
+    ok &= (distinct[rowOf[r]] == first);
+  }
+  ok &= (numOfDistinct == distinct.size());
+
+  char const* fileName = "suffStatTest.evidence";
+  ofstream out(fileName);
+  int copies = 0;
+  for (long bytes=0;bytes<(3<<20);copies++) {
+    for (uint i=0;i<lines.size();i++) {
+      out<<lines[i]<<"\n";
+      bytes += lines[i].size()+1;
+    }
+  }
+  out.close();
+  lbEvidenceMatrix serial(model.getCardVec()), threaded(model.getCardVec());
+  serial.readFile(fileName,1);
+  threaded.readFile(fileName,4);
+  remove(fileName);
+  ok &= (serial.getNumOfRows() == copies*matrix.getNumOfRows() &&
+         threaded.getNumOfRows() == serial.getNumOfRows());
+  for (int r=0;ok && r<serial.getNumOfRows();r++) {
+    ok &= (threaded.getWeight(r) == serial.getWeight(r) &&
+           serial.getWeight(r) == matrix.getWeight(r % matrix.getNumOfRows()));
+    for (int var=0;var<numOfVars;var++)
+      ok &= (threaded.getValue(r,var) == serial.getValue(r,var) &&
+             serial.getValue(r,var) == matrix.getValue(r % matrix.getNumOfRows(),var));
+  }
+  if (!ok)
+    cout<<"Evidence matrix differs from the assignments"<<endl;
+  return ok;
+}
 
 int main (int argc,char** argv) {
-  if (argc != 3) {
-    cout << "USAGE : suffStatTest <network file> <evidence>\n";
+  if (argc != 3 && argc != 4) {
+    cout << "USAGE : suffStatTest <network file> <evidence> [same evidence weighted]\n";
     exit(1);
   }
 
@@ -38,8 +250,79 @@ int main (int argc,char** argv) {
 
   suffPtr->print(cout);
 
+  cout<<"*** comparing threaded and serial counts"<<endl;
+  bool ok = true;
+  lbBeliefPropagation* serialInfObj = new lbBeliefPropagation(LBModel, MD);
+  lbSuffStat* serialPtr = new lbSuffStat(*serialInfObj,string(argv[2]),*emptyMeasSet);
+  serialPtr->setNumThreads(1);
+  serialPtr->resetCounts();
+  suffPtr->setNumThreads(3);
+  suffPtr->resetCounts();
+  for (int measInd=0;measInd<LBModel.getNumOfMeasures();measInd++) {
+    lbTableMeasure<lbValue> threaded(suffPtr->getEmpiricalExpectation(measInd));
+    lbTableMeasure<lbValue> serial(serialPtr->getEmpiricalExpectation(measInd));
+    threaded.normalize();
+    serial.normalize();
+    if (threaded.isDifferentAVG(serial,1e-3)) {
+      cout<<"Threaded counts differ for measure "<<measInd<<endl;
+      ok = false;
+    }
+  }
+  probType llDiff = suffPtr->getLogLikelihood() - serialPtr->getLogLikelihood();
+  if (fabs(llDiff) > 1e-3 * (1 + fabs(serialPtr->getLogLikelihood()))) {
+    cout<<"Threaded log likelihood differs by "<<llDiff<<endl;
+    ok = false;
+  }
+  delete serialPtr;
+  delete serialInfObj;
+  suffPtr->setNumThreads(0);
+
+  ok &= checkFullEvidence(LBModel, MD, *suffPtr, argv[2]);
+  ok &= checkCheckpoint(LBModel, MD, argv[2]);
+  ok &= checkEvidenceMatrix(LBModel, argv[2]);
+
+  if (suffPtr->getNumOfFullEvidence() > 0) {
+    lbPseudoLikelihood pseudo(*suffPtr, LBModel, *emptyMeasSet);
+    ok &= checkLocalLikelihood(LBModel, pseudo, "pseudo");
+    lbPiecewiseLikelihood piecewise(*suffPtr, LBModel, *emptyMeasSet);
+    ok &= checkLocalLikelihood(LBModel, piecewise, "piecewise");
+    ok &= checkCheckpoint(LBModel, MD, argv[2], true);
+  }
+
+  if (argc == 4) {
+    cout<<"*** comparing to weighted evidence "<<argv[3]<<endl;
+    lbBeliefPropagation* weightedInfObj = new lbBeliefPropagation(LBModel, MD);
+    lbSuffStat* weightedPtr = new lbSuffStat(*weightedInfObj,string(argv[3]),*emptyMeasSet);
+    if (weightedPtr->getNumOfEvidence() != suffPtr->getNumOfEvidence()) {
+      cout<<"Weighted evidence has "<<weightedPtr->getNumOfEvidence()<<" instances"<<endl;
+      ok = false;
+    }
+    for (int measInd=0;measInd<LBModel.getNumOfMeasures();measInd++) {
+      lbTableMeasure<lbValue> counts(suffPtr->getEmpiricalExpectation(measInd));
+      lbTableMeasure<lbValue> weighted(weightedPtr->getEmpiricalExpectation(measInd));
+      counts.normalize();
+      weighted.normalize();
+      if (counts.isDifferentAVG(weighted,1e-6)) {
+        cout<<"Weighted counts differ for measure "<<measInd<<endl;
+        ok = false;
+      }
+    }
+    llDiff = suffPtr->getLogLikelihood() - weightedPtr->getLogLikelihood();
+    if (fabs(llDiff) > 1e-6 * (1 + fabs(suffPtr->getLogLikelihood()))) {
+      cout<<"Weighted log likelihood differs by "<<llDiff<<endl;
+      ok = false;
+    }
+    delete weightedPtr;
+    delete weightedInfObj;
+  }
+  if (!ok) {
+    cout << "Test FAILED" << endl;
+    return 1;
+  }
+
     
   lbGSLLearningObject* learner = new lbGSLLearningObject(LBModel, suffPtr, infObj, MD, emptyMeasSet);
+  learner->setWarmStart(true);
 
   learner->learnEM(tGSLOptimizer::GRADIENT);
 
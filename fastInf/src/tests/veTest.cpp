@@ -0,0 +1,131 @@
+#include <lbDriver.h>
+#include <lbModel.h>
+#include <lbJunctionTree.h>
+#include <lbBeliefPropagation.h>
+#include <lbVariableElimination.h>
+using namespace lbLib;
+
+const probType EPSILON = 1e-4;
+
+// compare VE with exact (junction tree) inference on the given query
+bool compareQuery(lbVariableElimination& ve, lbBeliefPropagation& einf,
+		  varsVec const& vars, lbAssignment const& evidence) {
+  lbAssignedMeasure_ptr veProb = ve.prob(vars, evidence);
+  lbAssignedMeasure_ptr exact = einf.prob(vars);
+  probType diff = veProb->getMaxDiff(*exact);
+
+  bool ok = (diff < EPSILON);
+  if (!ok) {
+    cout << "Mismatch on ( ";
+    printVector(vars, cout);
+    cout << "): " << diff << endl;
+    veProb->print(cout);
+    exact->print(cout);
+  }
+  delete veProb;
+  delete exact;
+  return ok;
+}
+
+bool compareAll(lbVariableElimination& ve, lbBeliefPropagation& einf,
+		lbModel const& model, lbAssignment const& evidence) {
+  bool ok = true;
+  lbGraphStruct const& graph = model.getGraph();
+  for (rVarIndex var = 0; var < graph.getNumOfVars(); var++) {
+    ok &= compareQuery(ve, einf, varsVec(1, var), evidence);
+  }
+  for (cliqIndex cliq = 0; cliq < graph.getNumOfCliques(); cliq++) {
+    ok &= compareQuery(ve, einf, graph.getVarsVecForClique(cliq), evidence);
+  }
+  return ok;
+}
+
+int main (int argc,char** argv) {
+  if (argc != 3) {
+    cout << "USAGE : veTest <network file> <assignment file>\n";
+    exit(1);
+  }
+
+  _lbRandomProbGenerator.Initialize(0);
+
+  lbMeasureDispatcher MD;
+  lbDriver driver(MD);
+  driver.readUniverse(argv[1]);
+  lbModel& model = driver.getModel();
+  int numOfVars = model.getGraph().getNumOfVars();
+
+  fullAssignmentPtrVec evidence;
+  ifstream in(argv[2]);
+  while (!in.eof()) {
+    lbFullAssignment_ptr assign(new lbFullAssignment());
+    if (assign->readAssignmentFromFile(in, numOfVars)) {
+      evidence.push_back(assign);
+    }
+    else {
+      delete assign;
+    }
+  }
+  in.close();
+
+  lbModel* emodel = lbJunctionTree::CalcJunctionTreeGraphicalModel(&model);
+  lbBeliefPropagation einf(*emodel, MD);
+  einf.calcProbs();
+
+  lbVariableElimination ve(model, MD);
+  bool ok = true;
+
+  cout << "*** No evidence" << endl;
+  ok &= compareAll(ve, einf, model, lbAssignment());
+  int plans = ve.getNumOfPlans();
+  int hits = ve.getPlanHits();
+  ok &= compareAll(ve, einf, model, lbAssignment());
+  if (ve.getNumOfPlans() != plans || ve.getPlanHits() == hits) {
+    cout << "Plans were not reused" << endl;
+    ok = false;
+  }
+
+  // with nothing observed the leaves of a directed model are barren, so
+  // pruning must leave a cheaper plan for the first variable
+  bool directed = false;
+  for (measIndex meas = 0; meas < model.getNumOfMeasures(); meas++) {
+    directed |= model.getMeasure(meas).isDirected();
+  }
+  if (directed) {
+    realVal pruned = ve.queryLogWeight(varsVec(1, 0), lbAssignment());
+    ve.setPruning(false);
+    realVal unpruned = ve.queryLogWeight(varsVec(1, 0), lbAssignment());
+    ve.setPruning(true);
+    if (!(pruned < unpruned)) {
+      cout << "Barren factors were not pruned" << endl;
+      ok = false;
+    }
+  }
+
+  for (uint i = 0; i < evidence.size(); i++) {
+    cout << "*** Evidence " << i << endl;
+    einf.changeEvidence(*evidence[i]);
+    einf.calcProbs();
+
+    ve.setEliminationMethod(lbJunctionTree::eMinFill);
+    ve.setPruning(true);
+    ok &= compareAll(ve, einf, model, *evidence[i]);
+
+    ve.setEliminationMethod(lbJunctionTree::eMinWeight);
+    ok &= compareAll(ve, einf, model, *evidence[i]);
+
+    ve.setPruning(false);
+    ok &= compareAll(ve, einf, model, *evidence[i]);
+  }
+
+  for (uint i = 0; i < evidence.size(); i++) {
+    delete evidence[i];
+  }
+  delete emodel;
+
+  if (!ok) {
+    cout << "Test FAILED" << endl;
+    return 1;
+  }
+  cout << "***\n";
+  return 0;
+}